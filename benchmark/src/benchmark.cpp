@@ -0,0 +1,374 @@
+/*********************************************************************************************
+ *  Description : Throughput benchmarks of the logger
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+using Clock = std::chrono::steady_clock;
+
+// Prevents the compiler from discarding the result
+static volatile std::size_t sink;
+
+static void report (const char *name, std::size_t events, std::size_t bytes, Clock::duration elapsed)
+{
+	double secs = std::chrono::duration<double> (elapsed).count();
+	std::cout << std::left << std::setw (40) << name << std::right << std::fixed << std::setprecision (0)
+	          << std::setw (14) << (events / secs) << " events/s" << std::setprecision (1) << std::setw (10)
+	          << (bytes / secs / (1024 * 1024)) << " MB/s" << std::endl;
+}
+
+//-------------- Formatters ----------------
+
+static lggr::EventContainer makeEvent (const std::string &text, bool timed)
+{
+	lggr::EventContainer event (lggr::LL::INFO);
+	event.timePoint = std::chrono::system_clock::now();
+	event.date      = "2024-04-17 15:28:07.2128489";
+	event.event     = text;
+	if (timed)
+	{
+		event.eventType    = lggr::EVENT_TYPE_TIMED_FINISHED;
+		event.endTimePoint = event.timePoint + std::chrono::milliseconds (12);
+		event.usedTimeTxt  = "12ms";
+	}
+	return event;
+}
+
+static void benchFormatter (const char *name, const lggr::LogFormatter &formatter,
+                            const std::vector<lggr::EventContainer> &events)
+{
+	constexpr int ROUNDS = 200;
+
+	std::string out;
+	out.reserve (1024 * 1024);
+	std::size_t bytes = 0;
+
+	auto start = Clock::now();
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		for (auto &event : events)
+		{
+			out.clear();
+			formatter.format (event, out);
+			bytes += out.size();
+		}
+	}
+	auto elapsed = Clock::now() - start;
+	sink         = bytes;
+
+	report (name, ROUNDS * events.size(), bytes, elapsed);
+}
+
+static void benchFormatters ()
+{
+	std::vector<lggr::EventContainer> plain;
+	std::vector<lggr::EventContainer> escaped;
+	for (int i = 0; i < 5000; i++)
+	{
+		plain.push_back (makeEvent ("Request " + std::to_string (i)
+		                                + " served from the cache: user profile, preferences and the last orders",
+		                            i % 10 == 0));
+		escaped.push_back (makeEvent ("Payload {\"user\": " + std::to_string (i)
+		                                  + ", \"path\": \"C:\\\\data\\\\in.txt\"}\tline one\nline two",
+		                              i % 10 == 0));
+	}
+
+	lggr::TextFormatter text;
+	lggr::JsonLinesFormatter json;
+	lggr::LogfmtFormatter logfmt;
+
+	benchFormatter ("format text (plain msg)", text, plain);
+	benchFormatter ("format json lines (plain msg)", json, plain);
+	benchFormatter ("format logfmt (plain msg)", logfmt, plain);
+	benchFormatter ("format text (escaped msg)", text, escaped);
+	benchFormatter ("format json lines (escaped msg)", json, escaped);
+	benchFormatter ("format logfmt (escaped msg)", logfmt, escaped);
+}
+
+//-------------- Format API vs streams ----------------
+
+// Receives the events inline, and reads its text (so the deferred ones are formatted)
+class CountingSink : public lggr::LogSink
+{
+	public:
+		std::size_t bytes = 0;
+
+		CountingSink()
+		    : LogSink (lggr::LL::TRACE)
+		{
+		}
+
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			bytes += event.event.size();
+		}
+};
+
+template <typename Log> static void benchLogCalls (const char *name, Log &&logCall)
+{
+	constexpr int EVENTS = 300000;
+
+	auto start = Clock::now();
+	for (int i = 0; i < EVENTS; i++)
+	{
+		logCall (i);
+	}
+	report (name, EVENTS, 0, Clock::now() - start);
+}
+
+static void benchFormat ()
+{
+	constexpr int MESSAGES = 1000000;
+	const std::string user = "bob";
+
+	// Only the message: what the LogMessageBuilder does, and what the format API does
+	std::size_t bytes = 0;
+	auto start        = Clock::now();
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		std::stringstream message;
+		message << "user " << user << " request " << i << " took " << (i * 0.25) << "ms";
+		std::string text = message.str();
+		bytes += text.size();
+	}
+	report ("message: stringstream", MESSAGES, bytes, Clock::now() - start);
+
+	bytes = 0;
+	start = Clock::now();
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		std::size_t &sizeHint = lggr::getFormatSizeHint();
+		std::string text;
+		text.reserve (sizeHint);
+		lggr::formatTo (text, "user {} request {} took {}ms", user, i, i * 0.25);
+		sizeHint = text.size();
+		bytes += text.size();
+	}
+	report ("message: format string", MESSAGES, bytes, Clock::now() - start);
+	sink = bytes;
+
+	// The whole call, to a channel with only an inline sink (and its date formatting)
+	static lggr::Channel channel ("benchmark");
+	channel.setConsoleLevel (lggr::LL::OFF);
+	channel.setFileLevel (lggr::LL::OFF);
+	channel.setStackSize (0);
+	auto counting = std::make_shared<CountingSink>();
+	channel.addSink (counting);
+
+	benchLogCalls ("log: operator<<", [&] (int i) {
+		channel.info << "user " << user << " request " << i << " took " << (i * 0.25) << "ms";
+	});
+	benchLogCalls ("log: format string", [&] (int i) {
+		channel.info.log ("user {} request {} took {}ms", user, i, i * 0.25);
+	});
+	benchLogCalls ("log: deferred (formatted by the sink)", [&] (int i) {
+		channel.info.logDeferred ("user {} request {} took {}ms", user, i, i * 0.25);
+	});
+
+	// Nobody reads the text: the deferred ones are never formatted
+	channel.removeSink (counting);
+	channel.setStackSize (1000);
+	channel.setStackLevel (lggr::LL::INFO);
+	benchLogCalls ("stack only: operator<<", [&] (int i) {
+		channel.info << "user " << user << " request " << i << " took " << (i * 0.25) << "ms";
+	});
+	benchLogCalls ("stack only: deferred", [&] (int i) {
+		channel.info.logDeferred ("user {} request {} took {}ms", user, i, i * 0.25);
+	});
+	channel.setStackSize (0);
+	sink = counting->bytes;
+}
+
+//-------------- Large messages ----------------
+
+static void benchLarge ()
+{
+	constexpr int EVENTS = 2000;
+	const std::string dump (64 * 1024, 'd');
+
+	static lggr::Channel channel ("benchmark_large");
+	channel.setConsoleLevel (lggr::LL::OFF);
+	channel.setStackSize (0);
+	channel.setOutFile ("benchmark_large.log");
+	channel.setFileLevel (lggr::LL::INFO);
+
+	// As text: copied into the stream, and then into the line
+	auto start = Clock::now();
+	for (int i = 0; i < EVENTS; i++)
+	{
+		channel.info << "request " << i << ": " << dump.c_str();
+	}
+	report ("64KB to file: streamed", EVENTS, EVENTS * dump.size(), Clock::now() - start);
+
+	// Moved into the message: a rope, written with a gather write
+	start = Clock::now();
+	for (int i = 0; i < EVENTS; i++)
+	{
+		std::string payload = dump;
+		channel.info << "request " << i << ": " << std::move (payload);
+	}
+	report ("64KB to file: moved (payload copy incl.)", EVENTS, EVENTS * dump.size(), Clock::now() - start);
+
+	// A timed event wich grows with big pieces
+	start = Clock::now();
+	for (int i = 0; i < EVENTS / 20; i++)
+	{
+		auto event = channel.info.startTimedEvent();
+		event << "batch " << i;
+		for (int j = 0; j < 20; j++)
+		{
+			event << std::string (dump.data(), 8 * 1024);
+		}
+	}
+	report ("timed event, 20 appends of 8KB", EVENTS / 20, EVENTS * 8 * 1024, Clock::now() - start);
+
+	channel.setFileLevel (lggr::LL::OFF);
+	std::remove ("benchmark_large.log");
+}
+
+//-------------- Producer threads ----------------
+
+class NullSubscriber : public lggr::LogEventsSubscriber
+{
+	public:
+		void onLogEvent (const std::string &, const std::string, const lggr::LogLevel) override {}
+};
+
+static void benchThreadsOn (const char *channelName, unsigned int shards)
+{
+	constexpr int EVENTS = 256000;
+
+	lggr::Config::setShards (shards);
+	lggr::Channel channel (channelName);
+	channel.setConsoleLevel (lggr::LL::OFF);
+	channel.setFileLevel (lggr::LL::OFF);
+	channel.setStackSize (1000);
+	auto counting = std::make_shared<CountingSink>();
+	channel.addSink (counting);
+
+	for (int threadCount = 1; threadCount <= 64; threadCount *= 2)
+	{
+		std::size_t firstBytes = counting->bytes;
+		auto start             = Clock::now();
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back ([&channel, t, threadCount] {
+				for (int i = 0; i < EVENTS / threadCount; i++)
+				{
+					channel.info << "thread " << t << " event " << i;
+				}
+			});
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+
+		// Until the sink has them all (a pull merges the pending ones)
+		NullSubscriber subscriber;
+		channel.pullLogEvents (subscriber, lggr::LL::OFF);
+
+		std::string name = ((shards > 1) ? std::to_string (shards) + " shards, " : std::string ("single lock, "))
+		                 + std::to_string (threadCount) + " threads";
+		report (name.c_str(), EVENTS, counting->bytes - firstBytes, Clock::now() - start);
+	}
+
+	channel.removeSink (counting);
+	lggr::Config::setShards (0);
+}
+
+static void benchThreads ()
+{
+	std::cout << "(" << std::thread::hardware_concurrency() << " cores)" << std::endl;
+	benchThreadsOn ("benchmark_lock", 0);
+	benchThreadsOn ("benchmark_shards", 8);
+}
+
+//-------------- Startup ----------------
+
+// Before main: the handles are constant initialized, and the first call creates the default backend
+static const Clock::duration firstLogBeforeMain = [] {
+	lggr::Config::setMultiThreadSafe (true);
+	auto start = Clock::now();
+	lggr::trace << "Discarded, but it creates the backend";
+	return Clock::now() - start;
+}();
+
+static void benchStartup ()
+{
+	double micros = std::chrono::duration<double, std::micro> (firstLogBeforeMain).count();
+	std::cout << std::left << std::setw (40) << "first call before main" << std::right << std::fixed
+	          << std::setprecision (1) << std::setw (14) << micros << " us" << std::endl;
+
+	// A backend for each one, and its first (discarded) call
+	constexpr int CHANNELS = 200;
+	auto start = Clock::now();
+	for (int i = 0; i < CHANNELS; i++)
+	{
+		lggr::Channel channel ("startup_" + std::to_string (i));
+		channel.trace << "first";
+	}
+	report ("new channel + first call", CHANNELS, 0, Clock::now() - start);
+
+	// Once created: the default handles resolve the backend with a single load
+	static lggr::Channel channel ("startup");
+	benchLogCalls ("discarded call: default handle", [] (int i) { lggr::trace.log ("request {}", i); });
+	benchLogCalls ("discarded call: channel handle", [] (int i) { channel.trace.log ("request {}", i); });
+}
+
+//-------------- Main ----------------
+
+struct Scenario
+{
+		const char *name;
+		void (*run) ();
+};
+
+static const Scenario scenarios [] = {
+    {"formatters", benchFormatters},
+    {"format", benchFormat},
+    {"large", benchLarge},
+    {"threads", benchThreads},
+    {"startup", benchStartup},
+};
+
+int main (int argc, char *argv [])
+{
+	// The threads scenario needs the thread safe backends
+	lggr::Config::setMultiThreadSafe (true);
+
+	// Without arguments, all the scenarios
+	for (auto &scenario : scenarios)
+	{
+		bool selected = (argc < 2);
+		for (int i = 1; i < argc; i++)
+		{
+			selected = selected || (std::strcmp (argv [i], scenario.name) == 0);
+		}
+
+		if (selected)
+		{
+			std::cout << "--- " << scenario.name << " ---" << std::endl;
+			scenario.run();
+		}
+	}
+	return 0;
+}
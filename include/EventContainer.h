@@ -9,10 +9,14 @@
 #	define _EVENT_CONTAINER_H
 
 #	include <string>
+#	include <string_view>
 #	include <chrono>
 #	include <cstdint>
 
 #	include "StreamLoggerConsts.h"
+#	include "StreamLoggerFields.h"
+#	include "StreamLoggerFormat.h"
+#	include "StreamLoggerContext.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
@@ -30,9 +34,12 @@ namespace IgnacioPomar::Util::StreamLogger
 	constexpr std::uint8_t EVENT_TYPE_RUNNING = 0b0100'0000;
 	constexpr std::uint8_t EVENT_TYPE_TIMED   = 0b1000'0000;
 
-	constexpr std::uint8_t EVENT_TYPE_TIMED_RUNNING  = EVENT_TYPE_TIMED & EVENT_TYPE_RUNNING;
+	constexpr std::uint8_t EVENT_TYPE_TIMED_RUNNING  = EVENT_TYPE_TIMED | EVENT_TYPE_RUNNING;
 	constexpr std::uint8_t EVENT_TYPE_TIMED_FINISHED = EVENT_TYPE_TIMED;
 
+	// In the text lines, before the used time of the finished timed events
+	constexpr std::string_view TIMED_TAG {"\tDone in: "};
+
 	/**
 	 * Contain the info for a single event
 	 */
@@ -49,7 +56,30 @@ namespace IgnacioPomar::Util::StreamLogger
 			TimePoint timePoint;
 			std::string date;
 			std::string event;
+			LogFields fields;
 			LogLevel logLevel;
+			std::uint32_t callSiteId = 0;        // See StreamLoggerCallSites.h
+			bool forced              = false;    // Let through by a level override: the sinks don't filter it
+			LogContextPtr context;               // The request (see StreamLoggerContext.h), if any
+			std::uint32_t sampleRate  = 1;       // A sampled call site: the number of calls this event stands for
+			std::uint32_t threadIndex = 0;       // The thread wich logged it (see getThreadIndex), 0 if unknown
+			DeferredTextPtr deferred;            // The text, not formatted yet: see resolveText
+
+			// Formats the deferred text (if any) into event. Before reading event
+			void resolveText ()
+			{
+				if (this->deferred)
+				{
+					this->deferred->render (this->event);
+					this->deferred.reset();
+				}
+			}
+
+			// The deferred text, if it's a rope: the sinks wich write it as is don't need the whole text
+			const TextRope *getRope () const
+			{
+				return this->deferred ? this->deferred->asRope() : nullptr;
+			}
 
 			std::uint8_t eventType = EVENT_TYPE_NORMAL;
 
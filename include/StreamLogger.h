@@ -16,13 +16,27 @@
 #		define LGGR_API
 #	endif
 
+#	include <chrono>
+#	include <cstdint>
+#	include <memory>
+#	include <source_location>
 #	include <sstream>
 #	include <string>
+#	include <string_view>
+#	include <type_traits>
+#	include "StreamLoggerBuffer.h"
+#	include "StreamLoggerCallSites.h"
 #	include "StreamLoggerConsts.h"
+#	include "StreamLoggerContext.h"
+#	include "StreamLoggerFields.h"
+#	include "StreamLoggerFormat.h"
 #	include "StreamLoggerInterfaces.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
+	// forward declarations (see StreamLoggerSinks.h)
+	class LogSink;
+	class LogFormatter;
 
 	//--------------  Logger configuration ----------------
 
@@ -31,6 +45,11 @@ namespace IgnacioPomar::Util::StreamLogger
 		// Set this before any threads are started and do not change it afterwards.
 		LGGR_API void setMultiThreadSafe (bool multiThreadSafe);
 
+		// Multi-thread safe backends: the producers add the events to one of these shards, and a consumer thread
+		// merges them in order. Only for the backends created afterwards (the default one, on its first use; a
+		// channel, when its first Channel object is built). Less than 2 is the single lock backend
+		LGGR_API void setShards (unsigned int shardCount, ShardAffinity affinity = ShardAffinity::THREAD);
+
 		// If 0, there will be no stack at all
 		LGGR_API void setStackSize (unsigned int stackSize);
 
@@ -41,13 +60,54 @@ namespace IgnacioPomar::Util::StreamLogger
 		LGGR_API void setConsoleLevel (LogLevel logLevel);
 		LGGR_API void setFileLevel (LogLevel logLevel);
 		LGGR_API void setStackLevel (LogLevel logLevel);
+
+		// Temporary verbosity: lets through the events from this level, whatever the other levels are
+		// A zero duration never expires. Use LogLevel::OFF to remove it. For call sites, see StreamLoggerCallSites.h
+		LGGR_API void setLevelOverride (LogLevel logLevel,
+		                                std::chrono::seconds duration = std::chrono::seconds::zero());
+		LGGR_API void setChannelLevelOverride (const std::string &channelName, LogLevel logLevel,
+		                                       std::chrono::seconds duration = std::chrono::seconds::zero());
+
+		// The formatters of the standard console and file sinks (TextFormatter by default)
+		LGGR_API void setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter);
+		LGGR_API void setFileFormatter (std::shared_ptr<const LogFormatter> formatter);
+
+		// Sparse side index of the log files ("<log file>.idx"), for the logquery tool. 0 disables it
+		LGGR_API void setFileIndex (std::uint32_t eventsPerEntry = DEFAULTS::INDEX_INTERVAL);
+
+		// Opt-in: when a sink has more queued events, or a slower mean write, than these limits, the lower levels are
+		// shed (TRACE first, then DEBUG, then INFO: WARN and above always pass), and restored when the sinks catch
+		// up. Each restored level sends a WARN event with how many were shed. A 0 queue limit disables it
+		LGGR_API void setOverloadShedding (std::size_t maxQueuedEvents = DEFAULTS::OVERLOAD_QUEUE,
+		                                   std::chrono::microseconds maxWriteLatency = DEFAULTS::OVERLOAD_LATENCY);
+
+		// Opt-in: on a crash (SIGSEGV, SIGABRT, std::terminate...) flushes the log files, and writes the last events
+		// of the stacks to crashFile. Only POSIX: returns false if not supported
+		LGGR_API bool enableCrashHandler (const std::string &crashFile);
+
+		// Opt-in: the recorder of the last events lives in a memory mapped file, so it survives a crash or a kill -9
+		// The events left by the previous run are loaded first (see pullPreviousRunEvents). Only POSIX
+		LGGR_API bool setFlightRecorder (const std::string &filePath);
+
+		// Names the calling thread: the formatters write it with the thread index of its events
+		LGGR_API void setThreadName (const std::string &name);
+
+		// Additional outputs, after the standard ones (console, file and push subscribers)
+		LGGR_API void addSink (std::shared_ptr<LogSink> sink);
+		LGGR_API void removeSink (const std::shared_ptr<LogSink> &sink);
 	};    // namespace Config
 
+	// Writes the pending events of all the outputs (the async queues too), waiting up to the timeout, and discards
+	// the next ones. False if some output didn't finish. It's called at exit, so the events are not lost
+	// fork() is safe: the child gets the loggers unlocked, with its own output threads and without the parent events
+	LGGR_API bool shutdown (std::chrono::milliseconds timeout = DEFAULTS::SHUTDOWN_TIMEOUT);
+
 	//-------------- Classes to use externally ----------------
 
 	// forward declarations
 	class LogMessageBuilder;
 	class EventContainer;
+	class StackLogger;
 
 	/**
 	 * Interfaz to fill the logger message with stream
@@ -56,23 +116,37 @@ namespace IgnacioPomar::Util::StreamLogger
 	{
 		public:
 			virtual void log (std::string &message) = 0;
-			template <typename T> friend LogMessageBuilder operator<< (BaseStreamLogger &logger, const T &value);
+			virtual void log (std::string &message, LogFields &fields, const CallSite *site) = 0;
+
+			// A text not built yet (p.e. a rope with big pieces). By default, it's rendered and logged as a string
+			virtual void log (DeferredTextPtr text, LogFields &fields, const CallSite *site)
+			{
+				std::string message;
+				text->render (message);
+				this->log (message, fields, site);
+			}
+
+			// Typed key/value field for the event: lggr::info.with ("req", id) << "done"
+			template <typename T> LogMessageBuilder with (std::string_view key, const T &value);
 	};
 
 	/**
 	 * A Event wich has been already stored in the stack. Allos to count its time
 	 * Uppon destruction the event finishes
 	 */
-	class LGGR_API TimedEvent : public BaseStreamLogger
+	class LGGR_API TimedEvent final : public BaseStreamLogger
 	{
 		private:
 			EventContainer &event;
+			StackLogger &logger;
 			bool started = false;
 
 		public:
 			~TimedEvent();
-			TimedEvent (EventContainer &event);
+			TimedEvent (EventContainer &event, StackLogger &logger);
 			void log (std::string &message);
+			void log (std::string &message, LogFields &fields, const CallSite *site);
+			void log (DeferredTextPtr text, LogFields &fields, const CallSite *site);
 	};
 
 	/**
@@ -80,14 +154,123 @@ namespace IgnacioPomar::Util::StreamLogger
 	 */
 	class LGGR_API StaticLogger : public BaseStreamLogger
 	{
+		private:
+			// nullptr means the default logger, resolved on each call (it may not exist yet at static init)
+			StackLogger *backend;
+
+			StackLogger &getBackend ();
+
 		public:
-			StaticLogger (LogLevel level);
+			// constexpr: the global ones are constant initialized (no static init order issues)
+			constexpr StaticLogger (LogLevel level)
+			    : backend (nullptr)
+			    , level (level)
+			{
+			}
+			constexpr StaticLogger (LogLevel level, StackLogger &backend)
+			    : backend (&backend)
+			    , level (level)
+			{
+			}
 
 			const LogLevel level;
 
 			void log (std::string &message);
+			void log (std::string &message, LogFields &fields, const CallSite *site);
+			void log (DeferredTextPtr text, LogFields &fields, const CallSite *site);
+
+			// lggr::info.log ("user {} took {}ms", id, ms): checked when compiling, and formatted without streams
+			template <typename... Args> void log (FormatString<Args...> format, const Args &...args);
 
-			TimedEvent startTimedEvent ();
+			// The same, but only the arguments are captured: the first output wich needs the text formats it
+			template <typename... Args> void logDeferred (FormatString<Args...> format, const Args &...args);
+
+			// Hides the BaseStreamLogger one, to capture the call site
+			template <typename T>
+			LogMessageBuilder with (std::string_view key, const T &value,
+			                        const std::source_location &location = std::source_location::current());
+
+			TimedEvent startTimedEvent (const std::source_location &location = std::source_location::current());
+
+			// Checked before building the message: the discarded events are not formatted
+			bool isLoggable (const CallSite &site);
+
+			// The levels without the call site: false if no override can let the call through
+			bool isLevelEnabled ();
+
+			// All the checks of a call: the levels, then the site (resolved only if the levels may let it through,
+			// and counted only if it passes them). The site of the call, or nullptr if it's discarded
+			CallSite *shouldLog (const std::source_location &location);
+	};
+
+	/**
+	 * A StaticLogger, and the place of the code wich uses it
+	 * Built implicitly by the "lggr::info << ..." expression: the default argument is evaluated in the caller
+	 */
+	class LogSite
+	{
+		public:
+			LogSite (StaticLogger &logger, const std::source_location &location = std::source_location::current())
+			    : logger (logger)
+			    , location (location)
+			{
+			}
+
+			StaticLogger &logger;
+			std::source_location location;    // Resolved to its CallSite only if the levels may let it through
+	};
+
+	/**
+	 * A named logger, with its own levels, stack, output file, subscribers and lock
+	 * The channel is looked up only once, in the constructor: keep the object (p.e. as a static) and use its loggers
+	 * Several Channel objects with the same name share the same backend
+	 */
+	class LGGR_API Channel
+	{
+		private:
+			StackLogger &backend;
+
+			// Prevent illegal usage: the StaticLogger members point to the backend
+			Channel (const Channel &)            = delete;    // no copies
+			Channel &operator= (const Channel &) = delete;    // no self-assignments
+
+		public:
+			Channel (const std::string &channelName);
+
+			StaticLogger trace;
+			StaticLogger debug;
+			StaticLogger info;
+			StaticLogger warn;
+			StaticLogger error;
+			StaticLogger fatal;
+
+			const std::string &getName () const;
+
+			// Same as the Config functions, but only for this channel
+			void setStackSize (unsigned int stackSize);
+			void setOutFile (const std::string fileName);
+			void setOutPath (const std::string filePath);
+			void setLevelColor (LogLevel logLevel, LogColor logColor);
+
+			void setConsoleLevel (LogLevel logLevel);
+			void setFileLevel (LogLevel logLevel);
+			void setStackLevel (LogLevel logLevel);
+			void setLevelOverride (LogLevel logLevel, std::chrono::seconds duration = std::chrono::seconds::zero());
+
+			void setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter);
+			void setFileFormatter (std::shared_ptr<const LogFormatter> formatter);
+			void setFileIndex (std::uint32_t eventsPerEntry = DEFAULTS::INDEX_INTERVAL);
+			void setOverloadShedding (std::size_t maxQueuedEvents = DEFAULTS::OVERLOAD_QUEUE,
+			                          std::chrono::microseconds maxWriteLatency = DEFAULTS::OVERLOAD_LATENCY);
+			void addSink (std::shared_ptr<LogSink> sink);
+			void removeSink (const std::shared_ptr<LogSink> &sink);
+			bool setFlightRecorder (const std::string &filePath);
+
+			void pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+			void pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel, std::string_view fieldKey,
+			                    std::string_view fieldValue);
+			void pullPreviousRunEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+			void subscribePushEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
 	};
 
 	//-------------- Instances of the loggers ----------------
@@ -105,16 +288,33 @@ namespace IgnacioPomar::Util::StreamLogger
 		public:
 			LogMessageBuilder (BaseStreamLogger &logger)
 			    : logger (logger) {};
+			LogMessageBuilder (StaticLogger &logger, const std::source_location &location)
+			    : logger (logger)
+			    , site (logger.shouldLog (location))
+			    , enabled (site != nullptr) {};
 			LogMessageBuilder (const LogMessageBuilder &other) = delete;
 			LogMessageBuilder (LogMessageBuilder &&other) noexcept
 			    : logger (other.logger)
-			    , message (std::move (other.message)) {};
+			    , message (std::move (other.message))
+			    , rope (std::move (other.rope))
+			    , fields (std::move (other.fields))
+			    , site (other.site)
+			    , enabled (other.enabled)
+			{
+				other.enabled = false;
+			};
 			~LogMessageBuilder()
 			{
-				if (this->message.rdbuf()->in_avail() > 0)
+				if (this->enabled && this->rope)
 				{
-					std::string msg = message.str();
-					logger.log (msg);
+					this->flushToRope();
+					logger.log (DeferredTextPtr (std::move (this->rope)), fields, site);
+				}
+				else if (this->enabled && (this->message.rdbuf()->in_avail() > 0 || !this->fields.empty()))
+				{
+					// Moved out of the stream: the message is not copied
+					std::string msg = std::move (message).str();
+					logger.log (msg, fields, site);
 				}
 			};
 
@@ -122,7 +322,55 @@ namespace IgnacioPomar::Util::StreamLogger
 
 			template <typename T> LogMessageBuilder &operator<< (const T &msg)
 			{
-				this->message << msg;
+				if (this->enabled)
+				{
+					if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+					{
+						if (msg.size() >= DEFAULTS::ROPE_CHUNK_SIZE)
+						{
+							this->appendChunk (std::string (msg));
+							return *this;
+						}
+					}
+					this->message << msg;
+				}
+				return *this;
+			}
+
+			// The big temporaries are moved into the message (p.e. lggr::info << std::move (requestDump))
+			LogMessageBuilder &operator<< (std::string &&msg)
+			{
+				if (this->enabled)
+				{
+					if (msg.size() >= DEFAULTS::ROPE_CHUNK_SIZE)
+					{
+						this->appendChunk (std::move (msg));
+					}
+					else
+					{
+						this->message << msg;
+					}
+				}
+				return *this;
+			}
+
+			template <typename T> LogMessageBuilder &with (std::string_view key, const T &value)
+			{
+				if (!this->enabled)
+				{
+					return *this;
+				}
+				if constexpr (std::is_arithmetic_v<T> || std::is_convertible_v<const T &, std::string_view>)
+				{
+					this->fields.add (key, value);
+				}
+				else
+				{
+					// Any other streamable type is stored as text
+					std::ostringstream oss;
+					oss << value;
+					this->fields.add (key, oss.str());
+				}
 				return *this;
 			}
 
@@ -130,13 +378,126 @@ namespace IgnacioPomar::Util::StreamLogger
 			BaseStreamLogger &logger;
 
 			std::stringstream message;
+			std::shared_ptr<TextRope> rope;    // Only if there are big pieces: then, the message is this rope
+			LogFields fields;
+			const CallSite *site = nullptr;
+			bool enabled         = true;    // false if the call site is disabled, or the level is discarded
+
+			// The text streamed so far, as a piece of the rope
+			void flushToRope ()
+			{
+				if (this->message.rdbuf()->in_avail() > 0)
+				{
+					this->rope->append (std::move (this->message).str());
+					this->message.str (std::string());
+				}
+			}
+
+			void appendChunk (std::string &&chunk)
+			{
+				if (!this->rope)
+				{
+					this->rope = std::make_shared<TextRope>();
+				}
+				this->flushToRope();
+				this->rope->append (std::move (chunk));
+			}
 	};
 
-	template <typename T> LogMessageBuilder operator<< (BaseStreamLogger &logger, const T &value)
+	// The StaticLogger ones go through LogSite, to capture the call site
+	template <typename L, typename T>
+	    requires (std::is_base_of_v<BaseStreamLogger, L> && !std::is_base_of_v<StaticLogger, L>)
+	LogMessageBuilder operator<< (L &logger, const T &value)
 	{
 		LogMessageBuilder tmpBuilder (logger);
 		tmpBuilder << value;
-		return std::move (tmpBuilder);
+		return tmpBuilder;
+	}
+
+	template <typename L>
+	    requires (std::is_base_of_v<BaseStreamLogger, L> && !std::is_base_of_v<StaticLogger, L>)
+	LogMessageBuilder operator<< (L &logger, std::string &&value)
+	{
+		LogMessageBuilder tmpBuilder (logger);
+		tmpBuilder << std::move (value);
+		return tmpBuilder;
+	}
+
+	template <typename T> LogMessageBuilder operator<< (LogSite logSite, const T &value)
+	{
+		LogMessageBuilder tmpBuilder (logSite.logger, logSite.location);
+		tmpBuilder << value;
+		return tmpBuilder;
+	}
+
+	inline LogMessageBuilder operator<< (LogSite logSite, std::string &&value)
+	{
+		LogMessageBuilder tmpBuilder (logSite.logger, logSite.location);
+		tmpBuilder << std::move (value);
+		return tmpBuilder;
+	}
+
+	template <typename T> LogMessageBuilder BaseStreamLogger::with (std::string_view key, const T &value)
+	{
+		LogMessageBuilder tmpBuilder (*this);
+		tmpBuilder.with (key, value);
+		return tmpBuilder;
+	}
+
+	template <typename T>
+	LogMessageBuilder StaticLogger::with (std::string_view key, const T &value, const std::source_location &location)
+	{
+		LogMessageBuilder tmpBuilder (*this, location);
+		tmpBuilder.with (key, value);
+		return tmpBuilder;
+	}
+
+	inline CallSite *StaticLogger::shouldLog (const std::source_location &location)
+	{
+		// The discarded levels don't pay the lookup of the site
+		if (!this->isLevelEnabled())
+		{
+			return nullptr;
+		}
+		CallSite &site = resolveCallSite (location);
+		if (!this->isLoggable (site))
+		{
+			return nullptr;
+		}
+		site.count.fetch_add (1, std::memory_order_relaxed);
+		return (site.enabled.load (std::memory_order_relaxed) && isSampled (site)) ? &site : nullptr;
+	}
+
+	template <typename... Args> void StaticLogger::log (FormatString<Args...> format, const Args &...args)
+	{
+		// The same checks as the LogMessageBuilder ones
+		CallSite *site = this->shouldLog (format.location);
+		if (site == nullptr)
+		{
+			return;
+		}
+
+		// The event keeps the string: no copy from a buffer
+		std::size_t &sizeHint = getFormatSizeHint();
+		std::string message;
+		message.reserve (sizeHint);
+		format.render (message, args...);
+		sizeHint = message.size();
+
+		LogFields noFields;
+		this->log (message, noFields, site);
+	}
+
+	template <typename... Args> void StaticLogger::logDeferred (FormatString<Args...> format, const Args &...args)
+	{
+		CallSite *site = this->shouldLog (format.location);
+		if (site == nullptr)
+		{
+			return;
+		}
+
+		LogFields noFields;
+		this->log (std::make_shared<DeferredFormat<Args...>> (format, args...), noFields, site);
 	}
 
 }    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,83 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_BUFFER_H_
+#	define _STREAM_LOGGER_BUFFER_H_
+
+#	if __has_include("lggrExportCfg.h")
+#		include "lggrExportCfg.h"
+#	else
+#		define LGGR_API
+#	endif
+
+#	include <cstddef>
+#	include <deque>
+
+#	include "StreamLoggerConsts.h"
+#	include "EventContainer.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	class StackLogger;
+
+	/**
+	 * Keeps the events of this thread wich no output wants (p.e. DEBUG with the file in INFO) while it exists.
+	 * They are discarded at the end of the scope, unless the scope fails: then they are sent to the outputs, in
+	 * order and with its original time. The scope fails when an event of flushLevel is logged, with fail(), or
+	 * when it ends by an exception
+	 *
+	 *     lggr::ScopedLogBuffer buffer;    // From TRACE, flushed by an ERROR
+	 *     lggr::debug << "Parsed " << count << " items";
+	 */
+	class LGGR_API ScopedLogBuffer
+	{
+		private:
+			struct BufferedEvent
+			{
+					StackLogger *logger;
+					EventContainer event;
+			};
+
+			std::deque<BufferedEvent> events;
+			std::size_t maxEvents;
+			std::size_t dropped = 0;
+			bool failed         = false;
+			int exceptions;    // The uncaught ones when it was created
+			ScopedLogBuffer *previous;
+
+			void flush ();
+
+			// Prevent illegal usage
+			ScopedLogBuffer (const ScopedLogBuffer &)            = delete;    // no copies
+			ScopedLogBuffer &operator= (const ScopedLogBuffer &) = delete;    // no self-assignments
+
+		public:
+			const LogLevel captureLevel;
+			const LogLevel flushLevel;
+
+			ScopedLogBuffer (LogLevel captureLevel = LogLevel::TRACE, LogLevel flushLevel = LogLevel::ERROR,
+			                 std::size_t maxEvents = DEFAULTS::BUFFER_EVENTS);
+			~ScopedLogBuffer();
+
+			// Sends the kept events, and the next ones of the scope go directly to the outputs
+			void fail ();
+			void discard ();
+
+			bool hasFailed () const;
+			std::size_t size () const;
+			std::size_t getDropped () const;    // The oldest ones, when there were more than maxEvents
+
+			// The innermost one of this thread (nullptr if there is none)
+			static ScopedLogBuffer *getCurrent ();
+
+			// Used by the backends: an event below the level of the outputs
+			void capture (StackLogger &logger, EventContainer &&event);
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _STREAM_LOGGER_BUFFER_H_
@@ -0,0 +1,140 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_CALL_SITES_H_
+#	define _STREAM_LOGGER_CALL_SITES_H_
+
+#	if __has_include("lggrExportCfg.h")
+#		include "lggrExportCfg.h"
+#	else
+#		define LGGR_API
+#	endif
+
+#	include <atomic>
+#	include <chrono>
+#	include <cstdint>
+#	include <source_location>
+#	include <string>
+#	include <string_view>
+#	include <vector>
+
+#	include "StreamLoggerConsts.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	// Id of the events logged without a known call site (p.e. the internal ones)
+	constexpr std::uint32_t NO_CALL_SITE = 0;
+
+	// How a call site keeps only a part of its calls (see CallSites::setSampling)
+	enum class SamplingMode : std::uint8_t
+	{
+		NONE,           // All of them
+		EVERY_NTH,      // The 1st, the n+1th... deterministic, shared by all the threads
+		RANDOM,         // Each one with a probability of 1/n
+		PER_INTERVAL    // Up to n each interval, spread over the interval (from the rate of the previous one)
+	};
+
+	/**
+	 * A place of the code wich logs. Registered once, the first time it logs: it's never removed
+	 * The events only carry the id
+	 */
+	struct CallSite
+	{
+			std::uint32_t id;
+			std::uint32_t line;
+			std::uint32_t column;
+			std::string file;
+			std::string function;
+
+			std::atomic<std::uint64_t> count {0};    // Calls wich pass the levels (even when disabled or sampled out)
+			std::atomic<bool> enabled {true};
+
+			// Lets through the events of this site from this level, whatever the logger levels are
+			std::atomic<LogLevel> levelOverride {LogLevel::OFF};
+			std::atomic<std::int64_t> overrideExpiry {0};    // steady_clock ns, 0 means never
+
+			// Sampling: checked before the message is built
+			std::atomic<SamplingMode> samplingMode {SamplingMode::NONE};
+			std::atomic<std::uint32_t> sampleCount {1};    // The n of the mode
+			std::atomic<std::uint32_t> sampleRate {1};     // Each kept event stands for this number of calls
+			std::atomic<std::uint64_t> sampleCalls {0};    // Since the start (or in the current interval)
+			std::atomic<std::uint32_t> sampleKept {0};     // In the current interval
+			std::atomic<std::int64_t> intervalEnd {0};     // steady_clock ns
+			std::atomic<std::int64_t> intervalNs {0};
+	};
+
+	// Slow path of the sampled sites: false if this call is discarded
+	LGGR_API bool sampleCallSite (CallSite &site);
+
+	// Fast path: the sites without sampling only pay a relaxed load
+	inline bool isSampled (CallSite &site)
+	{
+		return site.samplingMode.load (std::memory_order_relaxed) == SamplingMode::NONE || sampleCallSite (site);
+	}
+
+	// Copy of the call site data, to be used outside the registry
+	struct CallSiteStats
+	{
+			std::uint32_t id;
+			std::uint32_t line;
+			std::string file;
+			std::string function;
+			std::uint64_t count;
+			bool enabled;
+			LogLevel levelOverride;
+			SamplingMode samplingMode;
+			std::uint32_t sampleRate;
+	};
+
+	// The call site of this location: registers it on the first call. Cached per thread
+	LGGR_API CallSite &resolveCallSite (const std::source_location &location);
+
+	namespace CallSites
+	{
+		LGGR_API bool getCallSite (std::uint32_t id, CallSiteStats &stats);
+		LGGR_API std::vector<CallSiteStats> getAll ();
+
+		// The noisiest ones first
+		LGGR_API std::vector<CallSiteStats> getTop (std::size_t count);
+
+		LGGR_API bool setEnabled (std::uint32_t id, bool enabled);
+
+		// All the sites in that line of a file, or in the whole file if line is 0 (the file may be only the end of the
+		// path: "net/Socket.cpp"). Also the ones registered later. Returns the number of the already registered ones
+		LGGR_API std::size_t setEnabled (std::string_view file, std::uint32_t line, bool enabled);
+
+		LGGR_API void resetCounts ();
+
+		// Level overrides: p.e. TRACE for the sites of a file for 5 minutes. A zero duration never expires
+		// Use LogLevel::OFF to remove the override
+		LGGR_API bool setLevelOverride (std::uint32_t id, LogLevel level,
+		                                std::chrono::seconds duration = std::chrono::seconds::zero());
+
+		// All the sites in that line of the file (or in the whole file if line is 0)
+		// Also applies to the matching sites wich log for the first time while the override lasts
+		LGGR_API std::size_t setLevelOverride (std::string_view file, std::uint32_t line, LogLevel level,
+		                                       std::chrono::seconds duration = std::chrono::seconds::zero());
+
+		LGGR_API void clearLevelOverrides ();
+
+		// Keeps 1 of each n calls (EVERY_NTH, RANDOM), or up to n each interval (PER_INTERVAL). NONE removes it
+		// The kept events carry the rate (EventContainer::sampleRate), to scale up the counts downstream
+		LGGR_API bool setSampling (std::uint32_t id, SamplingMode mode, std::uint32_t n,
+		                           std::chrono::milliseconds interval = std::chrono::seconds (1));
+
+		// All the sites in that line of the file (or in the whole file if line is 0), also the ones registered later
+		LGGR_API std::size_t setSampling (std::string_view file, std::uint32_t line, SamplingMode mode, std::uint32_t n,
+		                                  std::chrono::milliseconds interval = std::chrono::seconds (1));
+
+		LGGR_API void clearSampling ();
+
+		// The random sampling of the calling thread from this seed, p.e. to repeat a test (0: from the time again)
+		LGGR_API void seedRandomSampling (std::uint64_t seed);
+	}    // namespace CallSites
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+#endif    // _STREAM_LOGGER_CALL_SITES_H_
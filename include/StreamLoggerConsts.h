@@ -14,6 +14,8 @@
 #		define LGGR_API
 #	endif
 
+#	include <chrono>
+#	include <cstddef>
 #	include <cstdint>
 
 #	ifdef ERROR
@@ -68,10 +70,18 @@ namespace IgnacioPomar::Util::StreamLogger
 		// MAYBE: Add colors with background
 	};
 
+	// How the threads are distributed between the shards of a sharded backend (see Config::setShards)
+	enum class ShardAffinity : std::uint8_t
+	{
+		THREAD,    // Each thread always uses the same shard (assigned round robin)
+		CPU        // The shard of the group of cores where the thread runs. Linux only (else, as THREAD)
+	};
+
 	//--------------  Default Values ----------------
 	namespace DEFAULTS
 	{
 		constexpr const char *FILE_NAME {"%d_StreamedLog.log"};
+		constexpr const char *CHANNEL_FILE_NAME {"%d_%c.log"};    // %c is replaced by the channel name
 
 		constexpr LogColor COLOR_DEBUG {LogColor::WHITE};
 		constexpr LogColor COLOR_TRACE {LogColor::GREY};
@@ -91,6 +101,52 @@ namespace IgnacioPomar::Util::StreamLogger
 #	endif
 
 		constexpr int STACK_SIZE {1000};
+
+		// The file sink writes in blocks of this size (and the crash handler flushes the pending block)
+		constexpr std::uint32_t FILE_BUFFER_SIZE {8192};
+
+		// File index: an entry each 1024 events
+		constexpr std::uint32_t INDEX_INTERVAL {1024};
+
+		// Message texts: the pieces from this size are kept apart (see TextRope), not copied into the message
+		constexpr std::size_t ROPE_CHUNK_SIZE {4096};
+
+		// Sharded backends: a producer wich finds this many events pending in its shard merges them itself
+		constexpr std::size_t SHARD_EVENTS {8192};
+
+		// While there are events, the consumer of a sharded backend merges them with this interval
+		constexpr std::chrono::microseconds SHARD_INTERVAL {1000};
+
+		// Overload shedding (Config::setOverloadShedding): the limits of each sink, and how often they are checked
+		constexpr std::size_t OVERLOAD_QUEUE {10000};
+		constexpr std::chrono::microseconds OVERLOAD_LATENCY {200};
+		constexpr std::chrono::milliseconds OVERLOAD_INTERVAL {250};
+
+		// Async sinks: the events beyond this many queued ones are dropped, so a sink wich never catches up doesn't
+		// take all the memory (well above OVERLOAD_QUEUE: the overload shedding acts first, if enabled)
+		constexpr std::size_t SINK_QUEUE {100000};
+
+		// The inline sinks time one of each this many writes (the async ones time all its batches)
+		constexpr std::uint32_t LATENCY_SAMPLE {8};
+
+		// shutdown(): how long it waits for the pending events, by default (also at exit)
+		constexpr std::chrono::milliseconds SHUTDOWN_TIMEOUT {5000};
+
+		// Scoped buffers (ScopedLogBuffer): the oldest events are dropped beyond this
+		constexpr std::size_t BUFFER_EVENTS {10000};
+
+		// Event recorder (crash dumps): fixed size records, the text is truncated to fit
+		constexpr std::uint32_t RECORD_SIZE {256};
+
+		// Shared memory ring: 4096 slots of 512 bytes (2 MB)
+		constexpr std::uint32_t SHM_SLOT_SIZE {512};
+		constexpr std::uint32_t SHM_SLOT_COUNT {4096};
+
+		// Unix socket sink: frames up to 64 KB, 4 MB of spill while the agent is down, reconnection backoff
+		constexpr std::uint32_t SOCKET_FRAME_SIZE {64 * 1024};
+		constexpr std::uint32_t SOCKET_SPILL_SIZE {4 * 1024 * 1024};
+		constexpr std::uint32_t SOCKET_BACKOFF_MIN_MS {100};
+		constexpr std::uint32_t SOCKET_BACKOFF_MAX_MS {30000};
 	}    // namespace DEFAULTS
 
 }    // namespace IgnacioPomar::Util::StreamLogger
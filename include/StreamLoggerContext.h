@@ -0,0 +1,225 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_CONTEXT_H_
+#	define _STREAM_LOGGER_CONTEXT_H_
+
+#	if __has_include("lggrExportCfg.h")
+#		include "lggrExportCfg.h"
+#	else
+#		define LGGR_API
+#	endif
+
+#	include <memory>
+#	include <string>
+#	include <string_view>
+#	include <type_traits>
+#	include <utility>
+
+#	if __has_include(<coroutine>)
+#		include <coroutine>
+#	endif
+
+#	include "StreamLoggerFields.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	/**
+	 * The context of a request: each event logged while it's the current one keeps a reference to it
+	 * Don't modify it once it's attached: the events (and other threads) share it
+	 */
+	class LogContext
+	{
+		public:
+			std::string requestId;
+			std::string spanId;
+			LogFields fields;
+
+			LogContext (std::string_view requestId, std::string_view spanId = {})
+			    : requestId (requestId)
+			    , spanId (spanId)
+			{
+			}
+
+			template <typename T> LogContext &with (std::string_view key, const T &value)
+			{
+				fields.add (key, value);
+				return *this;
+			}
+
+			// A new span of the same request, with the same fields
+			std::shared_ptr<LogContext> childSpan (std::string_view childSpanId) const
+			{
+				auto child    = std::make_shared<LogContext> (requestId, childSpanId);
+				child->fields = fields;
+				return child;
+			}
+	};
+
+	typedef std::shared_ptr<const LogContext> LogContextPtr;
+
+	//-------------- Current context (per thread) ----------------
+
+	// Captured by each event (and by the timed events when they start). nullptr if there is none
+	LGGR_API const LogContextPtr &getLogContext ();
+
+	// Returns the previous one
+	LGGR_API LogContextPtr setLogContext (LogContextPtr context);
+
+	/**
+	 * Sets the context of the thread while it exists: lggr::ScopedLogContext ctx (request);
+	 */
+	class ScopedLogContext
+	{
+		private:
+			LogContextPtr previous;
+
+			// Prevent illegal usage
+			ScopedLogContext (const ScopedLogContext &)            = delete;    // no copies
+			ScopedLogContext &operator= (const ScopedLogContext &) = delete;    // no self-assignments
+
+		public:
+			ScopedLogContext (LogContextPtr context)
+			    : previous (setLogContext (std::move (context)))
+			{
+			}
+
+			~ScopedLogContext()
+			{
+				setLogContext (std::move (previous));
+			}
+	};
+
+#	if __has_include(<coroutine>)
+	//-------------- Coroutines ----------------
+
+	/**
+	 * The context of a coroutine, and the one of the thread wich is running it (to give it back on suspension)
+	 */
+	struct CoroutineLogContext
+	{
+			LogContextPtr context = getLogContext();
+			LogContextPtr outer;
+			bool entered = false;    // The eager coroutines start in the context of its creator: nothing to give back
+
+			void enter ()
+			{
+				outer   = setLogContext (context);
+				entered = true;
+			}
+
+			void leave ()
+			{
+				if (entered)
+				{
+					setLogContext (std::move (outer));
+					entered = false;
+				}
+			}
+	};
+
+	/**
+	 * Wraps an awaiter: the thread leaves the context of the coroutine when it suspends, and the thread wich resumes
+	 * it enters it (a coroutine may be resumed in other thread)
+	 */
+	template <typename Awaiter, bool reenter = true> class LogContextAwaiter
+	{
+		private:
+			Awaiter awaiter;
+			CoroutineLogContext &state;
+
+		public:
+			LogContextAwaiter (Awaiter &&awaiter, CoroutineLogContext &state)
+			    : awaiter (std::forward<Awaiter> (awaiter))
+			    , state (state)
+			{
+			}
+
+			// The thread leaves the context before the awaiter has the handle: then, other thread may resume it
+			bool await_ready () noexcept (noexcept (std::declval<Awaiter &>().await_ready()))
+			{
+				state.leave();
+				return awaiter.await_ready();
+			}
+
+			template <typename Promise>
+			decltype (auto) await_suspend (std::coroutine_handle<Promise> handle) noexcept (
+			    noexcept (std::declval<Awaiter &>().await_suspend (handle)))
+			{
+				return awaiter.await_suspend (handle);
+			}
+
+			decltype (auto) await_resume () noexcept (noexcept (std::declval<Awaiter &>().await_resume()))
+			{
+				if constexpr (reenter)
+				{
+					state.enter();
+				}
+				return awaiter.await_resume();
+			}
+	};
+
+	namespace detail
+	{
+		template <typename Awaitable> decltype (auto) getAwaiter (Awaitable &&awaitable)
+		{
+			if constexpr (requires { std::forward<Awaitable> (awaitable).operator co_await(); })
+			{
+				return std::forward<Awaitable> (awaitable).operator co_await();
+			}
+			else if constexpr (requires { operator co_await (std::forward<Awaitable> (awaitable)); })
+			{
+				return operator co_await (std::forward<Awaitable> (awaitable));
+			}
+			else
+			{
+				return std::forward<Awaitable> (awaitable);
+			}
+		}
+
+		// The lvalue awaiters are used in place (they may be not copyable); the temporaries are moved
+		template <typename Awaitable> using AwaiterResult = decltype (getAwaiter (std::declval<Awaitable>()));
+		template <typename Awaitable>
+		using AwaiterOf = std::conditional_t<std::is_lvalue_reference_v<AwaiterResult<Awaitable>>,
+		                                     AwaiterResult<Awaitable>, std::remove_cvref_t<AwaiterResult<Awaitable>>>;
+	}    // namespace detail
+
+	/**
+	 * Mixin for the promise_type of a coroutine: it keeps the context of its creator, and each co_await restores it
+	 * A lazy coroutine must also wrap its initial_suspend, and any coroutine its final_suspend:
+	 *     auto initial_suspend () { return this->enterLogContext (std::suspend_always {}); }
+	 *     auto final_suspend () noexcept { return this->leaveLogContext (std::suspend_always {}); }
+	 */
+	class LogContextPromise
+	{
+		public:
+			CoroutineLogContext logContext;
+
+			template <typename Awaitable> auto await_transform (Awaitable &&awaitable)
+			{
+				return enterLogContext (std::forward<Awaitable> (awaitable));
+			}
+
+			template <typename Awaitable> auto enterLogContext (Awaitable &&awaitable)
+			{
+				using Awaiter = detail::AwaiterOf<Awaitable &&>;
+				return LogContextAwaiter<Awaiter> (detail::getAwaiter (std::forward<Awaitable> (awaitable)),
+				                                   this->logContext);
+			}
+
+			template <typename Awaitable> auto leaveLogContext (Awaitable &&awaitable) noexcept
+			{
+				using Awaiter = detail::AwaiterOf<Awaitable &&>;
+				return LogContextAwaiter<Awaiter, false> (detail::getAwaiter (std::forward<Awaitable> (awaitable)),
+				                                          this->logContext);
+			}
+	};
+#	endif    // __has_include(<coroutine>)
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _STREAM_LOGGER_CONTEXT_H_
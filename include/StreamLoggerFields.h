@@ -0,0 +1,329 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_FIELDS_H_
+#	define _STREAM_LOGGER_FIELDS_H_
+
+#	include <charconv>
+#	include <cstdint>
+#	include <cstring>
+#	include <memory>
+#	include <string>
+#	include <string_view>
+#	include <type_traits>
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	enum class FieldType : std::uint8_t
+	{
+		INT,
+		UINT,
+		DOUBLE,
+		BOOL,
+		STRING
+	};
+
+	/**
+	 * A field of an event. The views point to the LogFields storage: don't keep them after the event
+	 */
+	struct FieldView
+	{
+			std::string_view key;
+			FieldType type;
+			std::int64_t intValue;
+			std::uint64_t uintValue;
+			double doubleValue;
+			bool boolValue;
+			std::string_view strValue;
+
+			// Appends the value as text (without quotes)
+			void appendValue (std::string &out) const
+			{
+				char buf [32];
+				std::to_chars_result res {buf, std::errc {}};
+				switch (type)
+				{
+				case FieldType::INT: res = std::to_chars (buf, buf + sizeof (buf), intValue); break;
+				case FieldType::UINT: res = std::to_chars (buf, buf + sizeof (buf), uintValue); break;
+				case FieldType::DOUBLE: res = std::to_chars (buf, buf + sizeof (buf), doubleValue); break;
+				case FieldType::BOOL: out += boolValue ? "true" : "false"; return;
+				case FieldType::STRING: out += strValue; return;
+				}
+				out.append (buf, res.ptr);
+			}
+
+			std::string toString () const
+			{
+				std::string out;
+				appendValue (out);
+				return out;
+			}
+	};
+
+	/**
+	 * Typed key/value fields of an event, serialized in a compact buffer: the small ones don't allocate
+	 * Each entry: type (1 byte), key length (1 byte), value length (2 bytes), key, value (8 bytes for the numbers)
+	 * So the keys are truncated to MAX_KEY_SIZE bytes, and the string values to MAX_VALUE_SIZE bytes (at the start of
+	 * an UTF-8 char: a char is never split)
+	 */
+	class LogFields
+	{
+		public:
+			static constexpr std::size_t INLINE_SIZE    = 64;
+			static constexpr std::size_t MAX_KEY_SIZE   = 0xFF;
+			static constexpr std::size_t MAX_VALUE_SIZE = 0xFFFF;
+
+		private:
+			static constexpr std::size_t ENTRY_HEADER = 4;
+
+			unsigned char inlineBuf [INLINE_SIZE];
+			std::unique_ptr<unsigned char []> heapBuf;
+			std::uint32_t used     = 0;
+			std::uint32_t capacity = INLINE_SIZE;
+
+			unsigned char *data ()
+			{
+				return heapBuf ? heapBuf.get() : inlineBuf;
+			}
+
+			const unsigned char *data () const
+			{
+				return heapBuf ? heapBuf.get() : inlineBuf;
+			}
+
+			unsigned char *reserve (std::size_t size)
+			{
+				if (used + size > capacity)
+				{
+					std::uint32_t newCapacity = capacity * 2;
+					while (used + size > newCapacity)
+					{
+						newCapacity *= 2;
+					}
+					auto newBuf = std::make_unique<unsigned char []> (newCapacity);
+					std::memcpy (newBuf.get(), data(), used);
+					heapBuf  = std::move (newBuf);
+					capacity = newCapacity;
+				}
+				unsigned char *pos = data() + used;
+				used += static_cast<std::uint32_t> (size);
+				return pos;
+			}
+
+			// The longest size up to maxSize wich doesn't end inside an UTF-8 char
+			static std::size_t utf8Cut (const char *text, std::size_t size, std::size_t maxSize)
+			{
+				if (size <= maxSize)
+				{
+					return size;
+				}
+				std::size_t cut = maxSize;
+				while (cut > 0 && (static_cast<unsigned char> (text [cut]) & 0xC0) == 0x80)
+				{
+					cut--;
+				}
+				return cut;
+			}
+
+			void addEntry (std::string_view key, FieldType type, const void *value, std::size_t valueLen)
+			{
+				key = key.substr (0, utf8Cut (key.data(), key.size(), MAX_KEY_SIZE));
+				if (type == FieldType::STRING)
+				{
+					valueLen = utf8Cut (static_cast<const char *> (value), valueLen, MAX_VALUE_SIZE);
+				}
+
+				unsigned char *pos = reserve (ENTRY_HEADER + key.size() + valueLen);
+				pos [0]            = static_cast<unsigned char> (type);
+				pos [1]            = static_cast<unsigned char> (key.size());
+				pos [2]            = static_cast<unsigned char> (valueLen & 0xFF);
+				pos [3]            = static_cast<unsigned char> (valueLen >> 8);
+				std::memcpy (pos + ENTRY_HEADER, key.data(), key.size());
+				if (valueLen > 0)
+				{
+					std::memcpy (pos + ENTRY_HEADER + key.size(), value, valueLen);
+				}
+			}
+
+		public:
+			LogFields() = default;
+
+			LogFields (const LogFields &other)
+			{
+				*this = other;
+			}
+
+			LogFields &operator= (const LogFields &other)
+			{
+				if (this != &other)
+				{
+					used = 0;
+					std::memcpy (reserve (other.used), other.data(), other.used);
+				}
+				return *this;
+			}
+
+			LogFields (LogFields &&other) noexcept
+			{
+				*this = std::move (other);
+			}
+
+			LogFields &operator= (LogFields &&other) noexcept
+			{
+				if (this != &other)
+				{
+					if (other.heapBuf)
+					{
+						heapBuf  = std::move (other.heapBuf);
+						capacity = other.capacity;
+					}
+					else
+					{
+						heapBuf.reset();
+						capacity = INLINE_SIZE;
+						std::memcpy (inlineBuf, other.inlineBuf, other.used);
+					}
+					used           = other.used;
+					other.used     = 0;
+					other.capacity = INLINE_SIZE;
+				}
+				return *this;
+			}
+
+			bool empty () const
+			{
+				return used == 0;
+			}
+
+			void clear ()
+			{
+				used = 0;
+			}
+
+			// Appends all the fields of other
+			void append (const LogFields &other)
+			{
+				std::memcpy (reserve (other.used), other.data(), other.used);
+			}
+
+			//--- Add a field: the type is deduced from the value ---
+			void add (std::string_view key, bool value)
+			{
+				addEntry (key, FieldType::BOOL, &value, 1);
+			}
+
+			void add (std::string_view key, double value)
+			{
+				addEntry (key, FieldType::DOUBLE, &value, sizeof (value));
+			}
+
+			void add (std::string_view key, std::string_view value)
+			{
+				addEntry (key, FieldType::STRING, value.data(), value.size());
+			}
+
+			// Without it, the literals would be converted to bool
+			void add (std::string_view key, const char *value)
+			{
+				add (key, std::string_view (value));
+			}
+
+			void add (std::string_view key, const std::string &value)
+			{
+				add (key, std::string_view (value));
+			}
+
+			template <typename T>
+			    requires std::is_integral_v<T>
+			void add (std::string_view key, T value)
+			{
+				if constexpr (std::is_same_v<T, bool>)
+				{
+					add (key, static_cast<bool> (value));
+				}
+				else if constexpr (std::is_signed_v<T>)
+				{
+					std::int64_t v = value;
+					addEntry (key, FieldType::INT, &v, sizeof (v));
+				}
+				else
+				{
+					std::uint64_t v = value;
+					addEntry (key, FieldType::UINT, &v, sizeof (v));
+				}
+			}
+
+			template <typename T>
+			    requires std::is_floating_point_v<T>
+			void add (std::string_view key, T value)
+			{
+				add (key, static_cast<double> (value));
+			}
+
+			//--- Read them ---
+			template <typename Visitor> void forEach (Visitor &&visitor) const
+			{
+				const unsigned char *pos = data();
+				const unsigned char *end = pos + used;
+				while (pos < end)
+				{
+					FieldView field {};
+					field.type           = static_cast<FieldType> (pos [0]);
+					std::size_t keyLen   = pos [1];
+					std::size_t valueLen = pos [2] | (std::size_t (pos [3]) << 8);
+					const char *key      = reinterpret_cast<const char *> (pos + ENTRY_HEADER);
+					field.key            = std::string_view (key, keyLen);
+
+					const unsigned char *value = pos + ENTRY_HEADER + keyLen;
+					switch (field.type)
+					{
+					case FieldType::INT: std::memcpy (&field.intValue, value, sizeof (field.intValue)); break;
+					case FieldType::UINT: std::memcpy (&field.uintValue, value, sizeof (field.uintValue)); break;
+					case FieldType::DOUBLE: std::memcpy (&field.doubleValue, value, sizeof (field.doubleValue)); break;
+					case FieldType::BOOL: field.boolValue = (value [0] != 0); break;
+					case FieldType::STRING:
+						field.strValue = std::string_view (reinterpret_cast<const char *> (value), valueLen);
+						break;
+					}
+
+					visitor (field);
+					pos = value + valueLen;
+				}
+			}
+
+			// The first field with this key
+			bool find (std::string_view key, FieldView &found) const
+			{
+				bool isFound = false;
+				forEach ([&] (const FieldView &field) {
+					if (!isFound && field.key == key)
+					{
+						found   = field;
+						isFound = true;
+					}
+				});
+				return isFound;
+			}
+
+			// True if there is a field with this key, and its value as text is value
+			bool matches (std::string_view key, std::string_view value) const
+			{
+				FieldView field;
+				if (!find (key, field))
+				{
+					return false;
+				}
+				if (field.type == FieldType::STRING)
+				{
+					return field.strValue == value;
+				}
+				return field.toString() == value;
+			}
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+#endif    // _STREAM_LOGGER_FIELDS_H_
@@ -0,0 +1,404 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_FORMAT_H_
+#	define _STREAM_LOGGER_FORMAT_H_
+
+#	include <array>
+#	include <charconv>
+#	include <cstddef>
+#	include <cstdint>
+#	include <memory>
+#	include <source_location>
+#	include <sstream>
+#	include <string>
+#	include <string_view>
+#	include <tuple>
+#	include <type_traits>
+#	include <vector>
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	//-------------- Format strings: "user {} took {}ms" ----------------
+	// Supported: {} for any argument, {:x} for the integers, {:.Nf} (N up to 2 digits) for the floating point ones.
+	// "{{" and "}}" are the literal braces. The format string is checked, and parsed, when compiling
+
+	enum class FormatArgKind : std::uint8_t
+	{
+		INTEGER,
+		FLOATING,
+		OTHER
+	};
+
+	template <typename T> constexpr FormatArgKind formatArgKind ()
+	{
+		using Type = std::remove_cvref_t<T>;
+		if constexpr (std::is_integral_v<Type> && !std::is_same_v<Type, bool> && !std::is_same_v<Type, char>)
+		{
+			return FormatArgKind::INTEGER;
+		}
+		else if constexpr (std::is_floating_point_v<Type>)
+		{
+			return FormatArgKind::FLOATING;
+		}
+		else
+		{
+			return FormatArgKind::OTHER;
+		}
+	}
+
+	// Not constexpr: calling it while compiling the format string stops the compilation (see the message)
+	inline void formatStringError (const char *) {}
+
+	/**
+	 * A replacement field: the literal text before it, and how to write its argument
+	 */
+	struct FormatPiece
+	{
+			std::uint32_t begin   = 0;    // The text before the argument: [begin, end) of the format string
+			std::uint32_t end     = 0;
+			bool escaped          = false;    // The text has "{{" or "}}"
+			bool hex              = false;
+			std::int8_t precision = -1;    // Fixed notation: digits after the point
+	};
+
+	/**
+	 * The format string of a call with these arguments. Built (and checked) when compiling: consteval
+	 * It also captures the place of the call, as the "<<" loggers do
+	 */
+	template <typename... Args> class BasicFormatString
+	{
+		public:
+			std::string_view text;
+			std::source_location location;
+
+			// One per argument, and the last one has only the trailing text
+			std::array<FormatPiece, sizeof...(Args) + 1> pieces {};
+
+			template <typename Text>
+			    requires std::is_convertible_v<const Text &, std::string_view>
+			consteval BasicFormatString (const Text &format,
+			                             const std::source_location &location = std::source_location::current())
+			    : text (format)
+			    , location (location)
+			{
+				constexpr FormatArgKind kinds [] = {formatArgKind<Args>()..., FormatArgKind::OTHER};
+
+				std::size_t arg   = 0;
+				std::size_t begin = 0;
+				bool escaped      = false;
+				for (std::size_t i = 0; i < text.size(); i++)
+				{
+					if (text [i] == '}')
+					{
+						if (i + 1 >= text.size() || text [i + 1] != '}')
+						{
+							formatStringError ("Unmatched '}': use \"}}\" for a literal brace");
+						}
+						escaped = true;
+						i++;
+						continue;
+					}
+					if (text [i] != '{')
+					{
+						continue;
+					}
+					if (i + 1 < text.size() && text [i + 1] == '{')
+					{
+						escaped = true;
+						i++;
+						continue;
+					}
+
+					// A replacement field
+					if (arg >= sizeof...(Args))
+					{
+						formatStringError ("More {} in the format string than arguments");
+						return;
+					}
+					FormatPiece &piece = pieces [arg];
+					piece.begin        = static_cast<std::uint32_t> (begin);
+					piece.end          = static_cast<std::uint32_t> (i);
+					piece.escaped      = escaped;
+
+					std::size_t close = i + 1;
+					if (close < text.size() && text [close] == ':')
+					{
+						close++;
+						if (close < text.size() && text [close] == 'x')
+						{
+							if (kinds [arg] != FormatArgKind::INTEGER)
+							{
+								formatStringError ("{:x} is only for integers");
+							}
+							piece.hex = true;
+							close++;
+						}
+						else if (close + 2 < text.size() && text [close] == '.')
+						{
+							int digits = 0;
+							int count  = 0;
+							for (close++; close < text.size() && text [close] >= '0' && text [close] <= '9'; close++)
+							{
+								digits = digits * 10 + (text [close] - '0');
+								count++;
+							}
+							if (count == 0 || count > 2 || close >= text.size() || text [close] != 'f')
+							{
+								formatStringError ("Invalid precision: use {:.Nf}");
+							}
+							if (kinds [arg] != FormatArgKind::FLOATING)
+							{
+								formatStringError ("{:.Nf} is only for floating point numbers");
+							}
+							piece.precision = static_cast<std::int8_t> (digits);
+							close++;
+						}
+						else
+						{
+							formatStringError ("Unsupported format spec: use {}, {:x} or {:.Nf}");
+						}
+					}
+					if (close >= text.size() || text [close] != '}')
+					{
+						formatStringError ("Unterminated or invalid replacement field");
+					}
+
+					arg++;
+					begin   = close + 1;
+					escaped = false;
+					i       = close;
+				}
+
+				if (arg != sizeof...(Args))
+				{
+					formatStringError ("Less {} in the format string than arguments");
+				}
+				pieces [sizeof...(Args)].begin   = static_cast<std::uint32_t> (begin);
+				pieces [sizeof...(Args)].end     = static_cast<std::uint32_t> (text.size());
+				pieces [sizeof...(Args)].escaped = escaped;
+			}
+
+			template <typename... Values> void render (std::string &out, const Values &...values) const
+			{
+				static_assert (sizeof...(Values) == sizeof...(Args));
+				std::size_t arg = 0;
+				(renderPiece (out, pieces [arg++], values), ...);
+				appendText (out, pieces [sizeof...(Args)]);
+			}
+
+		private:
+			void appendText (std::string &out, const FormatPiece &piece) const
+			{
+				std::string_view literal = text.substr (piece.begin, piece.end - piece.begin);
+				if (!piece.escaped)
+				{
+					out.append (literal);
+					return;
+				}
+				for (std::size_t i = 0; i < literal.size(); i++)
+				{
+					// "{{" and "}}" are a single brace
+					out += literal [i];
+					bool brace = literal [i] == '{' || literal [i] == '}';
+					if (brace && i + 1 < literal.size() && literal [i + 1] == literal [i])
+					{
+						i++;
+					}
+				}
+			}
+
+			template <typename Value>
+			void renderPiece (std::string &out, const FormatPiece &piece, const Value &value) const
+			{
+				appendText (out, piece);
+				appendFormatValue (out, value, piece);
+			}
+
+			template <typename Value>
+			static void appendFormatValue (std::string &out, const Value &value, const FormatPiece &piece)
+			{
+				using Type = std::remove_cvref_t<Value>;
+				char buf [64];
+				if constexpr (std::is_same_v<Type, bool>)
+				{
+					out.append (value ? "true" : "false");
+				}
+				else if constexpr (std::is_same_v<Type, char>)
+				{
+					out += value;
+				}
+				else if constexpr (std::is_integral_v<Type>)
+				{
+					auto res = std::to_chars (buf, buf + sizeof (buf), value, piece.hex ? 16 : 10);
+					out.append (buf, res.ptr);
+				}
+				else if constexpr (std::is_floating_point_v<Type>)
+				{
+					auto res = (piece.precision >= 0)
+					               ? std::to_chars (buf, buf + sizeof (buf), value, std::chars_format::fixed,
+					                                piece.precision)
+					               : std::to_chars (buf, buf + sizeof (buf), value);
+					out.append (buf, (res.ec == std::errc {}) ? res.ptr : buf);
+				}
+				else if constexpr (std::is_convertible_v<const Type &, std::string_view>)
+				{
+					if constexpr (std::is_pointer_v<std::decay_t<Type>>)
+					{
+						if (value == nullptr)
+						{
+							out.append ("(null)");
+							return;
+						}
+					}
+					out.append (std::string_view (value));
+				}
+				else if constexpr (std::is_pointer_v<Type>)
+				{
+					auto res = std::to_chars (buf, buf + sizeof (buf), reinterpret_cast<std::uintptr_t> (value), 16);
+					out.append ("0x");
+					out.append (buf, res.ptr);
+				}
+				else
+				{
+					// Any other streamable type
+					std::ostringstream oss;
+					oss << value;
+					out.append (oss.str());
+				}
+			}
+	};
+
+	// The arguments don't take part in the deduction: they are deduced from the call
+	template <typename... Args> using FormatString = BasicFormatString<std::type_identity_t<Args>...>;
+
+	// The size of the last message of the thread: the next one is rendered straight into a string reserved with it
+	inline std::size_t &getFormatSizeHint ()
+	{
+		thread_local std::size_t sizeHint = 0;
+		return sizeHint;
+	}
+
+	// Appends the formatted text
+	template <typename... Args> void formatTo (std::string &out, FormatString<Args...> format, const Args &...args)
+	{
+		format.render (out, args...);
+	}
+
+	//-------------- Deferred formatting ----------------
+
+	/**
+	 * A message wich is not formatted yet: only its arguments have been captured (see StaticLogger::logDeferred)
+	 * Rendered once, by the first output wich needs the text: the discarded events are never formatted
+	 */
+	class TextRope;
+
+	class DeferredText
+	{
+		public:
+			virtual ~DeferredText() = default;
+			virtual void render (std::string &out) const = 0;
+
+			// Only the TextRope ones: its pieces can be written without building the text
+			virtual const TextRope *asRope () const
+			{
+				return nullptr;
+			}
+	};
+
+	typedef std::shared_ptr<const DeferredText> DeferredTextPtr;
+
+	/**
+	 * A big text, kept as the list of its pieces: an append is O(1), and the pieces are not copied into a single
+	 * string. The sinks wich write the text as is (TextFormatter) write the pieces with a gather write
+	 * The pieces are never modified: the copies of a rope share them
+	 */
+	class TextRope final : public DeferredText
+	{
+		private:
+			std::vector<std::shared_ptr<const std::string>> chunks;
+			std::size_t length = 0;
+
+		public:
+			void append (std::string &&chunk)
+			{
+				if (!chunk.empty())
+				{
+					this->length += chunk.size();
+					this->chunks.push_back (std::make_shared<const std::string> (std::move (chunk)));
+				}
+			}
+
+			// The pieces of other rope are shared, not copied
+			void append (const DeferredText &text)
+			{
+				if (const TextRope *rope = text.asRope())
+				{
+					this->chunks.insert (this->chunks.end(), rope->chunks.begin(), rope->chunks.end());
+					this->length += rope->length;
+				}
+				else
+				{
+					std::string rendered;
+					text.render (rendered);
+					this->append (std::move (rendered));
+				}
+			}
+
+			std::size_t size () const
+			{
+				return this->length;
+			}
+
+			const std::vector<std::shared_ptr<const std::string>> &getChunks () const
+			{
+				return this->chunks;
+			}
+
+			void render (std::string &out) const override
+			{
+				out.reserve (out.size() + this->length);
+				for (auto &chunk : this->chunks)
+				{
+					out += *chunk;
+				}
+			}
+
+			const TextRope *asRope () const override
+			{
+				return this;
+			}
+	};
+
+	// The captured copy of an argument: the text ones are copied, as the pointers may not live until the render
+	template <typename T>
+	using DeferredArg = std::conditional_t<std::is_convertible_v<const std::decay_t<T> &, std::string_view>
+	                                           && !std::is_same_v<std::decay_t<T>, std::string>,
+	                                       std::string, std::decay_t<T>>;
+
+	template <typename... Args> class DeferredFormat final : public DeferredText
+	{
+		private:
+			BasicFormatString<Args...> format;
+			std::tuple<DeferredArg<Args>...> args;
+
+		public:
+			DeferredFormat (const BasicFormatString<Args...> &format, const Args &...args)
+			    : format (format)
+			    , args (args...)
+			{
+			}
+
+			void render (std::string &out) const override
+			{
+				std::apply ([&] (const auto &...values) { this->format.render (out, values...); }, this->args);
+			}
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _STREAM_LOGGER_FORMAT_H_
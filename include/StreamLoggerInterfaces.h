@@ -13,26 +13,75 @@
 #	else
 #		define LGGR_API
 #	endif
+#	ifndef DEPRECATED
+#		define DEPRECATED [[deprecated]]
+#	endif
 
+#	include <cstdint>
 #	include <string>
+#	include <string_view>
 
 #	include "StreamLoggerConsts.h"
+#	include "EventContainer.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
 	// ----------------------   Util functions -------------------------------------
-	const LGGR_API std::string &getLevelName (const LogLevel logLevel);
+	// A constant table: it can be used at any time, even from the static initializers of other units
+	LGGR_API std::string_view getLevelName (const LogLevel logLevel);
+
+	// The former signature of getLevelName (a return type can't be overloaded): for the code wich needs a
+	// std::string reference. Built on its first call, so not for the static initializers
+	DEPRECATED LGGR_API const std::string &getLevelNameString (const LogLevel logLevel);
+
+	// The index of the calling thread (EventContainer::threadIndex): 1, 2... in the order they first log
+	LGGR_API std::uint32_t getThreadIndex ();
+
+	// The name given to the thread with Config::setThreadName (empty if none). Valid until the process ends
+	LGGR_API std::string_view getThreadName (std::uint32_t threadIndex);
 
-	//  We cant use std::string_view because in multi-threading, the subyacent string could be deleted
 	//--- Retrieve the generated events ---
+	// onLogEvent gets strings, not views: the subscriber may keep them, and the events of the stack may be removed
+	// by other threads. The names above are views because they live until the process ends
 	class LogEventsSubscriber
 	{
 		public:
 			virtual void onLogEvent (const std::string &date, const std::string logTxt, const LogLevel logLevel) = 0;
+
+			// Override it to receive the whole event (fields, time points...). By default, calls onLogEvent
+			virtual void onLogRecord (const EventContainer &event)
+			{
+				if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+				{
+					// Built with its size: a single allocation
+					std::string text;
+					text.reserve (event.event.size() + TIMED_TAG.size() + event.usedTimeTxt.size());
+					text += event.event;
+					text += TIMED_TAG;
+					text += event.usedTimeTxt;
+					onLogEvent (event.date, std::move (text), event.logLevel);
+				}
+				else
+				{
+					onLogEvent (event.date, event.event, event.logLevel);
+				}
+			}
 	};
 
 	LGGR_API void pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+
+	// Only the events with the field fieldKey, whose value (as text) is fieldValue
+	LGGR_API void pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel, std::string_view fieldKey,
+	                             std::string_view fieldValue);
 	LGGR_API void subscribePushEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
 
+	// The events the previous run left in the flight recorder (see Config::setFlightRecorder)
+	// Only the text, level, date and duration are recorded: no fields nor call sites
+	LGGR_API void pullPreviousRunEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+
+	// The events of any flight recorder file (p.e. of other process). False if it's not a recorder file
+	LGGR_API bool pullRecorderFileEvents (const std::string &filePath, LogEventsSubscriber &subscriber,
+	                                      const LogLevel logLevel);
+
 }    // namespace IgnacioPomar::Util::StreamLogger
 #endif    // __STREAM_LOGGER_INTERFACES_H
@@ -0,0 +1,107 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_LOG_INDEX_H_
+#	define _STREAM_LOGGER_LOG_INDEX_H_
+
+#	if __has_include("lggrExportCfg.h")
+#		include "lggrExportCfg.h"
+#	else
+#		define LGGR_API
+#	endif
+
+#	include <cstddef>
+#	include <cstdint>
+#	include <string>
+#	include <vector>
+
+#	include "StreamLoggerConsts.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	//-------------- Index file layout (version 1) ----------------
+	// The index of a log file is the file "<log file>.idx": a LogIndexHeader followed by LogIndexEntry records.
+	// Each entry is a block of consecutive events of the log: [offset, endOffset) in bytes. The file sink appends
+	// the entry when the block is complete (or the file is closed): the events after the last entry are not indexed.
+	// All the integers are in the native byte order of the host.
+
+	constexpr std::uint32_t LOG_INDEX_MAGIC   = 0x58494C53;    // "SLIX"
+	constexpr std::uint32_t LOG_INDEX_VERSION = 1;
+
+	struct LogIndexHeader
+	{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t interval;    // Events per entry (the last block of each run may have less)
+			std::uint32_t reserved;
+	};
+
+	struct LogIndexEntry
+	{
+			std::uint64_t offset;
+			std::uint64_t endOffset;
+			std::int64_t firstTimestampNs;    // system_clock, since the epoch. The oldest event of the block
+			std::int64_t lastTimestampNs;     // The newest (the events of a block may be out of order)
+			std::uint32_t eventCount;
+			std::uint32_t levelMask;    // Bit (1 << level) for each level in the block
+	};
+	static_assert (sizeof (LogIndexEntry) == 40, "The index entry layout must not change");
+
+	constexpr std::uint32_t levelBit (LogLevel logLevel)
+	{
+		return 1u << static_cast<std::uint8_t> (logLevel);
+	}
+
+	// All the levels from logLevel up
+	constexpr std::uint32_t levelMaskFrom (LogLevel logLevel)
+	{
+		return (logLevel == LogLevel::OFF) ? 0 : (0x3Fu & ~(levelBit (logLevel) - 1));
+	}
+
+#	ifndef _WIN32
+	/**
+	 * Read only view of an index file (memory mapped)
+	 */
+	class LGGR_API LogIndexReader
+	{
+		private:
+			void *mapping          = nullptr;
+			std::size_t mappedSize = 0;
+			const LogIndexHeader *header = nullptr;
+			const LogIndexEntry *entries = nullptr;
+			std::size_t entryCount       = 0;
+
+			// Prevent illegal usage
+			LogIndexReader (const LogIndexReader &)            = delete;    // no copies
+			LogIndexReader &operator= (const LogIndexReader &) = delete;    // no self-assignments
+
+		public:
+			LogIndexReader() = default;
+			~LogIndexReader();
+
+			// False if it doesn't exist, or it's not an index
+			bool open (const std::string &indexFile);
+			void close ();
+			bool isOpen () const;
+
+			std::size_t size () const;
+			const LogIndexEntry *begin () const;
+			const LogIndexEntry *end () const;
+
+			// Where the not indexed events start (0 if there are no entries)
+			std::uint64_t getIndexedEnd () const;
+
+			// The blocks wich may have events of the levels in levelMask between fromNs and toNs (both included)
+			// The skew is the allowed disorder of the timestamps between blocks
+			std::vector<const LogIndexEntry *> find (std::int64_t fromNs, std::int64_t toNs, std::uint32_t levelMask,
+			                                         std::int64_t skewNs = 1'000'000'000) const;
+	};
+#	endif    // _WIN32
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _STREAM_LOGGER_LOG_INDEX_H_
@@ -0,0 +1,158 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_SHM_RING_H_
+#	define _STREAM_LOGGER_SHM_RING_H_
+
+// POSIX shared memory (shm_open + mmap): not available in windows
+#	ifndef _WIN32
+
+#		if __has_include("lggrExportCfg.h")
+#			include "lggrExportCfg.h"
+#		else
+#			define LGGR_API
+#		endif
+
+#		include <atomic>
+#		include <cstdint>
+#		include <string>
+#		include <string_view>
+
+#		include "StreamLoggerConsts.h"
+#		include "StreamLoggerSinks.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	//-------------- Shared memory layout (version 1) ----------------
+	// The segment is a ShmRingHeader followed by slotCount slots of slotSize bytes. Each slot starts with a
+	// ShmSlotHeader, followed by the text (UTF-8, not null terminated, truncated to fit in the slot).
+	// All the integers are in the native byte order of the host: the consumer must run in the same machine.
+	//
+	// It is a bounded MPSC queue (D. Vyukov algorithm), with a sequence number in each slot:
+	//  - The slot for the position pos is slots [pos % slotCount]
+	//  - sequence == pos                : free, the producer wich reserves pos (CAS in writePos) can fill it
+	//  - sequence == pos + 1            : published, the consumer can read it
+	//  - consumer releases it storing     pos + slotCount, and advances readPos
+	// If the slot is not free, the ring is full: the producer drops the event and increments dropped. Never blocks.
+
+	constexpr std::uint32_t SHM_RING_MAGIC   = 0x52474C53;    // "SLGR"
+	constexpr std::uint32_t SHM_RING_VERSION = 1;
+
+	constexpr std::uint8_t SHM_SLOT_FLAG_TRUNCATED = 0x01;
+
+	struct ShmRingHeader
+	{
+			std::uint32_t magic;    // Written the last one, when the segment is ready
+			std::uint32_t version;
+			std::uint32_t slotSize;     // Power of two, including the ShmSlotHeader
+			std::uint32_t slotCount;    // Power of two
+			std::int64_t producerPid;
+			std::uint64_t reserved [5];
+
+			alignas (64) std::atomic<std::uint64_t> writePos;    // Next position to reserve by the producers
+			alignas (64) std::atomic<std::uint64_t> readPos;     // Next position to read by the consumer
+			alignas (64) std::atomic<std::uint64_t> dropped;     // Events lost because the ring was full
+	};
+
+	struct ShmSlotHeader
+	{
+			std::atomic<std::uint64_t> sequence;
+			std::int64_t timestampNs;    // system_clock, since epoch
+			std::int64_t durationNs;     // Only in finished timed events, 0 otherwise
+			std::uint8_t logLevel;       // LogLevel
+			std::uint8_t eventType;      // EVENT_TYPE_*
+			std::uint8_t flags;          // SHM_SLOT_FLAG_*
+			std::uint8_t reserved;
+			std::uint32_t textLength;
+	};
+
+	static_assert (sizeof (ShmSlotHeader) == 32, "The slot header is part of the shared memory layout");
+	static_assert (sizeof (ShmRingHeader) == 256, "The ring header is part of the shared memory layout");
+	static_assert (std::atomic<std::uint64_t>::is_always_lock_free, "The ring needs address free atomics");
+
+	//-------------- Producer ----------------
+
+	/**
+	 * Publishes the events in a POSIX shared memory ring, for an out of process consumer (see ShmRingReader)
+	 * The publication is lock free: it can be used INLINE, even shared between channels
+	 */
+	class LGGR_API ShmRingSink : public LogSink
+	{
+		private:
+			std::string shmName;
+			ShmRingHeader *header = nullptr;
+			unsigned char *slots  = nullptr;
+			std::size_t mappedSize = 0;
+			std::uint64_t slotMask = 0;
+
+		protected:
+			void write (const EventContainer &event) override;
+
+		public:
+			// name must start with '/' (see shm_open). slotSize and slotCount are rounded up to a power of two
+			ShmRingSink (const std::string &name, LogLevel level, std::uint32_t slotSize = DEFAULTS::SHM_SLOT_SIZE,
+			             std::uint32_t slotCount = DEFAULTS::SHM_SLOT_COUNT);
+			~ShmRingSink();
+
+			bool isOpen () const;
+			std::uint64_t getDropped () const;
+	};
+
+	//-------------- Consumer ----------------
+
+	/**
+	 * An event read from the ring. The text points to the buffer passed to ShmRingReader::read
+	 */
+	struct ShmEvent
+	{
+			std::int64_t timestampNs;
+			std::int64_t durationNs;
+			LogLevel logLevel;
+			std::uint8_t eventType;
+			bool truncated;
+			std::string_view text;
+	};
+
+	/**
+	 * Single consumer of a ring created by a ShmRingSink (in this or in other process)
+	 */
+	class LGGR_API ShmRingReader
+	{
+		private:
+			std::string shmName;
+			ShmRingHeader *header = nullptr;
+			unsigned char *slots  = nullptr;
+			std::size_t mappedSize = 0;
+			std::uint64_t slotMask = 0;
+			std::uint64_t inode    = 0;
+
+			// Prevent illegal usage
+			ShmRingReader (const ShmRingReader &)            = delete;    // no copies
+			ShmRingReader &operator= (const ShmRingReader &) = delete;    // no self-assignments
+
+		public:
+			ShmRingReader (const std::string &name);
+			~ShmRingReader();
+
+			// Returns false if the producer has not created the ring yet
+			bool open ();
+			void close ();
+			bool isOpen () const;
+
+			// True if the producer has created a new ring (p.e. has been restarted): close and open again
+			bool isStale () const;
+
+			// Returns false if there are no events. The text is copied in buffer, and the slot is released
+			bool read (ShmEvent &event, std::string &buffer);
+
+			std::uint64_t getDropped () const;
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#	endif    // _WIN32
+#endif        // _STREAM_LOGGER_SHM_RING_H_
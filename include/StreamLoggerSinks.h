@@ -0,0 +1,330 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_SINKS_H_
+#	define _STREAM_LOGGER_SINKS_H_
+
+#	if __has_include("lggrExportCfg.h")
+#		include "lggrExportCfg.h"
+#	else
+#		define LGGR_API
+#	endif
+
+#	include <atomic>
+#	include <chrono>
+#	include <condition_variable>
+#	include <list>
+#	include <memory>
+#	include <mutex>
+#	include <string>
+#	include <thread>
+#	include <vector>
+
+#	include "StreamLoggerConsts.h"
+#	include "StreamLoggerInterfaces.h"
+#	include "EventContainer.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	class LogIndexWriter;
+
+	enum class SinkMode : std::uint8_t
+	{
+		INLINE,    // Written by the thread that logs (inside the logger lock, in the MultiThreadSafe flavor)
+		ASYNC      // Queued, and written in batches by a worker thread owned by the sink
+	};
+
+	//-------------- Formatters ----------------
+
+	/**
+	 * Converts an event in a line of text (without the line break)
+	 * It may be shared between sinks and threads: it must not keep state
+	 */
+	class LGGR_API LogFormatter
+	{
+		public:
+			virtual ~LogFormatter() = default;
+
+			// Appends the formatted event to out
+			virtual void format (const EventContainer &event, std::string &out) const = 0;
+
+			// True if the text goes in the line as is, between a prefix and a suffix (see formatAround)
+			virtual bool writesTextAsIs () const;
+
+			// Only if writesTextAsIs: the line without the text. The sinks write a big text (a rope) between them
+			virtual void formatAround (const EventContainer &event, std::string &prefix, std::string &suffix) const;
+	};
+
+	/**
+	 * The classic format: "date [LEVEL]\ttext", and "\tDone in: ..." for the finished timed events
+	 * withThread adds "\tthread=n" (and "\tthread_name=name" if the thread has one) after them
+	 */
+	class LGGR_API TextFormatter : public LogFormatter
+	{
+		private:
+			const bool withThread;
+
+		public:
+			TextFormatter (bool withThread = false);
+
+			void format (const EventContainer &event, std::string &out) const override;
+			bool writesTextAsIs () const override;
+			void formatAround (const EventContainer &event, std::string &prefix, std::string &suffix) const override;
+	};
+
+	/**
+	 * JSON Lines: a json object for each event. duration_ns is only in the finished timed events, and site (the
+	 * file:line of the call) in the events of a known call site
+	 * {"ts":"2024-04-17T15:28:07.212848900Z","level":"INFO","msg":"...","duration_ns":1234,"site":"src/main.cpp:42"}
+	 */
+	class LGGR_API JsonLinesFormatter : public LogFormatter
+	{
+		public:
+			void format (const EventContainer &event, std::string &out) const override;
+	};
+
+	/**
+	 * logfmt: key=value pairs, with the values quoted only when needed
+	 * ts=2024-04-17T15:28:07.212848900Z level=INFO msg="..." duration_ns=1234 site=src/main.cpp:42
+	 */
+	class LGGR_API LogfmtFormatter : public LogFormatter
+	{
+		public:
+			void format (const EventContainer &event, std::string &out) const override;
+	};
+
+	//-------------- Sinks ----------------
+
+	/**
+	 * An output for the events: the logger fans out each event to all its sinks
+	 * Derived classes implement write (and optionally writeBatch and flush)
+	 * IMPORTANT: derived classes must call stopWorker() in its destructor, so the worker does not use a half
+	 * destroyed object
+	 */
+	class LGGR_API LogSink
+	{
+		private:
+			const SinkMode mode;
+
+			//--- Async worker ---
+			std::mutex queueMtx;
+			std::condition_variable queueCv;
+			std::vector<EventContainer> queue;
+			std::thread worker;
+			bool stopping = false;
+			std::chrono::milliseconds idleInterval {0};
+			std::size_t writing = 0;    // The batch of the worker
+			bool busy           = false;    // The worker is writing (or in onIdle), out of the lock
+			std::condition_variable idleCv;    // Notified when the worker stops being busy
+			std::size_t maxQueued = DEFAULTS::SINK_QUEUE;    // See setQueueLimit
+			std::atomic<std::uint64_t> queueDropped {0};
+			std::uint64_t reportedDrops = 0;    // Only the worker
+
+			//--- Overload monitoring ---
+			std::atomic<std::size_t> queueDepth {0};
+			std::atomic<std::uint64_t> writeNs {0};
+			std::atomic<std::uint64_t> timedEvents {0};
+			std::atomic<std::uint32_t> inlineWrites {0};
+
+			void workerLoop ();
+			void setIdle ();    // Inside the queue lock
+			void addWriteTime (std::chrono::steady_clock::time_point start, std::size_t events);
+
+			// Prevent illegal usage
+			LogSink (const LogSink &)            = delete;    // no copies
+			LogSink &operator= (const LogSink &) = delete;    // no self-assignments
+
+		protected:
+			std::atomic<LogLevel> level;
+
+			// It can be replaced while the sink writes: each write (or batch) uses the copy it gets
+			// A lock, not std::atomic<std::shared_ptr>: the libstdc++ 12 one is not race free (relaxed unlock in load)
+			mutable std::mutex formatterMtx;
+			std::shared_ptr<const LogFormatter> formatter;
+			std::shared_ptr<const LogFormatter> getFormatter () const;
+
+			// The rope of the event, if this formatter writes it as is (it may have been replaced since writesRopes)
+			static const TextRope *getRope (const LogFormatter &formatter, const EventContainer &event);
+
+			// Formats the event, with its text rendered if it was left as a rope
+			static void formatEvent (const LogFormatter &formatter, const EventContainer &event, std::string &out);
+
+			//--- Error reporting: the logger will generate an ERROR event with them ---
+			std::mutex errorsMtx;
+			std::vector<std::string> pendingErrors;
+			std::atomic<bool> hasPendingErrors {false};
+
+			void reportError (const std::string &error);
+			void stopWorker ();
+
+			// Async mode: call onIdle from the worker when there are no events for this time (0 = never)
+			void setIdleInterval (std::chrono::milliseconds interval);
+
+			// Async mode: the events beyond this many queued ones are dropped (DEFAULTS::SINK_QUEUE by default)
+			void setQueueLimit (std::size_t maxEvents);
+
+			virtual void write (const EventContainer &event) = 0;
+			virtual void writeBatch (const std::vector<EventContainer> &events);
+			virtual void flush ();
+			virtual void onIdle ();
+
+			// Called by drain, with the queue written and the worker waiting: the last chance to write (p.e. a buffer)
+			virtual void onShutdown ();
+
+		public:
+			LogSink (LogLevel level, SinkMode mode = SinkMode::INLINE);
+			virtual ~LogSink();
+
+			// Changing the level of an attached sink must be done through Config (or Channel), or the logger will not
+			// notice that it must generate events for the new level
+			void setLevel (LogLevel logLevel);
+			LogLevel getLevel () const;
+			SinkMode getMode () const;
+
+			void setFormatter (std::shared_ptr<const LogFormatter> newFormatter);
+
+			// Called by the logger: filters by level, and writes it or queues it
+			void submit (const EventContainer &event);
+
+			// Would it write the event? (its level, or forced)
+			bool accepts (const EventContainer &event) const;
+
+			// Does it write the pieces of a rope (see TextRope)? If not, the text is built before it gets the event
+			virtual bool writesRopes () const;
+
+			bool takeErrors (std::vector<std::string> &errors);
+
+			// Overload monitoring: the events wich wait for the worker (async mode), and the mean time of writing an
+			// event since the last call (0 if none was timed)
+			std::size_t getQueueDepth () const;
+			std::chrono::nanoseconds takeWriteLatency ();
+
+			// Async mode: the events dropped because the queue was full. The worker reports them as an error too
+			std::uint64_t getQueueDropped () const;
+
+			// Waits for the queued events to be written (up to the deadline), and calls onShutdown. False on timeout
+			bool drain (std::chrono::steady_clock::time_point deadline);
+
+			// fork(): prepareFork waits for the worker to finish its batch, and takes the locks of the sink. In the
+			// child, the output pending in the copy is left to the parent (it writes it), and the worker restarted
+			// The derived classes wich override them must call the LogSink ones
+			virtual void prepareFork ();
+			virtual void afterFork (bool child);
+	};
+
+	/**
+	 * Writes to the console (std::clog), with a color for each level
+	 */
+	class LGGR_API ConsoleSink : public LogSink
+	{
+		private:
+			std::atomic<LogColor> levelColors [6];
+
+		protected:
+			void write (const EventContainer &event) override;
+
+		public:
+			ConsoleSink (LogLevel level, SinkMode mode = SinkMode::INLINE);
+			~ConsoleSink();
+
+			bool writesRopes () const override;
+
+			void setLevelColor (LogLevel logLevel, LogColor logColor);
+	};
+
+	/**
+	 * Writes to a file, rotating each day if the file pattern has a %d
+	 * Unbuffered file descriptor, with its own block buffer: the crash handler can flush it
+	 */
+	class LGGR_API FileSink : public LogSink
+	{
+		private:
+			std::mutex fileMtx;    // The config can be changed while the worker (or other channel) writes
+			std::atomic<int> fd {-1};
+			std::unique_ptr<char []> buffer;
+			std::atomic<std::size_t> buffered {0};
+
+			// Side index (see StreamLoggerLogIndex.h): fileOffset is the size of the file, pending buffer included
+			std::uint32_t indexInterval = 0;
+			std::unique_ptr<LogIndexWriter> index;
+			std::uint64_t fileOffset = 0;
+
+			std::chrono::year_month_day lastLogDate;
+			std::string logPath;
+			std::string logFilename;
+			std::string logFilePattern;
+			bool hasRotation;
+
+			void checkRotation (const EventContainer &event);
+			void openFile ();
+			void closeFile ();
+			void flushBuffer ();
+			// Returns the offset where the lines start, or false if the file is not open
+			bool writeLines (const EventContainer &firstEvent, const std::string &lines, std::uint64_t &offset);
+			// The same, for the line of an event with a rope: the pending block and the pieces in a gather write
+			bool writeRope (const LogFormatter &formatter, const EventContainer &event, const TextRope &rope,
+			                std::uint64_t &offset);
+			void indexEvent (const EventContainer &event, std::uint64_t offset);
+
+		protected:
+			void write (const EventContainer &event) override;
+			void writeBatch (const std::vector<EventContainer> &events) override;
+			void flush () override;
+			void onShutdown () override;
+
+		public:
+			FileSink (LogLevel level, const std::string &filePattern, SinkMode mode = SinkMode::INLINE);
+			~FileSink();
+
+			bool writesRopes () const override;
+
+			void setOutFile (const std::string &fileName);    // It'll rotate each day if the template has a %d
+			void setOutPath (const std::string &filePath);
+
+			// Writes a "<log file>.idx" side index, with an entry each eventsPerEntry events. 0 disables it
+			void setIndexInterval (std::uint32_t eventsPerEntry);
+
+			// Async-signal-safe, without locks: only for the crash handler (a line being written may be cut)
+			void flushOnCrash ();
+
+			void prepareFork () override;
+			void afterFork (bool child) override;
+	};
+
+	/**
+	 * Sends the events to the push subscribers (see subscribePushEvents)
+	 */
+	class LGGR_API SubscriberSink : public LogSink
+	{
+		private:
+			class EventSubscriber
+			{
+				public:
+					EventSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+					LogEventsSubscriber &subscriber;
+					const LogLevel logLevel;
+			};
+
+			std::mutex subscribersMtx;
+			std::list<EventSubscriber> subscribers;
+
+		protected:
+			void write (const EventContainer &event) override;
+
+		public:
+			SubscriberSink (SinkMode mode = SinkMode::INLINE);
+			~SubscriberSink();
+
+			// The sink level is the lowest of the subscribers levels
+			void addSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel);
+
+			void prepareFork () override;
+			void afterFork (bool child) override;
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+#endif    // _STREAM_LOGGER_SINKS_H_
@@ -0,0 +1,98 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _STREAM_LOGGER_SOCKET_SINK_H_
+#	define _STREAM_LOGGER_SOCKET_SINK_H_
+
+// UNIX domain sockets: not available in windows
+#	ifndef _WIN32
+
+#		if __has_include("lggrExportCfg.h")
+#			include "lggrExportCfg.h"
+#		else
+#			define LGGR_API
+#		endif
+
+#		include <atomic>
+#		include <chrono>
+#		include <cstdint>
+#		include <deque>
+#		include <string>
+#		include <vector>
+
+#		include "StreamLoggerConsts.h"
+#		include "StreamLoggerSinks.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	enum class SocketType : std::uint8_t
+	{
+		STREAM,      // Each frame is a 32 bits big endian length, followed by the lines
+		DATAGRAM     // Each datagram is a frame with the lines
+	};
+
+	/**
+	 * Streams the events to a local UNIX domain socket (p.e. a log shipping agent)
+	 * Always ASYNC: the connection and the sends are done by the sink worker, never by the thread that logs.
+	 * The events of each batch are packed in frames of formatted lines ('\n' terminated). While the agent is down,
+	 * the frames are kept in a bounded spill buffer (the oldest ones are dropped) and the sink reconnects with
+	 * exponential backoff.
+	 */
+	class LGGR_API UnixSocketSink : public LogSink
+	{
+		private:
+			struct SpilledFrame
+			{
+					std::string frame;
+					std::uint32_t events;
+			};
+
+			const std::string socketPath;
+			const SocketType socketType;
+			const std::size_t maxSpillBytes;
+
+			int fd = -1;
+			std::deque<SpilledFrame> spill;
+			std::size_t spillBytes = 0;
+
+			std::chrono::steady_clock::time_point nextConnect;
+			std::chrono::milliseconds backoff;
+
+			std::atomic<bool> connected {false};
+			std::atomic<std::uint64_t> dropped {0};
+
+			bool connectSocket ();
+			void disconnect ();
+			// True when the frame is done with: sent, or dropped because it is too big for a datagram
+			bool sendFrame (const std::string &frame, std::uint32_t events);
+			void spillFrame (std::string &&frame, std::uint32_t events);
+			void sendSpill ();
+			void sendOrSpill (std::string &frame, std::uint32_t events);
+
+		protected:
+			void write (const EventContainer &event) override;
+			void writeBatch (const std::vector<EventContainer> &events) override;
+			void onIdle () override;
+			void onShutdown () override;
+
+		public:
+			UnixSocketSink (const std::string &socketPath, LogLevel level, SocketType socketType = SocketType::STREAM,
+			                std::size_t maxSpillBytes = DEFAULTS::SOCKET_SPILL_SIZE);
+			~UnixSocketSink();
+
+			bool isConnected () const;
+
+			// Events lost because the spill buffer was full, or because a datagram was too big for the socket
+			std::uint64_t getDropped () const;
+
+			void afterFork (bool child) override;
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#	endif    // _WIN32
+#endif        // _STREAM_LOGGER_SOCKET_SINK_H_
@@ -0,0 +1,704 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "StreamLoggerCallSites.h"
+#include "StackLogger.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	namespace
+	{
+		// Enabled or disabled by file, also the sites not registered yet
+		struct PendingEnabled
+		{
+				std::string file;
+				std::uint32_t line;
+				bool enabled;
+		};
+
+		// An override by file, also for the sites not registered yet
+		struct PendingOverride
+		{
+				std::string file;
+				std::uint32_t line;
+				LogLevel level;
+				std::int64_t expiry;
+		};
+
+		// The same for the sampling
+		struct PendingSampling
+		{
+				std::string file;
+				std::uint32_t line;
+				SamplingMode mode;
+				std::uint32_t n;
+				std::int64_t intervalNs;
+		};
+
+		/**
+		 * The registered sites, read without the lock: by location (open addressing, half full at most) and by id
+		 * Only the registry lock writes it. When it's full a bigger one is published, and the old one is kept: a
+		 * reader may still be probing it
+		 */
+		struct SiteTable
+		{
+				SiteTable (std::size_t capacity)
+				    : mask (capacity - 1)
+				    , slots (std::make_unique<std::atomic<CallSite *> []> (capacity))
+				    , byId (std::make_unique<std::atomic<CallSite *> []> (capacity / 2))
+				{
+				}
+
+				const std::size_t mask;
+				std::unique_ptr<std::atomic<CallSite *> []> slots;
+				std::unique_ptr<std::atomic<CallSite *> []> byId;    // id - 1
+				std::size_t size = 0;    // Only for the writer
+		};
+
+		struct CallSiteRegistry
+		{
+				std::mutex mtx;
+				std::deque<CallSite> sites;    // deque: the addresses never change
+				std::atomic<SiteTable *> table {nullptr};
+				std::vector<std::unique_ptr<SiteTable>> tables;    // The current one is the last
+				std::vector<PendingEnabled> pendingEnabled;        // In order: the last matching one wins
+				std::vector<PendingOverride> pendingOverrides;
+				std::vector<PendingSampling> pendingSamplings;
+
+				// The lowest override of any site: the loggers lower their effective level to it
+				std::atomic<LogLevel> overrideLevel {LogLevel::OFF};
+		};
+
+		// Function static: the loggers may be used in the static init of other units
+		// Never destroyed: the threads wich log while the process exits keep its sites
+		CallSiteRegistry &getRegistry()
+		{
+			static CallSiteRegistry *registry = [] {
+				auto created = new CallSiteRegistry;
+				created->tables.push_back (std::make_unique<SiteTable> (64));
+				created->table.store (created->tables.back().get(), std::memory_order_release);
+				return created;
+			}();
+			return *registry;
+		}
+
+		// By the name of the file: the same site from several units is only one
+		std::size_t hashLocation (std::string_view file, std::uint32_t line, std::uint32_t column)
+		{
+			std::uint64_t key = std::hash<std::string_view>() (file);
+			key ^= static_cast<std::uint64_t> (line) << 32 | column;
+			key ^= key >> 33;
+			key *= 0xFF51AFD7ED558CCDull;
+			key ^= key >> 33;
+			return key;
+		}
+
+		// Lock free
+		CallSite *findSite (const SiteTable &table, const char *file, std::uint32_t line, std::uint32_t column)
+		{
+			for (std::size_t slot = hashLocation (file, line, column) & table.mask;; slot = (slot + 1) & table.mask)
+			{
+				CallSite *site = table.slots [slot].load (std::memory_order_acquire);
+				if (site == nullptr)
+				{
+					return nullptr;
+				}
+				if (site->line == line && site->column == column && std::strcmp (site->file.c_str(), file) == 0)
+				{
+					return site;
+				}
+			}
+		}
+
+		// With the site filled: the readers may find it as soon as it's stored
+		void addToTable (SiteTable &table, CallSite &site)
+		{
+			std::size_t slot = hashLocation (site.file, site.line, site.column) & table.mask;
+			while (table.slots [slot].load (std::memory_order_relaxed) != nullptr)
+			{
+				slot = (slot + 1) & table.mask;
+			}
+			table.byId [site.id - 1].store (&site, std::memory_order_release);
+			table.slots [slot].store (&site, std::memory_order_release);
+			table.size++;
+		}
+
+		// With the registry locked: the new site is the last one of sites
+		void publishSite (CallSiteRegistry &registry, CallSite &site)
+		{
+			SiteTable *table = registry.table.load (std::memory_order_relaxed);
+			if (registry.sites.size() * 2 > table->mask + 1)
+			{
+				auto bigger = std::make_unique<SiteTable> ((table->mask + 1) * 2);
+				for (auto &registered : registry.sites)
+				{
+					addToTable (*bigger, registered);
+				}
+				table = bigger.get();
+				registry.tables.push_back (std::move (bigger));
+				registry.table.store (table, std::memory_order_release);
+				return;
+			}
+			addToTable (*table, site);
+		}
+
+		// Per thread cache: the pointer of the file name is the same for each site of a compilation unit
+		struct CacheEntry
+		{
+				const char *file;
+				std::uint32_t line;
+				std::uint32_t column;
+				CallSite *site;
+		};
+
+		// Two ways per set: two hot sites with the same set don't evict each other
+		constexpr std::size_t CACHE_SETS = 128;
+		constexpr std::size_t CACHE_WAYS = 2;
+		thread_local CacheEntry cache [CACHE_SETS][CACHE_WAYS];
+
+		// The finalizer of murmur3: every bit of the location reaches the bits of the set
+		std::size_t getCacheSet (const char *file, std::uint32_t line, std::uint32_t column)
+		{
+			std::uint64_t key = reinterpret_cast<std::uintptr_t> (file);
+			key ^= static_cast<std::uint64_t> (line) << 32 | column;
+			key ^= key >> 33;
+			key *= 0xFF51AFD7ED558CCDull;
+			key ^= key >> 33;
+			key *= 0xC4CEB9FE1A85EC53ull;
+			key ^= key >> 33;
+			return key & (CACHE_SETS - 1);
+		}
+
+		CallSiteStats toStats (const CallSite &site)
+		{
+			return {site.id,
+			        site.line,
+			        site.file,
+			        site.function,
+			        site.count.load (std::memory_order_relaxed),
+			        site.enabled.load (std::memory_order_relaxed),
+			        site.levelOverride.load (std::memory_order_relaxed),
+			        site.samplingMode.load (std::memory_order_relaxed),
+			        site.sampleRate.load (std::memory_order_relaxed)};
+		}
+
+		// xorshift64*: each thread its own, so the random sampling doesn't share anything
+		constinit thread_local std::uint64_t randomState = 0;
+
+		// splitmix64: never 0
+		std::uint64_t mixSeed (std::uint64_t seed)
+		{
+			seed += 0x9E3779B97F4A7C15ull;
+			seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+			seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+			return (seed ^ (seed >> 31)) | 1;
+		}
+
+		std::uint64_t nextRandom()
+		{
+			std::uint64_t &state = randomState;
+			if (state == 0)
+			{
+				// The address of the state (one per thread) and the time
+				std::uint64_t seed = reinterpret_cast<std::uintptr_t> (&state);
+				state              = mixSeed (seed ^ static_cast<std::uint64_t> (steadyNowNs()));
+			}
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return state * 0x2545F4914F6CDD1Dull;
+		}
+
+		// True with a probability of 1/n
+		bool oneIn (std::uint32_t n)
+		{
+			return n <= 1 || ((nextRandom() >> 32) * n >> 32) == 0;
+		}
+
+		void setSiteSampling (CallSite &site, SamplingMode mode, std::uint32_t n, std::int64_t intervalNs)
+		{
+			n = (n == 0) ? 1 : n;
+			site.sampleCount.store (n, std::memory_order_relaxed);
+			site.intervalNs.store (intervalNs, std::memory_order_relaxed);
+			site.sampleCalls.store (0, std::memory_order_relaxed);
+			site.sampleKept.store (0, std::memory_order_relaxed);
+			site.intervalEnd.store (0, std::memory_order_relaxed);
+
+			// The first interval has no previous rate: it keeps the first n
+			bool hasRate = (mode == SamplingMode::EVERY_NTH || mode == SamplingMode::RANDOM);
+			site.sampleRate.store (hasRate ? n : 1, std::memory_order_relaxed);
+
+			// The mode last: a producer wich sees it must see its parameters
+			site.samplingMode.store (mode, std::memory_order_release);
+		}
+
+		bool endsWithPath (std::string_view path, std::string_view suffix)
+		{
+			if (suffix.size() > path.size() || path.substr (path.size() - suffix.size()) != suffix)
+			{
+				return false;
+			}
+			// Whole path components only
+			if (suffix.size() == path.size() || suffix.front() == '/')
+			{
+				return true;
+			}
+			char separator = path [path.size() - suffix.size() - 1];
+			return separator == '/' || separator == '\\';
+		}
+
+		std::int64_t toExpiry (std::chrono::seconds duration)
+		{
+			return (duration.count() > 0) ? steadyNowNs() + std::chrono::nanoseconds (duration).count() : 0;
+		}
+
+		bool isExpired (std::int64_t expiry, std::int64_t nowNs)
+		{
+			return expiry != 0 && nowNs >= expiry;
+		}
+
+		// With the registry locked. Returns true if the lowest override has changed
+		bool updateOverrideLevel (CallSiteRegistry &registry)
+		{
+			std::int64_t nowNs = steadyNowNs();
+			LogLevel lowest    = LogLevel::OFF;
+			for (auto &site : registry.sites)
+			{
+				LogLevel level = site.levelOverride.load (std::memory_order_relaxed);
+				if (level != LogLevel::OFF && isExpired (site.overrideExpiry.load (std::memory_order_relaxed), nowNs))
+				{
+					site.levelOverride.store (LogLevel::OFF, std::memory_order_relaxed);
+					level = LogLevel::OFF;
+				}
+				if (level < lowest)
+				{
+					lowest = level;
+				}
+			}
+			std::erase_if (registry.pendingOverrides,
+			               [nowNs] (const PendingOverride &pending) { return isExpired (pending.expiry, nowNs); });
+			for (auto &pending : registry.pendingOverrides)
+			{
+				if (pending.level < lowest)
+				{
+					lowest = pending.level;
+				}
+			}
+
+			return registry.overrideLevel.exchange (lowest, std::memory_order_relaxed) != lowest;
+		}
+
+		void setSiteOverride (CallSite &site, LogLevel level, std::int64_t expiry)
+		{
+			// The expiry first: a producer wich sees the new level must not see the old expiry
+			site.overrideExpiry.store (expiry, std::memory_order_relaxed);
+			site.levelOverride.store (level, std::memory_order_release);
+		}
+
+		// The slow path of resolveCallSite: only the first time a site logs
+		CallSite *registerSite (CallSiteRegistry &registry, const std::source_location &location)
+		{
+			const char *file     = location.file_name();
+			std::uint32_t line   = location.line();
+			std::uint32_t column = location.column();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+
+			// Other thread may have registered it since the lookup
+			CallSite *site = findSite (*registry.table.load (std::memory_order_relaxed), file, line, column);
+			if (site == nullptr)
+			{
+				site           = &registry.sites.emplace_back();
+				site->id       = static_cast<std::uint32_t> (registry.sites.size());
+				site->line     = line;
+				site->column   = column;
+				site->file     = file;
+				site->function = location.function_name();
+
+				for (auto &pending : registry.pendingEnabled)
+				{
+					if ((pending.line == 0 || pending.line == line) && endsWithPath (site->file, pending.file))
+					{
+						site->enabled.store (pending.enabled, std::memory_order_relaxed);
+					}
+				}
+				for (auto &pending : registry.pendingOverrides)
+				{
+					if ((pending.line == 0 || pending.line == line) && endsWithPath (site->file, pending.file))
+					{
+						setSiteOverride (*site, pending.level, pending.expiry);
+					}
+				}
+				for (auto &pending : registry.pendingSamplings)
+				{
+					if ((pending.line == 0 || pending.line == line) && endsWithPath (site->file, pending.file))
+					{
+						setSiteSampling (*site, pending.mode, pending.n, pending.intervalNs);
+					}
+				}
+				publishSite (registry, *site);
+			}
+			return site;
+		}
+	}    // namespace
+
+	std::int64_t steadyNowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (
+		           std::chrono::steady_clock::now().time_since_epoch())
+		    .count();
+	}
+
+	LogLevel getSiteOverrideLevel()
+	{
+		return getRegistry().overrideLevel.load (std::memory_order_relaxed);
+	}
+
+	bool isSiteOverridden (const CallSite &site, LogLevel logLevel, std::int64_t nowNs)
+	{
+		if (logLevel < site.levelOverride.load (std::memory_order_acquire))
+		{
+			return false;
+		}
+		if (!isExpired (site.overrideExpiry.load (std::memory_order_relaxed), nowNs))
+		{
+			return true;
+		}
+
+		// Expired: restore the levels of the loggers
+		bool changed;
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			changed = updateOverrideLevel (registry);
+		}
+		if (changed)
+		{
+			refreshLoggersLevels();
+		}
+		return false;
+	}
+
+	bool sampleCallSite (CallSite &site)
+	{
+		switch (site.samplingMode.load (std::memory_order_acquire))
+		{
+		case SamplingMode::EVERY_NTH:
+			return site.sampleCalls.fetch_add (1, std::memory_order_relaxed)
+			           % site.sampleCount.load (std::memory_order_relaxed)
+			       == 0;
+
+		case SamplingMode::RANDOM: return oneIn (site.sampleCount.load (std::memory_order_relaxed));
+
+		case SamplingMode::PER_INTERVAL:
+		{
+			std::uint32_t n    = site.sampleCount.load (std::memory_order_relaxed);
+			std::int64_t nowNs = steadyNowNs();
+			std::int64_t end   = site.intervalEnd.load (std::memory_order_relaxed);
+			if (nowNs >= end)
+			{
+				// A new interval: only one thread starts it. The calls of the previous one give the rate
+				std::int64_t nextEnd = nowNs + site.intervalNs.load (std::memory_order_relaxed);
+				if (site.intervalEnd.compare_exchange_strong (end, nextEnd, std::memory_order_relaxed))
+				{
+					std::uint64_t calls = site.sampleCalls.exchange (0, std::memory_order_relaxed);
+					std::uint64_t rate  = (end == 0) ? 1 : std::max<std::uint64_t> (1, (calls + n - 1) / n);
+					site.sampleRate.store (static_cast<std::uint32_t> (std::min<std::uint64_t> (rate, UINT32_MAX)),
+					                       std::memory_order_relaxed);
+					site.sampleKept.store (0, std::memory_order_relaxed);
+				}
+			}
+			site.sampleCalls.fetch_add (1, std::memory_order_relaxed);
+
+			// Spread over the interval, and never more than n
+			if (!oneIn (site.sampleRate.load (std::memory_order_relaxed)))
+			{
+				return false;
+			}
+			return site.sampleKept.fetch_add (1, std::memory_order_relaxed) < n;
+		}
+
+		default: return true;
+		}
+	}
+
+	CallSite &resolveCallSite (const std::source_location &location)
+	{
+		const char *file = location.file_name();
+		std::uint32_t line   = location.line();
+		std::uint32_t column = location.column();
+
+		CacheEntry *set = cache [getCacheSet (file, line, column)];
+		for (std::size_t way = 0; way < CACHE_WAYS; way++)
+		{
+			CacheEntry &entry = set [way];
+			if (entry.site != nullptr && entry.file == file && entry.line == line && entry.column == column)
+			{
+				return *entry.site;
+			}
+		}
+
+		// First use in this thread (or evicted): by name, without the lock if it's already registered
+		CallSiteRegistry &registry = getRegistry();
+		CallSite *site             = findSite (*registry.table.load (std::memory_order_acquire), file, line, column);
+		if (site == nullptr)
+		{
+			site = registerSite (registry, location);
+		}
+
+		// The newest one first: the oldest of the set is evicted
+		std::move_backward (set, set + CACHE_WAYS - 1, set + CACHE_WAYS);
+		set [0] = {file, line, column, site};
+		return *site;
+	}
+
+	const CallSite *findCallSite (std::uint32_t id)
+	{
+		// Lock free: the id comes from an event, so its site is already in the current table
+		const SiteTable &table = *getRegistry().table.load (std::memory_order_acquire);
+		if (id == NO_CALL_SITE || id > (table.mask + 1) / 2)
+		{
+			return nullptr;
+		}
+		return table.byId [id - 1].load (std::memory_order_acquire);
+	}
+
+	void lockCallSiteRegistry()
+	{
+		getRegistry().mtx.lock();
+	}
+
+	void unlockCallSiteRegistry()
+	{
+		getRegistry().mtx.unlock();
+	}
+
+	namespace CallSites
+	{
+		bool getCallSite (std::uint32_t id, CallSiteStats &stats)
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			if (id == NO_CALL_SITE || id > registry.sites.size())
+			{
+				return false;
+			}
+			stats = toStats (registry.sites [id - 1]);
+			return true;
+		}
+
+		std::vector<CallSiteStats> getAll()
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+
+			std::vector<CallSiteStats> all;
+			all.reserve (registry.sites.size());
+			for (auto &site : registry.sites)
+			{
+				all.push_back (toStats (site));
+			}
+			return all;
+		}
+
+		std::vector<CallSiteStats> getTop (std::size_t count)
+		{
+			std::vector<CallSiteStats> all = getAll();
+			if (count > all.size())
+			{
+				count = all.size();
+			}
+
+			std::partial_sort (all.begin(), all.begin() + count, all.end(),
+			                   [] (const CallSiteStats &a, const CallSiteStats &b) { return a.count > b.count; });
+			all.resize (count);
+			return all;
+		}
+
+		bool setEnabled (std::uint32_t id, bool enabled)
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			if (id == NO_CALL_SITE || id > registry.sites.size())
+			{
+				return false;
+			}
+			registry.sites [id - 1].enabled.store (enabled, std::memory_order_relaxed);
+			return true;
+		}
+
+		std::size_t setEnabled (std::string_view file, std::uint32_t line, bool enabled)
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+
+			std::size_t affected = 0;
+			for (auto &site : registry.sites)
+			{
+				if ((line == 0 || site.line == line) && endsWithPath (site.file, file))
+				{
+					site.enabled.store (enabled, std::memory_order_relaxed);
+					affected++;
+				}
+			}
+
+			// Replaces the previous one for the same place. The enabling ones are kept too: they may override a
+			// previous one for the whole file
+			std::erase_if (registry.pendingEnabled, [&] (const PendingEnabled &pending) {
+				return pending.line == line && pending.file == file;
+			});
+			registry.pendingEnabled.push_back ({std::string (file), line, enabled});
+			return affected;
+		}
+
+		void resetCounts()
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			for (auto &site : registry.sites)
+			{
+				site.count.store (0, std::memory_order_relaxed);
+			}
+		}
+
+		bool setLevelOverride (std::uint32_t id, LogLevel level, std::chrono::seconds duration)
+		{
+			bool changed;
+			{
+				CallSiteRegistry &registry = getRegistry();
+				std::lock_guard<std::mutex> lock (registry.mtx);
+				if (id == NO_CALL_SITE || id > registry.sites.size())
+				{
+					return false;
+				}
+				setSiteOverride (registry.sites [id - 1], level, toExpiry (duration));
+				changed = updateOverrideLevel (registry);
+			}
+			if (changed)
+			{
+				refreshLoggersLevels();
+			}
+			return true;
+		}
+
+		std::size_t setLevelOverride (std::string_view file, std::uint32_t line, LogLevel level,
+		                              std::chrono::seconds duration)
+		{
+			std::int64_t expiry  = toExpiry (duration);
+			std::size_t affected = 0;
+			bool changed;
+			{
+				CallSiteRegistry &registry = getRegistry();
+				std::lock_guard<std::mutex> lock (registry.mtx);
+				for (auto &site : registry.sites)
+				{
+					if ((line == 0 || site.line == line) && endsWithPath (site.file, file))
+					{
+						setSiteOverride (site, level, expiry);
+						affected++;
+					}
+				}
+
+				// Replaces the previous one for the same place
+				std::erase_if (registry.pendingOverrides, [&] (const PendingOverride &pending) {
+					return pending.line == line && pending.file == file;
+				});
+				if (level != LogLevel::OFF)
+				{
+					registry.pendingOverrides.push_back ({std::string (file), line, level, expiry});
+				}
+				changed = updateOverrideLevel (registry);
+			}
+			if (changed)
+			{
+				refreshLoggersLevels();
+			}
+			return affected;
+		}
+
+		void clearLevelOverrides()
+		{
+			bool changed;
+			{
+				CallSiteRegistry &registry = getRegistry();
+				std::lock_guard<std::mutex> lock (registry.mtx);
+				for (auto &site : registry.sites)
+				{
+					site.levelOverride.store (LogLevel::OFF, std::memory_order_relaxed);
+				}
+				registry.pendingOverrides.clear();
+				changed = updateOverrideLevel (registry);
+			}
+			if (changed)
+			{
+				refreshLoggersLevels();
+			}
+		}
+
+		bool setSampling (std::uint32_t id, SamplingMode mode, std::uint32_t n, std::chrono::milliseconds interval)
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			if (id == NO_CALL_SITE || id > registry.sites.size())
+			{
+				return false;
+			}
+			setSiteSampling (registry.sites [id - 1], mode, n, std::chrono::nanoseconds (interval).count());
+			return true;
+		}
+
+		std::size_t setSampling (std::string_view file, std::uint32_t line, SamplingMode mode, std::uint32_t n,
+		                         std::chrono::milliseconds interval)
+		{
+			std::int64_t intervalNs = std::chrono::nanoseconds (interval).count();
+			std::size_t affected    = 0;
+
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			for (auto &site : registry.sites)
+			{
+				if ((line == 0 || site.line == line) && endsWithPath (site.file, file))
+				{
+					setSiteSampling (site, mode, n, intervalNs);
+					affected++;
+				}
+			}
+
+			// Replaces the previous one for the same place
+			std::erase_if (registry.pendingSamplings, [&] (const PendingSampling &pending) {
+				return pending.line == line && pending.file == file;
+			});
+			if (mode != SamplingMode::NONE)
+			{
+				registry.pendingSamplings.push_back ({std::string (file), line, mode, n, intervalNs});
+			}
+			return affected;
+		}
+
+		void clearSampling()
+		{
+			CallSiteRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			for (auto &site : registry.sites)
+			{
+				setSiteSampling (site, SamplingMode::NONE, 1, 0);
+			}
+			registry.pendingSamplings.clear();
+		}
+
+		void seedRandomSampling (std::uint64_t seed)
+		{
+			randomState = (seed == 0) ? 0 : mixSeed (seed);
+		}
+	}    // namespace CallSites
+
+}    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,205 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+
+#include "StreamLoggerSinks.h"
+#include "StreamLogger.h"
+#include "StackLogger.h"
+#include "CrashHandler.h"
+#include "EventRecorder.h"
+#include "RawIO.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	namespace
+	{
+		constexpr int MAX_CRASH_ITEMS = 64;
+
+		std::atomic<EventRecorder *> crashRecorders [MAX_CRASH_ITEMS];
+		std::atomic<FileSink *> crashFileSinks [MAX_CRASH_ITEMS];
+
+		std::atomic<bool> crashHandlerEnabled {false};
+		std::atomic<bool> crashDumped {false};
+		char crashFilePath [4096];
+
+		template <typename T> void registerItem (std::atomic<T *> (&table) [MAX_CRASH_ITEMS], T *item)
+		{
+			for (auto &slot : table)
+			{
+				T *expected = nullptr;
+				if (slot.compare_exchange_strong (expected, item))
+				{
+					return;
+				}
+			}
+			// Full: this one will not be in the crash report
+		}
+
+		template <typename T> void unregisterItem (std::atomic<T *> (&table) [MAX_CRASH_ITEMS], T *item)
+		{
+			for (auto &slot : table)
+			{
+				T *expected = item;
+				if (slot.compare_exchange_strong (expected, nullptr))
+				{
+					return;
+				}
+			}
+		}
+
+#ifndef _WIN32
+		constexpr int crashSignals [] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+		struct sigaction previousActions [sizeof (crashSignals) / sizeof (crashSignals [0])];
+		std::terminate_handler previousTerminate = nullptr;
+
+		// To survive a stack overflow (only for the thread wich enabled the handler)
+		std::unique_ptr<char []> alternateStack;
+
+		void onCrashSignal (int signalNumber)
+		{
+			dumpCrashReport ("signal", signalNumber);
+
+			// Let the previous handler (or the default action) finish the process
+			for (std::size_t i = 0; i < sizeof (crashSignals) / sizeof (crashSignals [0]); i++)
+			{
+				if (crashSignals [i] == signalNumber)
+				{
+					sigaction (signalNumber, &previousActions [i], nullptr);
+				}
+			}
+			raise (signalNumber);
+		}
+
+		void onTerminate()
+		{
+			dumpCrashReport ("std::terminate", 0);
+			if (previousTerminate != nullptr)
+			{
+				previousTerminate();
+			}
+			std::abort();
+		}
+#endif
+	}    // namespace
+
+	void registerCrashRecorder (EventRecorder *recorder)
+	{
+		registerItem (crashRecorders, recorder);
+	}
+
+	void unregisterCrashRecorder (EventRecorder *recorder)
+	{
+		unregisterItem (crashRecorders, recorder);
+	}
+
+	void registerCrashFileSink (FileSink *sink)
+	{
+		registerItem (crashFileSinks, sink);
+	}
+
+	void unregisterCrashFileSink (FileSink *sink)
+	{
+		unregisterItem (crashFileSinks, sink);
+	}
+
+	bool isCrashHandlerEnabled()
+	{
+		return crashHandlerEnabled.load (std::memory_order_acquire);
+	}
+
+	void dumpCrashReport (const char *reason, int signalNumber)
+	{
+		// Only once: p.e. std::terminate, and then the SIGABRT of abort
+		if (crashDumped.exchange (true))
+		{
+			return;
+		}
+
+		for (auto &slot : crashFileSinks)
+		{
+			FileSink *sink = slot.load (std::memory_order_acquire);
+			if (sink != nullptr)
+			{
+				sink->flushOnCrash();
+			}
+		}
+
+		int fd = RawIO::openFile (crashFilePath, true);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		RawIO::writeText (fd, "*** Crash: ");
+		RawIO::writeText (fd, reason);
+		if (signalNumber != 0)
+		{
+			RawIO::writeText (fd, " ");
+			RawIO::writeNumber (fd, static_cast<std::uint64_t> (signalNumber));
+		}
+		RawIO::writeText (fd, " ***\n");
+
+		for (auto &slot : crashRecorders)
+		{
+			EventRecorder *recorder = slot.load (std::memory_order_acquire);
+			if (recorder != nullptr)
+			{
+				recorder->dump (fd);
+			}
+		}
+		RawIO::closeFile (fd);
+	}
+
+	namespace Config
+	{
+		bool enableCrashHandler (const std::string &crashFile)
+		{
+#ifdef _WIN32
+			// YAGNI: SetUnhandledExceptionFilter
+			(void) crashFile;
+			return false;
+#else
+			if (crashFile.size() >= sizeof (crashFilePath))
+			{
+				return false;
+			}
+			std::memcpy (crashFilePath, crashFile.c_str(), crashFile.size() + 1);
+
+			if (!crashHandlerEnabled.exchange (true))
+			{
+				// The recorders first: the handler must find them
+				getLogger().enableRecorder();
+				forEachChannelLogger ([] (StackLogger &logger) { logger.enableRecorder(); });
+
+				alternateStack = std::make_unique<char []> (SIGSTKSZ * 4);
+				stack_t altStack {};
+				altStack.ss_sp   = alternateStack.get();
+				altStack.ss_size = SIGSTKSZ * 4;
+				sigaltstack (&altStack, nullptr);
+
+				struct sigaction action {};
+				action.sa_handler = onCrashSignal;
+				action.sa_flags   = SA_ONSTACK;
+				sigemptyset (&action.sa_mask);
+				for (std::size_t i = 0; i < sizeof (crashSignals) / sizeof (crashSignals [0]); i++)
+				{
+					sigaction (crashSignals [i], &action, &previousActions [i]);
+				}
+
+				previousTerminate = std::set_terminate (onTerminate);
+			}
+			return true;
+#endif
+		}
+	}    // namespace Config
+
+}    // namespace IgnacioPomar::Util::StreamLogger
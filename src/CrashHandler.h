@@ -0,0 +1,30 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _CRASH_HANDLER_H_
+#	define _CRASH_HANDLER_H_
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	class EventRecorder;
+	class FileSink;
+
+	// What the crash handler flushes and dumps. Fixed size tables: no allocations nor locks in the handler
+	void registerCrashRecorder (EventRecorder *recorder);
+	void unregisterCrashRecorder (EventRecorder *recorder);
+	void registerCrashFileSink (FileSink *sink);
+	void unregisterCrashFileSink (FileSink *sink);
+
+	// The new backends must have a recorder
+	bool isCrashHandlerEnabled ();
+
+	// Flushes the file sinks, and dumps the recorders to the crash file. Async-signal-safe
+	void dumpCrashReport (const char *reason, int signalNumber);
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _CRASH_HANDLER_H_
@@ -0,0 +1,211 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <charconv>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define LGGR_USE_SSE2
+#endif
+
+#include "EscapingWriter.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+#ifndef LGGR_USE_SSE2
+	static inline bool isJsonEscape (unsigned char c)
+	{
+		return c < 0x20 || c == '"' || c == '\\';
+	}
+
+	static inline bool isLogfmtSpecial (unsigned char c)
+	{
+		return c <= 0x20 || c == '"' || c == '\\' || c == '=';
+	}
+#else
+	static inline unsigned ctz (unsigned mask)
+	{
+#	if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanForward (&idx, mask);
+		return idx;
+#	else
+		return static_cast<unsigned> (__builtin_ctz (mask));
+#	endif
+	}
+
+	// 16 bytes at a time: the bytes <= maxCtrl (unsigned), and the ones equal to any of the three specials
+	static inline std::size_t findSpecial (std::string_view text, unsigned char maxCtrl, char c1, char c2, char c3)
+	{
+		const char *data = text.data();
+		std::size_t size = text.size();
+		std::size_t i    = 0;
+
+		const __m128i ctrl = _mm_set1_epi8 (static_cast<char> (maxCtrl));
+		const __m128i v1   = _mm_set1_epi8 (c1);
+		const __m128i v2   = _mm_set1_epi8 (c2);
+		const __m128i v3   = _mm_set1_epi8 (c3);
+
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i chunk = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (data + i));
+			// x <= maxCtrl (unsigned) <=> max (x, maxCtrl) == maxCtrl
+			__m128i hits = _mm_cmpeq_epi8 (_mm_max_epu8 (chunk, ctrl), ctrl);
+			hits         = _mm_or_si128 (hits, _mm_cmpeq_epi8 (chunk, v1));
+			hits         = _mm_or_si128 (hits, _mm_cmpeq_epi8 (chunk, v2));
+			hits         = _mm_or_si128 (hits, _mm_cmpeq_epi8 (chunk, v3));
+
+			unsigned mask = static_cast<unsigned> (_mm_movemask_epi8 (hits));
+			if (mask != 0)
+			{
+				return i + ctz (mask);
+			}
+		}
+
+		// Tail
+		for (; i < size; i++)
+		{
+			unsigned char c = static_cast<unsigned char> (data [i]);
+			if (c <= maxCtrl || c == static_cast<unsigned char> (c1) || c == static_cast<unsigned char> (c2)
+			    || c == static_cast<unsigned char> (c3))
+			{
+				return i;
+			}
+		}
+		return size;
+	}
+#endif
+
+	std::size_t findJsonEscape (std::string_view text)
+	{
+#ifdef LGGR_USE_SSE2
+		// '"' twice: we only have two specials
+		return findSpecial (text, 0x1F, '"', '\\', '"');
+#else
+		for (std::size_t i = 0; i < text.size(); i++)
+		{
+			if (isJsonEscape (static_cast<unsigned char> (text [i])))
+			{
+				return i;
+			}
+		}
+		return text.size();
+#endif
+	}
+
+	std::size_t findLogfmtSpecial (std::string_view text)
+	{
+#ifdef LGGR_USE_SSE2
+		return findSpecial (text, 0x20, '"', '\\', '=');
+#else
+		for (std::size_t i = 0; i < text.size(); i++)
+		{
+			if (isLogfmtSpecial (static_cast<unsigned char> (text [i])))
+			{
+				return i;
+			}
+		}
+		return text.size();
+#endif
+	}
+
+	void appendJsonEscaped (std::string &out, std::string_view text)
+	{
+		static const char hex [] = "0123456789abcdef";
+
+		while (!text.empty())
+		{
+			// Copy the clean run in one go
+			std::size_t pos = findJsonEscape (text);
+			out.append (text.data(), pos);
+			if (pos == text.size())
+			{
+				return;
+			}
+
+			unsigned char c = static_cast<unsigned char> (text [pos]);
+			switch (c)
+			{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			default:
+				{
+					char esc [6] = {'\\', 'u', '0', '0', hex [c >> 4], hex [c & 0x0F]};
+					out.append (esc, sizeof (esc));
+				}
+				break;
+			}
+			text.remove_prefix (pos + 1);
+		}
+	}
+
+	void appendLogfmtValue (std::string &out, std::string_view text)
+	{
+		std::size_t pos = findLogfmtSpecial (text);
+		if (pos == text.size() && !text.empty())
+		{
+			out.append (text.data(), text.size());
+			return;
+		}
+
+		// Quoted: the same escapes than json. The clean prefix has no json escapes either
+		out += '"';
+		out.append (text.data(), pos);
+		appendJsonEscaped (out, text.substr (pos));
+		out += '"';
+	}
+
+	static inline void appendDigits (char *dst, unsigned value, int digits)
+	{
+		for (int i = digits - 1; i >= 0; i--)
+		{
+			dst [i] = static_cast<char> ('0' + value % 10);
+			value /= 10;
+		}
+	}
+
+	void appendRfc3339 (std::string &out, std::int64_t nsSinceEpoch)
+	{
+		using namespace std::chrono;
+
+		sys_time<nanoseconds> tp {nanoseconds (nsSinceEpoch)};
+		auto dp = floor<days> (tp);
+		year_month_day ymd {dp};
+		hh_mm_ss<nanoseconds> hms {tp - dp};
+
+		// 2024-04-17T15:28:07.212848900Z
+		char buf [30];
+		appendDigits (buf, static_cast<unsigned> (int (ymd.year())), 4);
+		buf [4] = '-';
+		appendDigits (buf + 5, unsigned (ymd.month()), 2);
+		buf [7] = '-';
+		appendDigits (buf + 8, unsigned (ymd.day()), 2);
+		buf [10] = 'T';
+		appendDigits (buf + 11, static_cast<unsigned> (hms.hours().count()), 2);
+		buf [13] = ':';
+		appendDigits (buf + 14, static_cast<unsigned> (hms.minutes().count()), 2);
+		buf [16] = ':';
+		appendDigits (buf + 17, static_cast<unsigned> (hms.seconds().count()), 2);
+		buf [19] = '.';
+		appendDigits (buf + 20, static_cast<unsigned> (hms.subseconds().count()), 9);
+		buf [29] = 'Z';
+		out.append (buf, sizeof (buf));
+	}
+
+	void appendInteger (std::string &out, std::int64_t value)
+	{
+		char buf [24];
+		auto res = std::to_chars (buf, buf + sizeof (buf), value);
+		out.append (buf, res.ptr);
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,37 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _ESCAPING_WRITER_H_
+#	define _ESCAPING_WRITER_H_
+
+#	include <cstddef>
+#	include <cstdint>
+#	include <string>
+#	include <string_view>
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	// Position of the first char wich needs escaping in a json string: control chars, '"' and '\\'
+	// (or text.size() if there is none). Vectorized with SSE2 when available
+	std::size_t findJsonEscape (std::string_view text);
+
+	// Same, for a logfmt value: it also needs quoting if it has spaces or '='
+	std::size_t findLogfmtSpecial (std::string_view text);
+
+	// Appends the text escaped for a json string (without the quotes)
+	void appendJsonEscaped (std::string &out, std::string_view text);
+
+	// Appends the text as a logfmt value: as is if possible, or quoted and escaped
+	void appendLogfmtValue (std::string &out, std::string_view text);
+
+	// Appends the time point as RFC 3339 in UTC, with nanoseconds: 2024-04-17T15:28:07.212848900Z
+	void appendRfc3339 (std::string &out, std::int64_t nsSinceEpoch);
+
+	void appendInteger (std::string &out, std::int64_t value);
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _ESCAPING_WRITER_H_
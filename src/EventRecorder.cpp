@@ -0,0 +1,339 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include <fstream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+#include "StreamLoggerInterfaces.h"
+#include "EventRecorder.h"
+#include "CrashHandler.h"
+#include "RawIO.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	// dump copies each record to the stack before writing it: the bigger ones are truncated to this
+	constexpr std::size_t DUMP_RECORD_SIZE = 1024;
+
+	static std::uint32_t roundUpPow2 (std::uint32_t value)
+	{
+		std::uint32_t pow2 = 1;
+		while (pow2 < value)
+		{
+			pow2 <<= 1;
+		}
+		return pow2;
+	}
+
+	static std::uint32_t toRecordCount (std::uint32_t recordCount)
+	{
+		return roundUpPow2 (recordCount < 2 ? 2 : recordCount);
+	}
+
+	static std::uint32_t toRecordSize (std::uint32_t recordSize)
+	{
+		recordSize = (recordSize < 2 * sizeof (RecordHeader)) ? 2 * sizeof (RecordHeader) : recordSize;
+		return (recordSize + 7) & ~7u;
+	}
+
+	EventRecorder::EventRecorder (const std::string &channelName, std::uint32_t recordCount, std::uint32_t recordSize)
+	{
+		recordCount = toRecordCount (recordCount);
+		recordSize  = toRecordSize (recordSize);
+
+		std::size_t size = sizeof (RecorderHeader) + std::size_t (recordSize) * recordCount;
+		this->memory     = std::make_unique<unsigned char []> (size);
+		this->header = reinterpret_cast<RecorderHeader *> (this->memory.get());
+		this->initialize (channelName, recordCount, recordSize);
+	}
+
+	EventRecorder::EventRecorder (const std::string &channelName, std::uint32_t recordCount, std::uint32_t recordSize,
+	                              const std::string &filePath)
+	{
+		recordCount = toRecordCount (recordCount);
+		recordSize  = toRecordSize (recordSize);
+
+#ifndef _WIN32
+		std::size_t size = sizeof (RecorderHeader) + std::size_t (recordSize) * recordCount;
+		int fd           = ::open (filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		void *mem = MAP_FAILED;
+		if (ftruncate (fd, static_cast<off_t> (size)) == 0)
+		{
+			mem = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close (fd);
+		if (mem == MAP_FAILED)
+		{
+			return;
+		}
+
+		this->mapping    = mem;
+		this->mappedSize = size;
+		this->header     = static_cast<RecorderHeader *> (mem);
+		this->initialize (channelName, recordCount, recordSize);
+#else
+		// YAGNI: CreateFileMapping
+		(void) channelName;
+		(void) filePath;
+#endif
+	}
+
+	void EventRecorder::initialize (const std::string &channelName, std::uint32_t recordCount, std::uint32_t recordSize)
+	{
+		// Zero filled memory: build the atomics in place
+		this->header     = new (this->header) RecorderHeader {};
+		this->records    = reinterpret_cast<unsigned char *> (this->header) + sizeof (RecorderHeader);
+		this->recordMask = recordCount - 1;
+
+		header->magic       = RECORDER_MAGIC;
+		header->version     = RECORDER_VERSION;
+		header->recordSize  = recordSize;
+		header->recordCount = recordCount;
+#ifndef _WIN32
+		header->producerPid = static_cast<std::uint64_t> (getpid());
+#endif
+		std::strncpy (header->channelName, channelName.c_str(), sizeof (header->channelName) - 1);
+		for (std::uint32_t i = 0; i < recordCount; i++)
+		{
+			new (this->records + std::size_t (i) * recordSize) RecordHeader {};
+		}
+
+		registerCrashRecorder (this);
+	}
+
+	EventRecorder::~EventRecorder()
+	{
+		if (this->header == nullptr)
+		{
+			return;
+		}
+
+		unregisterCrashRecorder (this);
+#ifndef _WIN32
+		if (this->mapping != nullptr)
+		{
+			// The file keeps the records: they will be the "previous run" of the next one
+			munmap (this->mapping, this->mappedSize);
+		}
+#endif
+	}
+
+	bool EventRecorder::isOpen() const
+	{
+		return this->header != nullptr;
+	}
+
+	bool EventRecorder::load (const std::string &filePath, std::list<EventContainer> &events)
+	{
+		std::ifstream file (filePath, std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		// The header first: it may be any other file
+		std::vector<char> content (sizeof (RecorderHeader));
+		if (!file.read (content.data(), sizeof (RecorderHeader)))
+		{
+			return false;
+		}
+
+		// Plain copies of the shared layout: the writer is gone
+		const auto *hdr = reinterpret_cast<const RecorderHeader *> (content.data());
+		if (hdr->magic != RECORDER_MAGIC || hdr->version != RECORDER_VERSION || hdr->recordCount == 0
+		    || (hdr->recordCount & (hdr->recordCount - 1)) != 0 || hdr->recordSize < sizeof (RecordHeader))
+		{
+			return false;
+		}
+
+		std::size_t recordsSize = std::size_t (hdr->recordSize) * hdr->recordCount;
+		content.resize (sizeof (RecorderHeader) + recordsSize);
+		hdr = reinterpret_cast<const RecorderHeader *> (content.data());
+		if (!file.read (content.data() + sizeof (RecorderHeader), static_cast<std::streamsize> (recordsSize)))
+		{
+			return false;
+		}
+
+		// A timed event is recorded when it starts and again when it finishes: only the last one is kept. The
+		// running ones wait here for its end, by start time and level (its text may have grown: it starts with them)
+		typedef std::pair<std::int64_t, std::uint8_t> TimedKey;
+		std::map<TimedKey, std::vector<std::list<EventContainer>::iterator>> running;
+
+		std::uint64_t end = hdr->writePos.load (std::memory_order_relaxed);
+		std::uint64_t pos = (end > hdr->recordCount) ? end - hdr->recordCount : 0;
+		for (; pos < end; pos++)
+		{
+			const char *raw =
+			    content.data() + sizeof (RecorderHeader) + (pos & (hdr->recordCount - 1)) * hdr->recordSize;
+			const auto *rec = reinterpret_cast<const RecordHeader *> (raw);
+			if (rec->sequence.load (std::memory_order_relaxed) != 2 * pos + 2 || rec->logLevel > 5)
+			{
+				// Torn by the crash
+				continue;
+			}
+
+			std::size_t maxText = hdr->recordSize - sizeof (RecordHeader);
+			std::size_t textLen = (rec->textLength > maxText) ? maxText : rec->textLength;
+			std::size_t dateLen = (rec->dateLength > sizeof (rec->date)) ? sizeof (rec->date) : rec->dateLength;
+
+			EventContainer &event = events.emplace_back (static_cast<LogLevel> (rec->logLevel));
+			event.timePoint       = TimePoint (std::chrono::duration_cast<TimePoint::duration> (
+                std::chrono::nanoseconds (rec->timestampNs)));
+			event.date.assign (rec->date, dateLen);
+			event.event.assign (raw + sizeof (RecordHeader), textLen);
+			event.eventType = rec->eventType;
+			TimedKey key (rec->timestampNs, rec->logLevel);
+			if (EVENT_TYPE_TIMED_RUNNING == event.eventType)
+			{
+				running [key].push_back (std::prev (events.end()));
+			}
+			else if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+			{
+				event.endTimePoint =
+				    event.timePoint
+				    + std::chrono::duration_cast<TimePoint::duration> (std::chrono::nanoseconds (rec->durationNs));
+
+				auto &starts = running [key];
+				for (auto start = starts.begin(); start != starts.end(); ++start)
+				{
+					if (event.event.starts_with ((*start)->event))
+					{
+						events.erase (*start);
+						starts.erase (start);
+						break;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	RecordHeader *EventRecorder::getRecord (std::uint64_t pos) const
+	{
+		return reinterpret_cast<RecordHeader *> (this->records + (pos & recordMask) * header->recordSize);
+	}
+
+	void EventRecorder::record (const EventContainer &event)
+	{
+		std::uint64_t pos = header->writePos.load (std::memory_order_relaxed);
+		RecordHeader *rec = this->getRecord (pos);
+
+		rec->sequence.store (2 * pos + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence (std::memory_order_release);
+
+		rec->timestampNs =
+		    std::chrono::duration_cast<std::chrono::nanoseconds> (event.timePoint.time_since_epoch()).count();
+		rec->durationNs = 0;
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			rec->durationNs =
+			    std::chrono::duration_cast<std::chrono::nanoseconds> (event.endTimePoint - event.timePoint).count();
+		}
+		rec->logLevel  = static_cast<std::uint8_t> (event.logLevel);
+		rec->eventType = event.eventType;
+
+		std::size_t dateLen = (event.date.size() < sizeof (rec->date)) ? event.date.size() : sizeof (rec->date);
+		std::memcpy (rec->date, event.date.data(), dateLen);
+		rec->dateLength = static_cast<std::uint8_t> (dateLen);
+
+		std::size_t maxText = header->recordSize - sizeof (RecordHeader);
+		std::size_t textLen = event.event.size();
+		rec->flags          = 0;
+		if (textLen > maxText)
+		{
+			textLen    = maxText;
+			rec->flags = RECORD_FLAG_TRUNCATED;
+		}
+		std::memcpy (reinterpret_cast<unsigned char *> (rec) + sizeof (RecordHeader), event.event.data(), textLen);
+		rec->textLength = static_cast<std::uint32_t> (textLen);
+
+		rec->sequence.store (2 * pos + 2, std::memory_order_release);
+		header->writePos.store (pos + 1, std::memory_order_release);
+	}
+
+	void EventRecorder::dump (int fd) const
+	{
+		std::uint64_t end   = header->writePos.load (std::memory_order_acquire);
+		std::uint64_t count = std::uint64_t (header->recordCount);
+		std::uint64_t pos   = (end > count) ? end - count : 0;
+
+		if (header->channelName [0] != '\0')
+		{
+			RawIO::writeText (fd, "--- Channel: ");
+			RawIO::writeText (fd, header->channelName);
+			RawIO::writeText (fd, " ---\n");
+		}
+
+		// The other threads keep logging: a record is copied, and only written if it didn't change meanwhile
+		alignas (RecordHeader) unsigned char copy [DUMP_RECORD_SIZE];
+		std::size_t copySize = (header->recordSize < sizeof (copy)) ? header->recordSize : sizeof (copy);
+		const auto *rec      = reinterpret_cast<const RecordHeader *> (copy);
+
+		for (; pos < end; pos++)
+		{
+			const RecordHeader *shared = this->getRecord (pos);
+			if (shared->sequence.load (std::memory_order_acquire) != 2 * pos + 2)
+			{
+				// Being written (maybe by the crashed thread), or already overwritten
+				continue;
+			}
+			std::memcpy (copy, shared, copySize);
+			std::atomic_thread_fence (std::memory_order_acquire);
+			if (shared->sequence.load (std::memory_order_relaxed) != 2 * pos + 2)
+			{
+				continue;
+			}
+
+			std::size_t maxText = copySize - sizeof (RecordHeader);
+			std::size_t textLen = (rec->textLength > maxText) ? maxText : rec->textLength;
+			std::size_t dateLen = (rec->dateLength > sizeof (rec->date)) ? sizeof (rec->date) : rec->dateLength;
+
+			RawIO::writeAll (fd, rec->date, dateLen);
+			RawIO::writeText (fd, " [");
+			// A constant table: usable in a signal handler
+			std::string_view levelName = "?";
+			if (rec->logLevel <= 5)
+			{
+				levelName = getLevelName (static_cast<LogLevel> (rec->logLevel));
+			}
+			RawIO::writeAll (fd, levelName.data(), levelName.size());
+			RawIO::writeText (fd, "]\t");
+			RawIO::writeAll (fd, reinterpret_cast<const char *> (rec) + sizeof (RecordHeader), textLen);
+			if ((rec->flags & RECORD_FLAG_TRUNCATED) || textLen < rec->textLength)
+			{
+				RawIO::writeText (fd, "...");
+			}
+			if (rec->eventType == EVENT_TYPE_TIMED_RUNNING)
+			{
+				RawIO::writeText (fd, "\t(running)");
+			}
+			else if (rec->eventType == EVENT_TYPE_TIMED_FINISHED)
+			{
+				RawIO::writeText (fd, "\tDone in: ");
+				RawIO::writeNumber (fd, static_cast<std::uint64_t> (rec->durationNs) / 1000000);
+				RawIO::writeText (fd, "ms");
+			}
+			RawIO::writeText (fd, "\n");
+		}
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,111 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _EVENT_RECORDER_H_
+#	define _EVENT_RECORDER_H_
+
+#	include <atomic>
+#	include <cstdint>
+#	include <list>
+#	include <memory>
+#	include <string>
+
+#	include "StreamLoggerConsts.h"
+#	include "EventContainer.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	constexpr std::uint32_t RECORDER_MAGIC   = 0x5252474C;    // "LGRR"
+	constexpr std::uint32_t RECORDER_VERSION = 1;
+
+	constexpr std::uint8_t RECORD_FLAG_TRUNCATED = 0x01;
+
+	/**
+	 * Header of the recorder memory. Followed by recordCount records of recordSize bytes
+	 */
+	struct RecorderHeader
+	{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t recordSize;
+			std::uint32_t recordCount;
+			std::uint64_t producerPid;
+			char channelName [40];
+
+			alignas (64) std::atomic<std::uint64_t> writePos;
+			std::uint8_t padding [56];
+	};
+	static_assert (sizeof (RecorderHeader) == 128, "The recorder header layout must not change");
+
+	/**
+	 * Header of each record, followed by the text (truncated to the record size)
+	 * sequence is a seqlock: 2 * pos + 1 while being written, 2 * pos + 2 once complete
+	 */
+	struct RecordHeader
+	{
+			std::atomic<std::uint64_t> sequence;
+			std::int64_t timestampNs;
+			std::int64_t durationNs;
+			std::uint8_t logLevel;
+			std::uint8_t eventType;
+			std::uint8_t flags;
+			std::uint8_t dateLength;
+			std::uint32_t textLength;
+			char date [32];
+	};
+	static_assert (sizeof (RecordHeader) == 64, "The record layout must not change");
+
+	/**
+	 * The last events of the stack, in preallocated fixed size records
+	 * Single writer (the logger, inside its lock). It can be read without locks nor allocations (p.e. in a signal
+	 * handler): the records being written are skipped
+	 * The memory may be a shared mapping of a file (flight recorder): the records survive a crash or a kill -9
+	 */
+	class EventRecorder
+	{
+		private:
+			std::unique_ptr<unsigned char []> memory;
+			void *mapping          = nullptr;
+			std::size_t mappedSize = 0;
+
+			RecorderHeader *header = nullptr;
+			unsigned char *records = nullptr;
+			std::uint32_t recordMask;
+
+			RecordHeader *getRecord (std::uint64_t pos) const;
+			void initialize (const std::string &channelName, std::uint32_t recordCount, std::uint32_t recordSize);
+
+		public:
+			// In memory
+			EventRecorder (const std::string &channelName, std::uint32_t recordCount,
+			               std::uint32_t recordSize = DEFAULTS::RECORD_SIZE);
+
+			// In a file (the previous content is lost: see load). If the file can't be mapped, isOpen is false
+			EventRecorder (const std::string &channelName, std::uint32_t recordCount, std::uint32_t recordSize,
+			               const std::string &filePath);
+			~EventRecorder();
+
+			bool isOpen () const;
+
+			// In a file: the memory is shared with the other processes wich map it (p.e. after a fork)
+			bool isMapped () const
+			{
+				return this->mapping != nullptr;
+			}
+
+			// Reads the complete records of a recorder file, oldest first
+			static bool load (const std::string &filePath, std::list<EventContainer> &events);
+
+			void record (const EventContainer &event);
+
+			// Writes the records, oldest first, as text lines. Async-signal-safe
+			void dump (int fd) const;
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _EVENT_RECORDER_H_
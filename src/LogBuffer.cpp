@@ -0,0 +1,98 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <exception>
+
+#include "StreamLoggerBuffer.h"
+#include "StackLogger.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	thread_local ScopedLogBuffer *currentLogBuffer = nullptr;
+
+	ScopedLogBuffer::ScopedLogBuffer (LogLevel captureLevel, LogLevel flushLevel, std::size_t maxEvents)
+	    : maxEvents (maxEvents)
+	    , exceptions (std::uncaught_exceptions())
+	    , previous (currentLogBuffer)
+	    , captureLevel (captureLevel)
+	    , flushLevel (flushLevel)
+	{
+		currentLogBuffer = this;
+	}
+
+	ScopedLogBuffer::~ScopedLogBuffer()
+	{
+		// Before the flush: the events logged by the sinks don't come back here
+		currentLogBuffer = this->previous;
+
+		if (std::uncaught_exceptions() > this->exceptions)
+		{
+			this->failed = true;
+		}
+		if (this->failed)
+		{
+			this->flush();
+		}
+	}
+
+	ScopedLogBuffer *ScopedLogBuffer::getCurrent()
+	{
+		return currentLogBuffer;
+	}
+
+	void ScopedLogBuffer::capture (StackLogger &logger, EventContainer &&event)
+	{
+		if (this->failed)
+		{
+			logger.logBufferedEvent (event);
+			return;
+		}
+
+		if (this->events.size() >= this->maxEvents)
+		{
+			this->events.pop_front();
+			this->dropped++;
+		}
+		this->events.push_back ({&logger, std::move (event)});
+	}
+
+	void ScopedLogBuffer::fail()
+	{
+		this->failed = true;
+		this->flush();
+	}
+
+	void ScopedLogBuffer::discard()
+	{
+		this->events.clear();
+	}
+
+	void ScopedLogBuffer::flush()
+	{
+		// Each one to its channel: they may be of several
+		for (auto &buffered : this->events)
+		{
+			buffered.logger->logBufferedEvent (buffered.event);
+		}
+		this->events.clear();
+	}
+
+	bool ScopedLogBuffer::hasFailed() const
+	{
+		return this->failed;
+	}
+
+	std::size_t ScopedLogBuffer::size() const
+	{
+		return this->events.size();
+	}
+
+	std::size_t ScopedLogBuffer::getDropped() const
+	{
+		return this->dropped;
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
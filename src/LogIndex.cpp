@@ -0,0 +1,208 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include "StreamLoggerLogIndex.h"
+#include "LogIndexWriter.h"
+#include "RawIO.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	//-------------- LogIndexWriter ----------------
+
+	LogIndexWriter::LogIndexWriter (std::uint32_t interval)
+	    : interval (interval)
+	{
+	}
+
+	LogIndexWriter::~LogIndexWriter()
+	{
+		if (this->fd >= 0)
+		{
+			RawIO::closeFile (this->fd);
+		}
+	}
+
+	bool LogIndexWriter::open (const std::string &logFile)
+	{
+		this->fd = RawIO::openFile ((logFile + ".idx").c_str(), false);
+		if (this->fd < 0)
+		{
+			return false;
+		}
+
+		// A new index (the old ones are appended: the log file also is)
+		if (RawIO::getSize (this->fd) == 0)
+		{
+			LogIndexHeader header {LOG_INDEX_MAGIC, LOG_INDEX_VERSION, this->interval, 0};
+			RawIO::writeAll (this->fd, reinterpret_cast<const char *> (&header), sizeof (header));
+		}
+		this->block.eventCount = 0;
+		return true;
+	}
+
+	void LogIndexWriter::close (std::uint64_t endOffset)
+	{
+		if (this->fd < 0)
+		{
+			return;
+		}
+		this->writeBlock (endOffset);
+		RawIO::closeFile (this->fd);
+		this->fd = -1;
+	}
+
+	void LogIndexWriter::writeBlock (std::uint64_t endOffset)
+	{
+		if (this->block.eventCount == 0)
+		{
+			return;
+		}
+		this->block.endOffset = endOffset;
+		RawIO::writeAll (this->fd, reinterpret_cast<const char *> (&this->block), sizeof (this->block));
+		this->block.eventCount = 0;
+	}
+
+	void LogIndexWriter::add (std::uint64_t offset, std::int64_t timestampNs, LogLevel logLevel)
+	{
+		if (this->fd < 0)
+		{
+			return;
+		}
+
+		// The block ends where the next event starts
+		if (this->block.eventCount >= this->interval)
+		{
+			this->writeBlock (offset);
+		}
+
+		if (this->block.eventCount == 0)
+		{
+			this->block.offset           = offset;
+			this->block.firstTimestampNs = timestampNs;
+			this->block.lastTimestampNs  = timestampNs;
+			this->block.levelMask        = 0;
+		}
+
+		// The flushed scoped buffers write events older than the previous ones
+		if (timestampNs < this->block.firstTimestampNs)
+		{
+			this->block.firstTimestampNs = timestampNs;
+		}
+		if (timestampNs > this->block.lastTimestampNs)
+		{
+			this->block.lastTimestampNs = timestampNs;
+		}
+		this->block.levelMask |= levelBit (logLevel);
+		this->block.eventCount++;
+	}
+
+#ifndef _WIN32
+	//-------------- LogIndexReader ----------------
+
+	LogIndexReader::~LogIndexReader()
+	{
+		this->close();
+	}
+
+	bool LogIndexReader::open (const std::string &indexFile)
+	{
+		this->close();
+
+		int fd = ::open (indexFile.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		void *mem = MAP_FAILED;
+		if (fstat (fd, &st) == 0 && static_cast<std::size_t> (st.st_size) >= sizeof (LogIndexHeader))
+		{
+			mem = mmap (nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close (fd);
+		if (mem == MAP_FAILED)
+		{
+			return false;
+		}
+
+		this->mapping    = mem;
+		this->mappedSize = static_cast<std::size_t> (st.st_size);
+		this->header     = static_cast<const LogIndexHeader *> (mem);
+		if (header->magic != LOG_INDEX_MAGIC || header->version != LOG_INDEX_VERSION)
+		{
+			this->close();
+			return false;
+		}
+
+		// A partial entry at the end (p.e. a crash while writing it) is ignored
+		const char *first = static_cast<const char *> (mem) + sizeof (LogIndexHeader);
+		this->entries     = reinterpret_cast<const LogIndexEntry *> (first);
+		this->entryCount  = (this->mappedSize - sizeof (LogIndexHeader)) / sizeof (LogIndexEntry);
+		return true;
+	}
+
+	void LogIndexReader::close()
+	{
+		if (this->mapping != nullptr)
+		{
+			munmap (this->mapping, this->mappedSize);
+			this->mapping    = nullptr;
+			this->header     = nullptr;
+			this->entries    = nullptr;
+			this->entryCount = 0;
+		}
+	}
+
+	bool LogIndexReader::isOpen() const
+	{
+		return this->mapping != nullptr;
+	}
+
+	std::size_t LogIndexReader::size() const
+	{
+		return this->entryCount;
+	}
+
+	const LogIndexEntry *LogIndexReader::begin() const
+	{
+		return this->entries;
+	}
+
+	const LogIndexEntry *LogIndexReader::end() const
+	{
+		return this->entries + this->entryCount;
+	}
+
+	std::uint64_t LogIndexReader::getIndexedEnd() const
+	{
+		return (this->entryCount > 0) ? this->entries [this->entryCount - 1].endOffset : 0;
+	}
+
+	std::vector<const LogIndexEntry *> LogIndexReader::find (std::int64_t fromNs, std::int64_t toNs,
+	                                                         std::uint32_t levelMask, std::int64_t skewNs) const
+	{
+		std::vector<const LogIndexEntry *> found;
+		for (const LogIndexEntry &entry : *this)
+		{
+			if ((entry.levelMask & levelMask) != 0 && entry.firstTimestampNs - skewNs <= toNs
+			    && entry.lastTimestampNs + skewNs >= fromNs)
+			{
+				found.push_back (&entry);
+			}
+		}
+		return found;
+	}
+#endif    // _WIN32
+
+}    // namespace IgnacioPomar::Util::StreamLogger
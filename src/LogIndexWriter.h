@@ -0,0 +1,45 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _LOG_INDEX_WRITER_H_
+#	define _LOG_INDEX_WRITER_H_
+
+#	include <cstdint>
+#	include <string>
+
+#	include "StreamLoggerLogIndex.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	/**
+	 * Appends the entries of the index of a log file. Not thread safe: used by the file sink, inside its lock
+	 */
+	class LogIndexWriter
+	{
+		private:
+			int fd = -1;
+			std::uint32_t interval;
+			LogIndexEntry block {};
+
+			void writeBlock (std::uint64_t endOffset);
+
+		public:
+			LogIndexWriter (std::uint32_t interval);
+			~LogIndexWriter();
+
+			bool open (const std::string &logFile);
+
+			// Writes the pending block: endOffset is the current size of the log
+			void close (std::uint64_t endOffset);
+
+			// An event written at offset
+			void add (std::uint64_t offset, std::int64_t timestampNs, LogLevel logLevel);
+	};
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _LOG_INDEX_WRITER_H_
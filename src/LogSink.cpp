@@ -0,0 +1,455 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StreamLoggerConsts.h"
+#include "StreamLoggerInterfaces.h"
+#include "StreamLoggerSinks.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	//-------------- LogFormatter ----------------
+
+	bool LogFormatter::writesTextAsIs() const
+	{
+		return false;
+	}
+
+	void LogFormatter::formatAround (const EventContainer &, std::string &, std::string &) const {}
+
+	//-------------- TextFormatter ----------------
+
+	// The level part of the lines, for each level (and the last one for OFF, or any invalid value)
+	static constexpr std::string_view levelTags [7] = {" [TRACE]\t", " [DEBUG]\t", " [INFO]\t", " [WARN]\t",
+	                                                   " [ERROR]\t", " [FATAL]\t", " [OFF]\t"};
+
+	static std::string_view getLevelTag (LogLevel logLevel)
+	{
+		int lvl = static_cast<int> (logLevel);
+		return levelTags [(lvl <= 5) ? lvl : 6];
+	}
+
+	// The date, the level tag and textSize bytes of text: reserves the fixed part of the line at once
+	// (with room for the short additions: the line break, a color reset...)
+	static void appendTextPrefix (const EventContainer &event, std::string &out, std::size_t textSize)
+	{
+		std::string_view tag = getLevelTag (event.logLevel);
+		std::size_t size     = out.size() + event.date.size() + tag.size() + textSize + 16;
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			size += TIMED_TAG.size() + event.usedTimeTxt.size();
+		}
+		out.reserve (size);
+
+		out += event.date;
+		out += tag;
+	}
+
+	static void appendTextSuffix (const EventContainer &event, std::string &out, bool withThread)
+	{
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			out += TIMED_TAG;
+			out += event.usedTimeTxt;
+		}
+		if (event.sampleRate > 1)
+		{
+			out += "\tsample_rate=";
+			out += std::to_string (event.sampleRate);
+		}
+		if (withThread && event.threadIndex != 0)
+		{
+			out += "\tthread=";
+			out += std::to_string (event.threadIndex);
+			std::string_view threadName = getThreadName (event.threadIndex);
+			if (!threadName.empty())
+			{
+				out += "\tthread_name=";
+				out += threadName;
+			}
+		}
+
+		auto appendField = [&] (const FieldView &field) {
+			out += '\t';
+			out += field.key;
+			out += '=';
+			field.appendValue (out);
+		};
+		if (event.context)
+		{
+			out += "\trequest_id=";
+			out += event.context->requestId;
+			if (!event.context->spanId.empty())
+			{
+				out += "\tspan_id=";
+				out += event.context->spanId;
+			}
+			event.context->fields.forEach (appendField);
+		}
+		event.fields.forEach (appendField);
+	}
+
+	TextFormatter::TextFormatter (bool withThread)
+	    : withThread (withThread)
+	{
+	}
+
+	void TextFormatter::format (const EventContainer &event, std::string &out) const
+	{
+		appendTextPrefix (event, out, event.event.size());
+		out += event.event;
+		appendTextSuffix (event, out, this->withThread);
+	}
+
+	bool TextFormatter::writesTextAsIs() const
+	{
+		return true;
+	}
+
+	void TextFormatter::formatAround (const EventContainer &event, std::string &prefix, std::string &suffix) const
+	{
+		appendTextPrefix (event, prefix, 0);
+		appendTextSuffix (event, suffix, this->withThread);
+	}
+
+	//-------------- LogSink ----------------
+
+	LogSink::LogSink (LogLevel level, SinkMode mode)
+	    : mode (mode)
+	    , level (level)
+	    , formatter (std::make_shared<TextFormatter>())
+	{
+		if (mode == SinkMode::ASYNC)
+		{
+			this->worker = std::thread (&LogSink::workerLoop, this);
+		}
+	}
+
+	LogSink::~LogSink()
+	{
+		// Should be already stopped by the derived class, but just in case
+		this->stopWorker();
+	}
+
+	void LogSink::setLevel (LogLevel logLevel)
+	{
+		this->level.store (logLevel, std::memory_order_relaxed);
+	}
+
+	LogLevel LogSink::getLevel() const
+	{
+		return this->level.load (std::memory_order_relaxed);
+	}
+
+	SinkMode LogSink::getMode() const
+	{
+		return this->mode;
+	}
+
+	void LogSink::setFormatter (std::shared_ptr<const LogFormatter> newFormatter)
+	{
+		// The old one is released out of the lock
+		std::lock_guard<std::mutex> lock (this->formatterMtx);
+		this->formatter.swap (newFormatter);
+	}
+
+	std::shared_ptr<const LogFormatter> LogSink::getFormatter() const
+	{
+		std::lock_guard<std::mutex> lock (this->formatterMtx);
+		return this->formatter;
+	}
+
+	const TextRope *LogSink::getRope (const LogFormatter &formatter, const EventContainer &event)
+	{
+		return formatter.writesTextAsIs() ? event.getRope() : nullptr;
+	}
+
+	void LogSink::formatEvent (const LogFormatter &formatter, const EventContainer &event, std::string &out)
+	{
+		if (!event.deferred)
+		{
+			formatter.format (event, out);
+			return;
+		}
+
+		// Left as a rope for the previous formatter
+		EventContainer resolved (event);
+		resolved.resolveText();
+		formatter.format (resolved, out);
+	}
+
+	bool LogSink::accepts (const EventContainer &event) const
+	{
+		// The forced events pass, unless the sink is OFF (p.e. disabled by an error)
+		LogLevel sinkLevel = this->level.load (std::memory_order_relaxed);
+		return event.logLevel >= sinkLevel || (event.forced && sinkLevel != LogLevel::OFF);
+	}
+
+	bool LogSink::writesRopes() const
+	{
+		return false;
+	}
+
+	void LogSink::submit (const EventContainer &event)
+	{
+		if (!this->accepts (event))
+		{
+			return;
+		}
+
+		if (this->mode == SinkMode::INLINE)
+		{
+			// Only the logger lock protects the count: a lost increment only moves the sample
+			std::uint32_t writes = this->inlineWrites.load (std::memory_order_relaxed);
+			this->inlineWrites.store (writes + 1, std::memory_order_relaxed);
+			if (writes % DEFAULTS::LATENCY_SAMPLE != 0)
+			{
+				this->write (event);
+				return;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			this->write (event);
+			this->addWriteTime (start, 1);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (this->queueMtx);
+			if (this->queue.size() + this->writing >= this->maxQueued)
+			{
+				this->queueDropped.fetch_add (1, std::memory_order_relaxed);
+				return;
+			}
+			this->queue.push_back (event);
+			this->queueDepth.store (this->queue.size() + this->writing, std::memory_order_relaxed);
+		}
+		this->queueCv.notify_one();
+	}
+
+	void LogSink::writeBatch (const std::vector<EventContainer> &events)
+	{
+		for (auto &event : events)
+		{
+			this->write (event);
+		}
+	}
+
+	void LogSink::flush() {}
+
+	void LogSink::onIdle() {}
+
+	void LogSink::setIdleInterval (std::chrono::milliseconds interval)
+	{
+		{
+			std::lock_guard<std::mutex> lock (this->queueMtx);
+			this->idleInterval = interval;
+		}
+		this->queueCv.notify_one();
+	}
+
+	void LogSink::setQueueLimit (std::size_t maxEvents)
+	{
+		std::lock_guard<std::mutex> lock (this->queueMtx);
+		this->maxQueued = maxEvents;
+	}
+
+	void LogSink::workerLoop()
+	{
+		// We swap the queue, so the producers only wait for a push_back, never for a write
+		std::vector<EventContainer> batch;
+		std::unique_lock<std::mutex> lock (this->queueMtx);
+		while (true)
+		{
+			auto hasWork = [this] { return this->stopping || !this->queue.empty(); };
+			if (this->idleInterval.count() > 0)
+			{
+				if (!this->queueCv.wait_for (lock, this->idleInterval, hasWork))
+				{
+					this->busy = true;
+					lock.unlock();
+					this->onIdle();
+					lock.lock();
+					this->setIdle();
+					continue;
+				}
+			}
+			else
+			{
+				this->queueCv.wait (lock, hasWork);
+			}
+
+			if (this->queue.empty())
+			{
+				// Stopping, and everything already written
+				break;
+			}
+
+			batch.swap (this->queue);
+			this->writing = batch.size();
+			this->busy    = true;
+			lock.unlock();
+
+			auto start = std::chrono::steady_clock::now();
+
+			// The deferred messages are formatted here, out of the producers (the ropes only if needed)
+			bool ropes = this->writesRopes();
+			for (auto &event : batch)
+			{
+				if (!ropes || event.getRope() == nullptr)
+				{
+					event.resolveText();
+				}
+			}
+
+			this->writeBatch (batch);
+			this->flush();
+			this->addWriteTime (start, batch.size());
+			batch.clear();
+
+			std::uint64_t dropped = this->queueDropped.load (std::memory_order_relaxed);
+			if (dropped != this->reportedDrops)
+			{
+				this->reportError ("Sink queue full: " + std::to_string (dropped - this->reportedDrops)
+				                   + " events dropped");
+				this->reportedDrops = dropped;
+			}
+
+			lock.lock();
+			this->writing = 0;
+			this->queueDepth.store (this->queue.size(), std::memory_order_relaxed);
+			this->setIdle();
+		}
+	}
+
+	void LogSink::setIdle()
+	{
+		this->busy = false;
+		this->idleCv.notify_all();
+	}
+
+	void LogSink::onShutdown()
+	{
+		this->flush();
+	}
+
+	bool LogSink::drain (std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock<std::mutex> lock (this->queueMtx);
+		if (!this->idleCv.wait_until (lock, deadline, [this] { return this->queue.empty() && !this->busy; }))
+		{
+			return false;
+		}
+
+		// With the lock and the worker waiting: nobody else writes it now (but the inline writers, if any)
+		this->onShutdown();
+		return true;
+	}
+
+	void LogSink::prepareFork()
+	{
+		// Kept locked until afterFork: the worker can't start other batch
+		std::unique_lock<std::mutex> lock (this->queueMtx);
+		this->idleCv.wait (lock, [this] { return !this->busy; });
+		lock.release();
+		this->errorsMtx.lock();
+		this->formatterMtx.lock();
+	}
+
+	void LogSink::afterFork (bool child)
+	{
+		bool restart = false;
+		if (child)
+		{
+			// The queued events are the parent's
+			this->queue.clear();
+			this->writing = 0;
+			this->queueDepth.store (0, std::memory_order_relaxed);
+
+			// The copies may have the waiters of the parent threads: new ones, without destroying them
+			new (&this->queueCv) std::condition_variable();
+			new (&this->idleCv) std::condition_variable();
+
+			// The worker is not in this process: forgotten (not joined), and started again
+			restart = this->worker.joinable();
+			new (&this->worker) std::thread();
+		}
+
+		this->formatterMtx.unlock();
+		this->errorsMtx.unlock();
+		this->queueMtx.unlock();
+
+		if (restart)
+		{
+			this->worker = std::thread (&LogSink::workerLoop, this);
+		}
+	}
+
+	void LogSink::addWriteTime (std::chrono::steady_clock::time_point start, std::size_t events)
+	{
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start);
+		this->writeNs.fetch_add (static_cast<std::uint64_t> (elapsed.count()), std::memory_order_relaxed);
+		this->timedEvents.fetch_add (events, std::memory_order_relaxed);
+	}
+
+	std::size_t LogSink::getQueueDepth() const
+	{
+		return this->queueDepth.load (std::memory_order_relaxed);
+	}
+
+	std::uint64_t LogSink::getQueueDropped() const
+	{
+		return this->queueDropped.load (std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds LogSink::takeWriteLatency()
+	{
+		std::uint64_t events = this->timedEvents.exchange (0, std::memory_order_relaxed);
+		std::uint64_t ns     = this->writeNs.exchange (0, std::memory_order_relaxed);
+		return std::chrono::nanoseconds ((events > 0) ? ns / events : 0);
+	}
+
+	void LogSink::stopWorker()
+	{
+		if (!this->worker.joinable())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (this->queueMtx);
+			this->stopping = true;
+		}
+		this->queueCv.notify_one();
+		this->worker.join();
+	}
+
+	void LogSink::reportError (const std::string &error)
+	{
+		std::lock_guard<std::mutex> lock (this->errorsMtx);
+		this->pendingErrors.push_back (error);
+		this->hasPendingErrors.store (true, std::memory_order_release);
+	}
+
+	bool LogSink::takeErrors (std::vector<std::string> &errors)
+	{
+		if (!this->hasPendingErrors.load (std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock (this->errorsMtx);
+		errors.insert (errors.end(), this->pendingErrors.begin(), this->pendingErrors.end());
+		this->pendingErrors.clear();
+		this->hasPendingErrors.store (false, std::memory_order_relaxed);
+		return !errors.empty();
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
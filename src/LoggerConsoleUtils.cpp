@@ -8,6 +8,7 @@
 
 // Windows.h must be in the last as ERROR is redefined
 #ifdef _WIN32
+#	include <iostream>
 #	include <Windows.h>
 
 // Define extra colours
@@ -68,6 +69,24 @@ namespace IgnacioPomar::Util::StreamLogger
 		SetConsoleTextAttribute (GetConsoleHandle(), FOREGROUND_WHITE);
 	}
 
+	std::string_view getColorCode (LogColor)
+	{
+		return {};
+	}
+
+	std::string_view getResetCode ()
+	{
+		return {};
+	}
+
+	void writeConsoleLine (LogColor color, const std::string &line)
+	{
+		setConsoleColor (color);
+		std::clog.write (line.data(), static_cast<std::streamsize> (line.size()));
+		std::clog.flush();
+		resetConsoleColor();
+	}
+
 }    // namespace IgnacioPomar::Util::StreamLogger
 
 #else    //_WIN32
@@ -76,34 +95,50 @@ namespace IgnacioPomar::Util::StreamLogger
 namespace IgnacioPomar::Util::StreamLogger
 {
 
+	// In the order of LogColor
+	static constexpr std::string_view colorCodes [] = {
+	    "\033[30m",    // BLACK
+	    "\033[37m",    // WHITE
+	    "\033[90m",    // GREY
+	    "\033[31m",    // RED
+	    "\033[91m",    // LIGHTRED
+	    "\033[32m",    // GREEN
+	    "\033[33m",    // YELLOW
+	    "\033[34m",    // BLUE
+	    "\033[35m",    // MAGENTA
+	    "\033[36m",    // CYAN
+	    /*
+	    LIGHTGREEN: "\033[92m", LIGHTYELLOW: "\033[93m", LIGHTBLUE: "\033[94m", LIGHTMAGENTA: "\033[95m",
+	    LIGHTCYAN: "\033[96m"
+	    */
+	};
+
+	std::string_view getColorCode (LogColor color)
+	{
+		std::size_t idx = static_cast<std::size_t> (color);
+		return (idx < std::size (colorCodes)) ? colorCodes [idx] : std::string_view {};
+	}
+
+	std::string_view getResetCode ()
+	{
+		return "\033[0m";
+	}
+
 	void setConsoleColor (LogColor color)
 	{
-		switch (color)
-		{
-		case LogColor::BLACK: std::clog << "\033[30m"; break;
-		case LogColor::WHITE: std::clog << "\033[37m"; break;
-		case LogColor::GREY: std::clog << "\033[90m"; break;
-		case LogColor::RED: std::clog << "\033[31m"; break;
-		case LogColor::LIGHTRED: std::clog << "\033[91m"; break;
-		case LogColor::GREEN: std::clog << "\033[32m"; break;
-		case LogColor::YELLOW: std::clog << "\033[33m"; break;
-		case LogColor::BLUE: std::clog << "\033[34m"; break;
-		case LogColor::MAGENTA: std::clog << "\033[35m"; break;
-		case LogColor::CYAN: std::clog << "\033[36m"; break;
-		/*
-		case LogColor::LIGHTGREEN: std::clog << "\033[92m"; break;
-		case LogColor::LIGHTYELLOW: std::clog << "\033[93m"; break;
-		case LogColor::LIGHTBLUE: std::clog << "\033[94m"; break;
-		case LogColor::LIGHTMAGENTA: std::clog << "\033[95m"; break;
-		case LogColor::LIGHTCYAN: std::clog << "\033[96m"; break;
-		*/
-		default: break;
-		}
+		std::clog << getColorCode (color);
 	}
 
 	void resetConsoleColor ()
 	{
-		std::cout << "\033[0m";
+		std::clog << getResetCode();
+	}
+
+	void writeConsoleLine (LogColor, const std::string &line)
+	{
+		// The color codes are in the line: a single write, so the lines of other channels don't get mixed in
+		std::clog.write (line.data(), static_cast<std::streamsize> (line.size()));
+		std::clog.flush();
 	}
 }    // namespace IgnacioPomar::Util::StreamLogger
 #endif    //_WIN32
@@ -4,6 +4,9 @@
  *	Copyright	(C) 2024  Ignacio Pomar Ballestero
  ********************************************************************************************/
 
+#include <string>
+#include <string_view>
+
 #include "StreamLoggerConsts.h"
 
 namespace IgnacioPomar::Util::StreamLogger
@@ -12,5 +15,12 @@ namespace IgnacioPomar::Util::StreamLogger
 	void setConsoleColor (LogColor color);
 	void resetConsoleColor ();
 
+	// The escape codes to put in the line itself (ANSI). Empty on Windows: the color is a console attribute
+	std::string_view getColorCode (LogColor color);
+	std::string_view getResetCode ();
+
+	// A whole line (with its line break, and the color codes) in a single write. Windows: it sets the color
+	void writeConsoleLine (LogColor color, const std::string &line);
+
 	// const std::string &getLevelName (LogLevel logLevel)
 }    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,159 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#pragma once
+#ifndef _RAW_IO_H_
+#	define _RAW_IO_H_
+
+#	include <cerrno>
+#	include <cstddef>
+#	include <cstdint>
+#	include <cstring>
+
+#	ifdef _WIN32
+#		include <cstdio>
+#		include <fcntl.h>
+#		include <io.h>
+#	else
+#		include <fcntl.h>
+#		include <sys/uio.h>
+#		include <unistd.h>
+#	endif
+
+// Unbuffered file descriptors I/O. Everything here is async-signal-safe (it's used by the crash handler)
+namespace IgnacioPomar::Util::StreamLogger::RawIO
+{
+	inline int openFile (const char *path, bool truncate)
+	{
+#	ifdef _WIN32
+		int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND);
+		return _open (path, flags, _S_IREAD | _S_IWRITE);
+#	else
+		int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND);
+		return ::open (path, flags, 0644);
+#	endif
+	}
+
+	inline void closeFile (int fd)
+	{
+#	ifdef _WIN32
+		_close (fd);
+#	else
+		::close (fd);
+#	endif
+	}
+
+	// Retries the partial writes. False on error
+	inline bool writeAll (int fd, const char *data, std::size_t size)
+	{
+		while (size > 0)
+		{
+#	ifdef _WIN32
+			int written = _write (fd, data, static_cast<unsigned int> (size));
+#	else
+			ssize_t written = ::write (fd, data, size);
+#	endif
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+			data += written;
+			size -= static_cast<std::size_t> (written);
+		}
+		return true;
+	}
+
+	// A piece of a gather write
+	struct TextPiece
+	{
+			const char *data;
+			std::size_t size;
+	};
+
+	// Writes the pieces in order, without joining them (writev). Retries the partial writes. False on error
+	inline bool writeVector (int fd, const TextPiece *pieces, std::size_t count)
+	{
+#	ifdef _WIN32
+		for (std::size_t i = 0; i < count; i++)
+		{
+			if (!writeAll (fd, pieces [i].data, pieces [i].size))
+			{
+				return false;
+			}
+		}
+		return true;
+#	else
+		constexpr std::size_t MAX_PIECES = 64;
+		struct iovec iov [MAX_PIECES];
+		std::size_t skip = 0;    // Already written bytes of the first piece
+		while (count > 0)
+		{
+			std::size_t used = (count < MAX_PIECES) ? count : MAX_PIECES;
+			for (std::size_t i = 0; i < used; i++)
+			{
+				iov [i].iov_base = const_cast<char *> (pieces [i].data);
+				iov [i].iov_len  = pieces [i].size;
+			}
+			iov [0].iov_base = const_cast<char *> (pieces [0].data + skip);
+			iov [0].iov_len -= skip;
+
+			ssize_t written = ::writev (fd, iov, static_cast<int> (used));
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+
+			std::size_t done = static_cast<std::size_t> (written) + skip;
+			while (count > 0 && done >= pieces->size)
+			{
+				done -= pieces->size;
+				pieces++;
+				count--;
+			}
+			skip = done;
+		}
+		return true;
+#	endif
+	}
+
+	// Size of an open file (p.e. the offset of the next append). 0 on error
+	inline std::uint64_t getSize (int fd)
+	{
+#	ifdef _WIN32
+		long long size = _lseeki64 (fd, 0, SEEK_END);
+#	else
+		off_t size = ::lseek (fd, 0, SEEK_END);
+#	endif
+		return (size < 0) ? 0 : static_cast<std::uint64_t> (size);
+	}
+
+	inline bool writeText (int fd, const char *text)
+	{
+		return writeAll (fd, text, std::strlen (text));
+	}
+
+	inline bool writeNumber (int fd, std::uint64_t value)
+	{
+		char buf [24];
+		char *pos = buf + sizeof (buf);
+		do
+		{
+			*--pos = static_cast<char> ('0' + value % 10);
+			value /= 10;
+		} while (value > 0);
+		return writeAll (fd, pos, static_cast<std::size_t> (buf + sizeof (buf) - pos));
+	}
+}    // namespace IgnacioPomar::Util::StreamLogger::RawIO
+
+#endif    // _RAW_IO_H_
@@ -0,0 +1,295 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#ifndef _WIN32
+
+#	include <chrono>
+#	include <cstring>
+#	include <new>
+
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+
+#	include "StreamLoggerShmRing.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	static std::uint32_t roundUpPow2 (std::uint32_t value)
+	{
+		std::uint32_t pow2 = 1;
+		while (pow2 < value)
+		{
+			pow2 <<= 1;
+		}
+		return pow2;
+	}
+
+	//-------------- ShmRingSink ----------------
+
+	ShmRingSink::ShmRingSink (const std::string &name, LogLevel level, std::uint32_t slotSize,
+	                          std::uint32_t slotCount)
+	    : LogSink (level, SinkMode::INLINE)
+	    , shmName (name)
+	{
+		slotSize  = roundUpPow2 (slotSize < 2 * sizeof (ShmSlotHeader) ? 2 * sizeof (ShmSlotHeader) : slotSize);
+		slotCount = roundUpPow2 (slotCount < 2 ? 2 : slotCount);
+
+		// A new segment: a consumer of a previous one keeps its mapping, and detects it with isStale
+		shm_unlink (shmName.c_str());
+		int fd = shm_open (shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd < 0)
+		{
+			this->setLevel (LogLevel::OFF);
+			this->reportError ("Unable to create the shared memory ring: " + shmName);
+			return;
+		}
+
+		this->mappedSize = sizeof (ShmRingHeader) + std::size_t (slotSize) * slotCount;
+		void *mem        = MAP_FAILED;
+		if (ftruncate (fd, static_cast<off_t> (this->mappedSize)) == 0)
+		{
+			mem = mmap (nullptr, this->mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close (fd);
+
+		if (mem == MAP_FAILED)
+		{
+			shm_unlink (shmName.c_str());
+			this->mappedSize = 0;
+			this->setLevel (LogLevel::OFF);
+			this->reportError ("Unable to map the shared memory ring: " + shmName);
+			return;
+		}
+
+		// The segment is zero filled: build the atomics in place
+		this->header = new (mem) ShmRingHeader {};
+		this->slots  = static_cast<unsigned char *> (mem) + sizeof (ShmRingHeader);
+		this->slotMask = slotCount - 1;
+
+		header->version     = SHM_RING_VERSION;
+		header->slotSize    = slotSize;
+		header->slotCount   = slotCount;
+		header->producerPid = getpid();
+		for (std::uint32_t i = 0; i < slotCount; i++)
+		{
+			auto *slot = new (this->slots + std::size_t (i) * slotSize) ShmSlotHeader {};
+			slot->sequence.store (i, std::memory_order_relaxed);
+		}
+
+		// Publish: the consumer checks the magic before anything else
+		std::atomic_thread_fence (std::memory_order_release);
+		std::atomic_ref<std::uint32_t> (header->magic).store (SHM_RING_MAGIC, std::memory_order_release);
+	}
+
+	ShmRingSink::~ShmRingSink()
+	{
+		this->stopWorker();
+		if (this->header != nullptr)
+		{
+			// The name is kept: the consumer may not have read the last events yet
+			munmap (this->header, this->mappedSize);
+		}
+	}
+
+	bool ShmRingSink::isOpen() const
+	{
+		return this->header != nullptr;
+	}
+
+	std::uint64_t ShmRingSink::getDropped() const
+	{
+		return (this->header != nullptr) ? header->dropped.load (std::memory_order_relaxed) : 0;
+	}
+
+	void ShmRingSink::write (const EventContainer &event)
+	{
+		if (this->header == nullptr)
+		{
+			return;
+		}
+
+		// Reserve a slot
+		ShmSlotHeader *slot;
+		std::uint64_t pos = header->writePos.load (std::memory_order_relaxed);
+		while (true)
+		{
+			slot = reinterpret_cast<ShmSlotHeader *> (this->slots + (pos & slotMask) * header->slotSize);
+
+			std::uint64_t seq = slot->sequence.load (std::memory_order_acquire);
+			std::int64_t diff = static_cast<std::int64_t> (seq - pos);
+			if (diff == 0)
+			{
+				if (header->writePos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// Full: the consumer is behind. Never wait for it
+				header->dropped.fetch_add (1, std::memory_order_relaxed);
+				return;
+			}
+			else
+			{
+				pos = header->writePos.load (std::memory_order_relaxed);
+			}
+		}
+
+		// Fill it
+		std::size_t maxText = header->slotSize - sizeof (ShmSlotHeader);
+		std::size_t textLen = event.event.size();
+		slot->flags         = 0;
+		if (textLen > maxText)
+		{
+			textLen     = maxText;
+			slot->flags = SHM_SLOT_FLAG_TRUNCATED;
+		}
+
+		slot->timestampNs =
+		    std::chrono::duration_cast<std::chrono::nanoseconds> (event.timePoint.time_since_epoch()).count();
+		slot->durationNs = 0;
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			slot->durationNs =
+			    std::chrono::duration_cast<std::chrono::nanoseconds> (event.endTimePoint - event.timePoint).count();
+		}
+		slot->logLevel   = static_cast<std::uint8_t> (event.logLevel);
+		slot->eventType  = event.eventType;
+		slot->textLength = static_cast<std::uint32_t> (textLen);
+		std::memcpy (reinterpret_cast<unsigned char *> (slot) + sizeof (ShmSlotHeader), event.event.data(), textLen);
+
+		// Publish it
+		slot->sequence.store (pos + 1, std::memory_order_release);
+	}
+
+	//-------------- ShmRingReader ----------------
+
+	ShmRingReader::ShmRingReader (const std::string &name)
+	    : shmName (name)
+	{
+	}
+
+	ShmRingReader::~ShmRingReader()
+	{
+		this->close();
+	}
+
+	bool ShmRingReader::open()
+	{
+		if (this->header != nullptr)
+		{
+			return true;
+		}
+
+		int fd = shm_open (shmName.c_str(), O_RDWR, 0);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		void *mem = MAP_FAILED;
+		if (fstat (fd, &st) == 0 && static_cast<std::size_t> (st.st_size) >= sizeof (ShmRingHeader))
+		{
+			mem = mmap (nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close (fd);
+
+		if (mem == MAP_FAILED)
+		{
+			return false;
+		}
+
+		auto *hdr = static_cast<ShmRingHeader *> (mem);
+		std::size_t expectedSize =
+		    sizeof (ShmRingHeader) + std::size_t (hdr->slotSize) * std::size_t (hdr->slotCount);
+		if (std::atomic_ref<std::uint32_t> (hdr->magic).load (std::memory_order_acquire) != SHM_RING_MAGIC
+		    || hdr->version != SHM_RING_VERSION || expectedSize > static_cast<std::size_t> (st.st_size))
+		{
+			// Not ready yet, or not a ring
+			munmap (mem, st.st_size);
+			return false;
+		}
+
+		this->header     = hdr;
+		this->slots      = static_cast<unsigned char *> (mem) + sizeof (ShmRingHeader);
+		this->mappedSize = st.st_size;
+		this->slotMask   = hdr->slotCount - 1;
+		this->inode      = st.st_ino;
+		return true;
+	}
+
+	void ShmRingReader::close()
+	{
+		if (this->header != nullptr)
+		{
+			munmap (this->header, this->mappedSize);
+			this->header = nullptr;
+			this->slots  = nullptr;
+		}
+	}
+
+	bool ShmRingReader::isOpen() const
+	{
+		return this->header != nullptr;
+	}
+
+	bool ShmRingReader::isStale() const
+	{
+		int fd = shm_open (shmName.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		bool stale = (fstat (fd, &st) == 0) && (static_cast<std::uint64_t> (st.st_ino) != this->inode);
+		::close (fd);
+		return stale;
+	}
+
+	bool ShmRingReader::read (ShmEvent &event, std::string &buffer)
+	{
+		if (this->header == nullptr)
+		{
+			return false;
+		}
+
+		std::uint64_t pos = header->readPos.load (std::memory_order_relaxed);
+		auto *slot = reinterpret_cast<ShmSlotHeader *> (this->slots + (pos & slotMask) * header->slotSize);
+		if (slot->sequence.load (std::memory_order_acquire) != pos + 1)
+		{
+			return false;
+		}
+
+		std::size_t maxText = header->slotSize - sizeof (ShmSlotHeader);
+		std::size_t textLen = (slot->textLength > maxText) ? maxText : slot->textLength;
+		buffer.assign (reinterpret_cast<const char *> (slot) + sizeof (ShmSlotHeader), textLen);
+
+		event.timestampNs = slot->timestampNs;
+		event.durationNs  = slot->durationNs;
+		event.logLevel    = static_cast<LogLevel> (slot->logLevel);
+		event.eventType   = slot->eventType;
+		event.truncated   = (slot->flags & SHM_SLOT_FLAG_TRUNCATED) != 0;
+		event.text        = buffer;
+
+		// Release the slot for the next lap
+		slot->sequence.store (pos + header->slotCount, std::memory_order_release);
+		header->readPos.store (pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::uint64_t ShmRingReader::getDropped() const
+	{
+		return (this->header != nullptr) ? header->dropped.load (std::memory_order_relaxed) : 0;
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _WIN32
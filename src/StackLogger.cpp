@@ -8,211 +8,370 @@
 #	include <format>
 #endif
 #include <chrono>
-#include <iostream>
-
-#include <filesystem>
+#include <vector>
 
 #include "StreamLoggerConsts.h"
 
-#include "LoggerConsoleUtils.h"
-
 #include "StackLogger.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
 
-	namespace fs = std::filesystem;
+	StackLogger::StackLogger (const std::string &channelName)
+	    : StackLoggerConfig (channelName)
+	{
+	}
 
-	StackLogger::StackLogger() {}
+	StackLogger::~StackLogger() {}
 
-	StackLogger::~StackLogger()
+	void StackLogger::sendEvents (LogEventsSubscriber &subscriber, LogLevel logLevel)
 	{
-		if (logfile.is_open())
+		for (auto &event : events)
 		{
-			this->logfile.flush();
-			this->logfile.close();
+			if (event.logLevel >= logLevel)
+			{
+				event.resolveText();
+				subscriber.onLogRecord (event);
+			}
 		}
 	}
 
-	void StackLogger::sendEvents (LogEventsSubscriber &subscriber, LogLevel logLevel)
+	void StackLogger::sendEvents (LogEventsSubscriber &subscriber, LogLevel logLevel, std::string_view fieldKey,
+	                              std::string_view fieldValue)
 	{
 		for (auto &event : events)
 		{
-			if (event.logLevel >= logLevel)
+			if (event.logLevel >= logLevel && event.fields.matches (fieldKey, fieldValue))
 			{
-				subscriber.onLogEvent (event.date, event.event, event.logLevel);
+				event.resolveText();
+				subscriber.onLogRecord (event);
 			}
 		}
 	}
 
 	void StackLogger::subscribePushEvents (LogEventsSubscriber &receiver, LogLevel logLevel)
 	{
-		subscribers.emplace_back (receiver, logLevel);
-		this->addSubscriberLevel (logLevel);
+		this->subscriberSink->addSubscriber (receiver, logLevel);
+		this->setEffectiveLevel();
+	}
+
+	void StackLogger::addSink (std::shared_ptr<LogSink> sink)
+	{
+		this->updateConfig ([&sink] (ConfigSnapshot &next) { next.sinks.push_back (std::move (sink)); });
+	}
+
+	void StackLogger::removeSink (const std::shared_ptr<LogSink> &sink)
+	{
+		this->updateConfig ([&sink] (ConfigSnapshot &next) {
+			// The standard sinks can't be removed: set its level to OFF instead
+			for (auto it = next.sinks.begin() + 3; it != next.sinks.end(); ++it)
+			{
+				if (*it == sink)
+				{
+					next.sinks.erase (it);
+					break;
+				}
+			}
+		});
+	}
+
+	bool StackLogger::openFlightRecorder (const std::string &filePath)
+	{
+		// Before opening it: the new recorder starts empty
+		std::list<EventContainer> previous;
+		loadRecorderFile (filePath, previous);
+
+		if (!this->enableRecorder (filePath))
+		{
+			return false;
+		}
+		this->previousRunEvents = std::move (previous);
+		return true;
+	}
+
+	bool StackLogger::loadRecorderFile (const std::string &filePath, std::list<EventContainer> &events)
+	{
+		if (!EventRecorder::load (filePath, events))
+		{
+			return false;
+		}
+		for (auto &event : events)
+		{
+			if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+			{
+				fillUsedTimeTxt (event);
+			}
+		}
+		return true;
+	}
+
+	void StackLogger::sendPreviousRunEvents (LogEventsSubscriber &subscriber, LogLevel logLevel)
+	{
+		for (auto &event : previousRunEvents)
+		{
+			if (event.logLevel >= logLevel)
+			{
+				subscriber.onLogRecord (event);
+			}
+		}
 	}
 
 	void StackLogger::log (LogLevel logLevel, std::string &event)
 	{
-		if (logLevel < this->effectiveLevel)
+		LogFields noFields;
+		this->log (logLevel, event, noFields, nullptr);
+	}
+
+	void StackLogger::log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site)
+	{
+		if (this->isLoggable (logLevel, site))
 		{
-			return;
+			checkBufferFlush (logLevel);
+			this->logEvent (logLevel, event, fields, site);
 		}
+		else
+		{
+			this->bufferEvent (logLevel, event, fields, site);
+		}
+	}
 
-		if (maxStoredEvents > 0 && logLevel >= stackLevel)
+	void StackLogger::log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site)
+	{
+		std::string noText;
+		if (this->isLoggable (logLevel, site))
 		{
-			EventContainer &newEvent = this->events.emplace_back (logLevel);
-			fillEvent (newEvent, event);
-			this->processEvent (newEvent);
+			checkBufferFlush (logLevel);
+			this->logEvent (logLevel, noText, fields, site, std::move (text));
 		}
 		else
 		{
-			EventContainer tmpEvent (logLevel);
-			fillEvent (tmpEvent, event);
-			this->processEvent (tmpEvent);
+			this->bufferEvent (logLevel, noText, fields, site, std::move (text));
+		}
+	}
+
+	void StackLogger::bufferEvent (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site,
+	                               DeferredTextPtr deferred)
+	{
+		ScopedLogBuffer *buffer = ScopedLogBuffer::getCurrent();
+		if (buffer == nullptr || logLevel < buffer->captureLevel)
+		{
+			return;
 		}
 
-		this->cleanExcedentEvents();
+		// Filled now: it keeps its time. Forced, as the sinks don't want it
+		EventContainer buffered (logLevel);
+		this->prepareEvent (buffered, event, fields, site, std::move (deferred));
+		buffered.forced = true;
+		buffer->capture (*this, std::move (buffered));
+	}
+
+	void StackLogger::checkBufferFlush (LogLevel logLevel)
+	{
+		ScopedLogBuffer *buffer = ScopedLogBuffer::getCurrent();
+		if (buffer != nullptr && logLevel >= buffer->flushLevel && !buffer->hasFailed())
+		{
+			buffer->fail();
+		}
 	}
 
-	EventContainer &StackLogger::emplaceEvent (LogLevel logLevel)
+	void StackLogger::logBufferedEvent (EventContainer &event)
 	{
-		return events.emplace_back (logLevel);
+		this->processEvent (event);
 	}
 
-	void StackLogger::sendToConsole (EventContainer &event, bool useTimed)
+	bool StackLogger::drain (std::chrono::steady_clock::time_point deadline)
 	{
-		if (event.logLevel >= consoleLevel)
+		// All of them, even after a timeout: each one waits only until the deadline
+		bool drained = true;
+		auto config  = this->getConfig();
+		for (auto &sink : config->sinks)
 		{
-			int lvl = static_cast<int> (event.logLevel);
-			if (lvl > 5)
-			{
-				lvl = static_cast<int> (LogLevel::FATAL);
-			}
-			LogColor lc = levelColors [lvl];
+			drained = sink->drain (deadline) && drained;
+		}
+		return drained;
+	}
 
-			setConsoleColor (lc);
-			std::clog << event.date << " [" << getLevelName (event.logLevel) << "]\t";
-			std::clog << event.event;
-			if (useTimed)
-			{
-				std::clog << "\tDone in: " << event.usedTimeTxt;
-			}
-			std::clog << std::endl;
-			resetConsoleColor();
+	void StackLogger::prepareFork()
+	{
+		// No configuration change is half done in the child
+		this->configMtx.lock();
+	}
+
+	void StackLogger::afterFork (bool child)
+	{
+		this->configMtx.unlock();
+
+		// A recorder in a file is shared with the parent: the child records in its own memory
+		auto config = this->getConfig();
+		if (child && config->recorder && config->recorder->isMapped())
+		{
+			this->updateConfig ([this] (ConfigSnapshot &next) {
+				unsigned int size = (next.maxStoredEvents > 0) ? next.maxStoredEvents : DEFAULTS::STACK_SIZE;
+				next.recorder     = std::make_shared<EventRecorder> (this->channelName, size);
+			});
 		}
 	}
 
-	void StackLogger::sendToFile (EventContainer &event, bool useTimed)
+	void StackLogger::prepareEvent (EventContainer &newEvent, std::string &event, LogFields &fields,
+	                                const CallSite *site, DeferredTextPtr deferred)
+	{
+		this->fillEvent (newEvent, event, fields, (site != nullptr) ? site->id : NO_CALL_SITE);
+
+		// Only the overrides let through the events below the base level
+		newEvent.forced     = newEvent.logLevel < this->getLevels().base;
+		newEvent.sampleRate = (site != nullptr) ? site->sampleRate.load (std::memory_order_relaxed) : 1;
+		newEvent.deferred   = std::move (deferred);
+	}
+
+	void StackLogger::storeEvent (EventContainer &event)
 	{
-		if (event.logLevel >= fileLevel)
+		auto config = this->getConfig();
+		if (config->maxStoredEvents > 0 && event.logLevel >= config->stackLevel)
 		{
-			// check rotation
-			if (hasRotation)
+			EventContainer &newEvent = this->events.emplace_back (std::move (event));
+			if (config->recorder)
 			{
-				auto dp  = floor<std::chrono::days> (event.timePoint);
-				auto ymd = std::chrono::year_month_day {dp};
+				newEvent.resolveText();
+				config->recorder->record (newEvent);
+			}
+			this->processEvent (newEvent, *config);
+		}
+		else
+		{
+			this->processEvent (event, *config);
+		}
 
-				if (ymd != lastLogDate)
-				{
-					lastLogDate = ymd;
-					if (logfile.is_open())
-					{
-						this->logfile.close();
-					}
+		this->cleanExcedentEvents (config->maxStoredEvents);
+	}
 
-#if __has_include(<format>)
-					auto formattedDate = std::format ("{:04}-{:02}-{:02}", int (ymd.year()), unsigned (ymd.month()),
-					                                  unsigned (ymd.day()));
-#else
-					std::ostringstream oss;
-					oss << std::setw (4) << std::setfill ('0') << int (ymd.year()) << "-";
-					oss << std::setw (2) << std::setfill ('0') << unsigned (ymd.month()) << "-";
-					oss << std::setw (2) << std::setfill ('0') << unsigned (ymd.day());
+	void StackLogger::logEvent (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site,
+	                            DeferredTextPtr deferred)
+	{
+		EventContainer newEvent (logLevel);
+		this->prepareEvent (newEvent, event, fields, site, std::move (deferred));
+		this->storeEvent (newEvent);
+	}
 
-					std::string formattedDate = oss.str();
-#endif
-					size_t pos = logFilePattern.find ("%d");
-					if (pos != std::string::npos)
-					{
-						this->logFilename = logFilePattern.replace (pos, 2, formattedDate);
-					}
-					else
-					{
-						hasRotation       = false;
-						this->logFilename = logFilePattern;
-					}
-				}
-			}
+	EventContainer &StackLogger::emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId)
+	{
+		// Running: it can't be removed from the stack until it finishes
+		EventContainer &event = events.emplace_back (logLevel);
+		event.eventType       = EVENT_TYPE_TIMED_RUNNING;
+		event.callSiteId      = callSiteId;
+
+		// The span keeps the context where it starts, wherever it finishes
+		event.context = getLogContext();
+		return event;
+	}
 
-			if (!logfile.is_open())
-			{
-				fs::path filePath = fs::path (logPath) / this->logFilename;
-				this->logfile.open (filePath, std::ios::out | std::ios::app);
-				if (!this->logfile.is_open())
-				{
-					// Disable file logging
-					this->fileLevel = LogLevel::OFF;
+	void StackLogger::startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+	                                   DeferredTextPtr deferred)
+	{
+		this->fillEvent (event, message, fields, event.callSiteId);
+		event.deferred = std::move (deferred);
+		auto config    = this->getConfig();
+		this->recordEvent (event, *config);
+		this->processEvent (event, *config);
+	}
 
-					// Generate event: unable to open log File
-					std::string msg ("Unable to open log file: ");
-					msg += filePath.string();
-					this->log (LL::ERROR, msg);
-				}
-			}
+	void StackLogger::appendTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+	                                   DeferredTextPtr deferred)
+	{
+		event.fields.append (fields);
+		if (!deferred && !event.deferred && message.size() < DEFAULTS::ROPE_CHUNK_SIZE)
+		{
+			event.event += message;
+			return;
+		}
 
-			if (logfile.is_open())
+		// A big piece: the text becomes a rope, so the next appends don't copy the previous ones
+		std::shared_ptr<TextRope> rope;
+		if (event.deferred.use_count() == 1 && event.getRope() != nullptr)
+		{
+			// Nobody else has it: the async sinks take their copies inside the lock
+			rope = std::const_pointer_cast<TextRope> (std::static_pointer_cast<const TextRope> (event.deferred));
+		}
+		else
+		{
+			// The sinks may be writing the old one: the new one shares its pieces
+			rope = std::make_shared<TextRope>();
+			if (event.deferred)
 			{
-				this->logfile << event.date << " [" << getLevelName (event.logLevel) << "]\t";
-				this->logfile << event.event;
-				if (useTimed)
-				{
-					this->logfile << "\tDone in: " << event.usedTimeTxt;
-				}
-				this->logfile << '\n';
+				rope->append (*event.deferred);
+			}
+			else
+			{
+				rope->append (std::move (event.event));
+				event.event.clear();
 			}
 		}
+
+		if (deferred)
+		{
+			rope->append (*deferred);
+		}
+		else
+		{
+			rope->append (std::move (message));
+		}
+		event.deferred = std::move (rope);
+	}
+
+	void StackLogger::finishTimedEvent (EventContainer &event)
+	{
+		this->fillElapsedTime (event);
+		auto config = this->getConfig();
+		this->recordEvent (event, *config);
+		this->processEvent (event, *config);
 	}
 
-	void StackLogger::sendToSubscribers (EventContainer &event, bool useTimed)
+	void StackLogger::recordEvent (EventContainer &event, const ConfigSnapshot &config)
 	{
-		// YAGNI: consider a thread for each subscriber if we are in MultiThreadSafe flavor
-		// We would need a thread pool?
-		if (event.logLevel >= this->subscriberLevel)
+		if (config.recorder)
 		{
-			for (auto &subscriber : subscribers)
-			{
-				if (event.logLevel >= subscriber.logLevel)
-				{
-					if (useTimed)
-					{
-						subscriber.subscriber.onLogEvent (event.date, event.event + "\tDone in: " + event.usedTimeTxt,
-						                                  event.logLevel);
-					}
-					else
-					{
-						subscriber.subscriber.onLogEvent (event.date, event.event, event.logLevel);
-					}
-				}
-			}
+			event.resolveText();
+			config.recorder->record (event);
 		}
 	}
 
+	void StackLogger::fillEvent (EventContainer &event, std::string &eventTxt, LogFields &fields,
+	                             std::uint32_t callSiteId)
+	{
+		event.fields     = std::move (fields);
+		event.callSiteId = callSiteId;
+		this->fillEvent (event, eventTxt);
+	}
+
 	void StackLogger::fillEvent (EventContainer &event, std::string &eventTxt)
 	{
-		event.event = std::move (eventTxt);
+		event.event       = std::move (eventTxt);
+		event.threadIndex = getThreadIndex();
+		if (!event.context)
+		{
+			// A reference count, not a copy of the context
+			event.context = getLogContext();
+		}
 
 		event.timePoint = std::chrono::system_clock::now();
 #if __has_include(<format>)
 
 		event.date = format ("{}", event.timePoint);
 #else
-		auto in_time_t = std::chrono::system_clock::to_time_t (event.timePoint);
-		struct tm buf;
-		gmtime_r (&in_time_t, &buf);
-		char str [100];
-		strftime ((char *) str, sizeof (str), "%F %T UTC", &buf);
+		// Only seconds: the text changes once per second (per thread, to avoid sharing it)
+		// Trivially destructible: still valid in the static destructors, after the thread_local ones are destroyed
+		thread_local std::time_t lastTime = -1;
+		thread_local char lastDate [64];
+		thread_local std::size_t lastDateLength = 0;
 
-		event.date = str;
+		auto in_time_t = std::chrono::system_clock::to_time_t (event.timePoint);
+		if (in_time_t != lastTime)
+		{
+			struct tm buf;
+			gmtime_r (&in_time_t, &buf);
+			lastDateLength = strftime (lastDate, sizeof (lastDate), "%F %T UTC", &buf);
+			lastTime       = in_time_t;
+		}
+		event.date.assign (lastDate, lastDateLength);
 #endif
 	}
 
@@ -220,7 +379,11 @@ namespace IgnacioPomar::Util::StreamLogger
 	{
 		event.endTimePoint = std::chrono::system_clock::now();
 		event.eventType    = EVENT_TYPE_TIMED_FINISHED;
+		fillUsedTimeTxt (event);
+	}
 
+	void StackLogger::fillUsedTimeTxt (EventContainer &event)
+	{
 		// Compute the duration in milliseconds
 		auto duration = std::chrono::duration_cast<std::chrono::milliseconds> (event.endTimePoint - event.timePoint);
 
@@ -255,15 +418,151 @@ namespace IgnacioPomar::Util::StreamLogger
 
 	void StackLogger::processEvent (EventContainer &event)
 	{
-		// Only with finished Event timed events
-		bool useTimed = EVENT_TYPE_TIMED_FINISHED == event.eventType;
+		this->processEvent (event, *this->getConfig());
+	}
+
+	void StackLogger::processEvent (EventContainer &event, const ConfigSnapshot &config)
+	{
+		const auto &sinks = config.sinks;
+		if (event.deferred)
+		{
+			// Formatted here only if an inline sink writes it now: the async ones format their copy in their thread,
+			// and the ones wich write the text as is write the pieces of a rope
+			bool isRope = event.getRope() != nullptr;
+			for (auto &sink : sinks)
+			{
+				if (sink->getMode() == SinkMode::INLINE && sink->accepts (event) && !(isRope && sink->writesRopes()))
+				{
+					event.resolveText();
+					break;
+				}
+			}
+		}
+
+		for (auto &sink : sinks)
+		{
+			sink->submit (event);
+		}
+
+		this->sendSinkErrors (config);
+		this->checkOverload (config, event.timePoint);
+	}
+
+	void StackLogger::checkOverload (const ConfigSnapshot &config, std::chrono::system_clock::time_point now)
+	{
+		std::int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (now.time_since_epoch()).count();
+		if (config.overload.maxQueuedEvents == 0 || nowNs < this->nextOverloadCheck.load (std::memory_order_relaxed))
+		{
+			return;
+		}
+		this->nextOverloadCheck.store (nowNs + std::chrono::nanoseconds (DEFAULTS::OVERLOAD_INTERVAL).count(),
+		                               std::memory_order_relaxed);
+
+		// Overloaded: any sink over a limit. Caught up: all of them below the half
+		const OverloadLimits &limits = config.overload;
+		bool overloaded              = false;
+		bool caughtUp                = true;
+		for (auto &sink : config.sinks)
+		{
+			std::size_t queued               = sink->getQueueDepth();
+			std::chrono::nanoseconds latency = sink->takeWriteLatency();
+			if (queued > limits.maxQueuedEvents || latency > limits.maxWriteLatency)
+			{
+				overloaded = true;
+			}
+			if (queued > limits.maxQueuedEvents / 2 || latency > limits.maxWriteLatency / 2)
+			{
+				caughtUp = false;
+			}
+		}
+
+		LogLevel currentShed = this->shedLevel.load (std::memory_order_relaxed);
+		int shedIndex        = static_cast<int> (currentShed);
+		if (overloaded && currentShed < LogLevel::WARN)
+		{
+			if (currentShed == LogLevel::TRACE)
+			{
+				this->shedStart = now;
+				for (auto &count : this->shedCounts)
+				{
+					count.store (0, std::memory_order_relaxed);
+				}
+			}
+			this->shedLevel.store (static_cast<LogLevel> (shedIndex + 1), std::memory_order_relaxed);
+		}
+		else if (caughtUp && currentShed > LogLevel::TRACE)
+		{
+			LogLevel restored = static_cast<LogLevel> (shedIndex - 1);
+			this->shedLevel.store (restored, std::memory_order_relaxed);
+			this->sendShedSummary (now, restored);
+		}
+	}
+
+	void StackLogger::sendShedSummary (std::chrono::system_clock::time_point now, LogLevel stillShed)
+	{
+		// The events shed since the previous summary (or since the shedding started)
+		std::string summary = "Overload: shed";
+		const char *separator = " ";
+		for (int i = 0; i < static_cast<int> (LogLevel::WARN); i++)
+		{
+			std::uint64_t count = this->shedCounts [i].exchange (0, std::memory_order_relaxed);
+			if (count > 0)
+			{
+				summary += separator;
+				summary += std::to_string (count) + " ";
+				summary += getLevelName (static_cast<LogLevel> (i));
+				separator = ", ";
+			}
+		}
+		if (*separator == ' ')
+		{
+			summary += " no";
+		}
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds> (now - this->shedStart);
+		summary += " events in " + std::to_string (duration.count()) + "ms, as the outputs were behind";
+		if (stillShed > LogLevel::TRACE)
+		{
+			summary += "; the events below ";
+			summary += getLevelName (stillShed);
+			summary += " are still shed";
+		}
+		this->shedStart = now;
+
+		// We are already inside the lock (if any): don't use log()
+		EventContainer summaryEvent (LogLevel::WARN);
+		fillEvent (summaryEvent, summary);
+		this->processEvent (summaryEvent);
+	}
+
+	void StackLogger::pollOverload()
+	{
+		this->checkOverload (*this->getConfig(), std::chrono::system_clock::now());
+	}
+
+	void StackLogger::sendSinkErrors (const ConfigSnapshot &config)
+	{
+		std::vector<std::string> errors;
+		for (auto &sink : config.sinks)
+		{
+			sink->takeErrors (errors);
+		}
+
+		if (!errors.empty())
+		{
+			// The failing sinks have disabled themselves
+			this->setEffectiveLevel();
 
-		this->sendToConsole (event, useTimed);
-		this->sendToFile (event, useTimed);
-		this->sendToSubscribers (event, useTimed);
+			// We are already inside the lock (if any): don't use log()
+			for (auto &error : errors)
+			{
+				EventContainer errorEvent (LogLevel::ERROR);
+				fillEvent (errorEvent, error);
+				this->processEvent (errorEvent);
+			}
+		}
 	}
 
-	void StackLogger::cleanExcedentEvents()
+	void StackLogger::cleanExcedentEvents (unsigned int maxStoredEvents)
 	{
 		// Delete excedents, skiping the running timed events
 		// See maxStoredEvents notes in the header
@@ -283,24 +582,48 @@ namespace IgnacioPomar::Util::StreamLogger
 		}
 	}
 
-	EventSubscriber::EventSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel)
-	    : subscriber (subscriber)
-	    , logLevel (logLevel)
+	// ------------------- StackLoggerMTSafe -------------------
+	// This class is a wrapper for StackLogger, adding mutex protection
+
+	StackLoggerMTSafe::StackLoggerMTSafe (const std::string &channelName)
+	    : StackLogger (channelName)
 	{
 	}
 
-	// ------------------- StackLoggerMTSafe -------------------
-	// This class is a wrapper for StackLogger, adding mutex protection
+	void StackLoggerMTSafe::pollOverload()
+	{
+		// If other thread has the lock, it checks it when it processes the event
+		std::unique_lock<std::mutex> lock (this->mtx, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			StackLogger::pollOverload();
+		}
+	}
 
-	StackLoggerMTSafe::StackLoggerMTSafe()
-	    : StackLogger()
+	void StackLoggerMTSafe::log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site)
 	{
+		// The levels are atomic: the discarded events don't take the lock
+		if (!this->isLoggable (logLevel, site))
+		{
+			this->bufferEvent (logLevel, event, fields, site);
+			return;
+		}
+		checkBufferFlush (logLevel);
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->logEvent (logLevel, event, fields, site);
 	}
 
-	void StackLoggerMTSafe::log (LogLevel logLevel, std::string &event)
+	void StackLoggerMTSafe::log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site)
 	{
+		std::string noText;
+		if (!this->isLoggable (logLevel, site))
+		{
+			this->bufferEvent (logLevel, noText, fields, site, std::move (text));
+			return;
+		}
+		checkBufferFlush (logLevel);
 		std::lock_guard<std::mutex> lock (this->mtx);
-		StackLogger::log (logLevel, event);
+		this->logEvent (logLevel, noText, fields, site, std::move (text));
 	}
 
 	void StackLoggerMTSafe::sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel)
@@ -309,6 +632,13 @@ namespace IgnacioPomar::Util::StreamLogger
 		StackLogger::sendEvents (receiver, logLevel);
 	}
 
+	void StackLoggerMTSafe::sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel, std::string_view fieldKey,
+	                                    std::string_view fieldValue)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::sendEvents (receiver, logLevel, fieldKey, fieldValue);
+	}
+
 	void StackLoggerMTSafe::subscribePushEvents (LogEventsSubscriber &receiver, LogLevel logLevel)
 	{
 		// do we need to lock the mutex here? It'll happens at the begining of the program, so it should be safe
@@ -316,10 +646,80 @@ namespace IgnacioPomar::Util::StreamLogger
 		StackLogger::subscribePushEvents (receiver, logLevel);
 	}
 
-	EventContainer &StackLoggerMTSafe::emplaceEvent (LogLevel logLevel)
+	void StackLoggerMTSafe::addSink (std::shared_ptr<LogSink> sink)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::addSink (std::move (sink));
+	}
+
+	void StackLoggerMTSafe::removeSink (const std::shared_ptr<LogSink> &sink)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::removeSink (sink);
+	}
+
+	bool StackLoggerMTSafe::openFlightRecorder (const std::string &filePath)
 	{
+		// The recorder has a single writer: no producer may be recording while it's replaced
 		std::lock_guard<std::mutex> lock (this->mtx);
-		return StackLogger::emplaceEvent (logLevel);
+		return StackLogger::openFlightRecorder (filePath);
+	}
+
+	void StackLoggerMTSafe::sendPreviousRunEvents (LogEventsSubscriber &receiver, LogLevel logLevel)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::sendPreviousRunEvents (receiver, logLevel);
+	}
+
+	EventContainer &StackLoggerMTSafe::emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		return StackLogger::emplaceTimedEvent (logLevel, callSiteId);
+	}
+
+	void StackLoggerMTSafe::startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+	                                         DeferredTextPtr deferred)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::startTimedEvent (event, message, fields, std::move (deferred));
+	}
+
+	void StackLoggerMTSafe::appendTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+	                                          DeferredTextPtr deferred)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::appendTimedEvent (event, message, fields, std::move (deferred));
+	}
+
+	void StackLoggerMTSafe::finishTimedEvent (EventContainer &event)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::finishTimedEvent (event);
+	}
+
+	void StackLoggerMTSafe::logBufferedEvent (EventContainer &event)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		StackLogger::logBufferedEvent (event);
+	}
+
+	bool StackLoggerMTSafe::drain (std::chrono::steady_clock::time_point deadline)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		return StackLogger::drain (deadline);
+	}
+
+	void StackLoggerMTSafe::prepareFork()
+	{
+		// No producer is in the middle of an event
+		this->mtx.lock();
+		StackLogger::prepareFork();
+	}
+
+	void StackLoggerMTSafe::afterFork (bool child)
+	{
+		StackLogger::afterFork (child);
+		this->mtx.unlock();
 	}
 
 }    // namespace IgnacioPomar::Util::StreamLogger
@@ -8,13 +8,20 @@
 #ifndef STACKLOGGER_H
 #	define STACKLOGGER_H
 
+#	include <functional>
 #	include <list>
+#	include <memory>
 #	include <string>
-#	include <fstream>
 #	include <chrono>
+#	include <condition_variable>
+#	include <thread>
+#	include <vector>
 
+#	include <atomic>
 #	include <mutex>
 
+#	include "StreamLoggerBuffer.h"
+#	include "StreamLoggerCallSites.h"
 #	include "StreamLoggerInterfaces.h"
 #	include "StreamLoggerConsts.h"
 #	include "EventContainer.h"
@@ -23,14 +30,6 @@
 namespace IgnacioPomar::Util::StreamLogger
 {
 
-	class EventSubscriber
-	{
-		public:
-			EventSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel);
-			LogEventsSubscriber &subscriber;
-			const LogLevel logLevel;
-	};
-
 	/**
 	 * A logger wich stores the events in a stack
 	 */
@@ -38,9 +37,9 @@ namespace IgnacioPomar::Util::StreamLogger
 	{
 		private:
 			std::list<EventContainer> events;
-			std::list<EventSubscriber> subscribers;
 
-			std::ofstream logfile;
+			// Loaded from the flight recorder file, as the previous process left it
+			std::list<EventContainer> previousRunEvents;
 
 			// Prevent illegal usage
 			StackLogger (const StackLogger &)            = delete;    // no copies
@@ -48,57 +47,235 @@ namespace IgnacioPomar::Util::StreamLogger
 			StackLogger (StackLogger &&)                 = delete;    // no move constructor
 			StackLogger &operator= (StackLogger &&)      = delete;    // no move assignments
 
-			void sendToConsole (EventContainer &event, bool useTimed);
-			void sendToFile (EventContainer &event, bool useTimed);
-			void sendToSubscribers (EventContainer &event, bool useTimed);
+			void sendSinkErrors (const ConfigSnapshot &config);
+
+			// Overload shedding: when the current shedding started, or the last summary was sent
+			std::chrono::system_clock::time_point shedStart;
+			void sendShedSummary (std::chrono::system_clock::time_point now, LogLevel stillShed);
 
 		protected:
-			void cleanExcedentEvents ();
+			void cleanExcedentEvents (unsigned int maxStoredEvents);
+
+			// Without the level check
+			void logEvent (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site,
+			               DeferredTextPtr deferred = nullptr);
+
+			// logEvent in two steps. The first one doesn't use the stack nor the sinks (it needs no lock)
+			void prepareEvent (EventContainer &newEvent, std::string &event, LogFields &fields, const CallSite *site,
+			                   DeferredTextPtr deferred);
+			// To the stack (moved, if stored) and to the sinks
+			void storeEvent (EventContainer &event);
+			void recordEvent (EventContainer &event, const ConfigSnapshot &config);
+
+			// The scoped buffer of the thread (if any): it keeps the events wich didn't pass the levels,
+			// and an event of its flushLevel sends them (outside the lock: each one takes the lock of its backend)
+			void bufferEvent (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site,
+			                  DeferredTextPtr deferred = nullptr);
+			static void checkBufferFlush (LogLevel logLevel);
+
+			// Inside the lock (if any): if it's the time, sheds one more level or restores one
+			// (see setOverloadShedding)
+			void checkOverload (const ConfigSnapshot &config, std::chrono::system_clock::time_point now);
+			void pollOverload () override;
 
 		public:
-			StackLogger();
-			~StackLogger();
+			StackLogger (const std::string &channelName);
+			virtual ~StackLogger();
 
 			void fillEvent (EventContainer &event, std::string &eventTxt);
+			void fillEvent (EventContainer &event, std::string &eventTxt, LogFields &fields, std::uint32_t callSiteId);
 			void fillElapsedTime (EventContainer &event);
+			static void fillUsedTimeTxt (EventContainer &event);
+
+			// The events of a flight recorder file, as the other events of the stack (see EventRecorder::load)
+			static bool loadRecorderFile (const std::string &filePath, std::list<EventContainer> &events);
 			void processEvent (EventContainer &event);
+			// The same, with the configuration the caller already holds (one read of it for each event)
+			void processEvent (EventContainer &event, const ConfigSnapshot &config);
 
 			// void delLogsOltherThan (int maxLogFileDays);
 
-			virtual void log (LogLevel logLevel, std::string &event);
+			void log (LogLevel logLevel, std::string &event);
+			virtual void log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site);
+			virtual void log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site);
 			virtual void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel);
+			virtual void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel, std::string_view fieldKey,
+			                         std::string_view fieldValue);
 			virtual void subscribePushEvents (LogEventsSubscriber &receiver, LogLevel logLevel);
+			virtual void addSink (std::shared_ptr<LogSink> sink);
+			virtual void removeSink (const std::shared_ptr<LogSink> &sink);
+
+			// Loads the events of the previous run from the file, and then records this run in it
+			virtual bool openFlightRecorder (const std::string &filePath);
+			virtual void sendPreviousRunEvents (LogEventsSubscriber &receiver, LogLevel logLevel);
+
+			// Timed events: they are in the stack while running. The text is the message, or deferred if not null
+			virtual EventContainer &emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId);
+			virtual void startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+			                              DeferredTextPtr deferred);
+			virtual void appendTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+			                               DeferredTextPtr deferred);
+			virtual void finishTimedEvent (EventContainer &event);
 
-			virtual EventContainer &emplaceEvent (LogLevel logLevel);
+			// An event of a scoped buffer wich has failed: only to the sinks (it's below the stack level)
+			virtual void logBufferedEvent (EventContainer &event);
+
+			// Writes the pending events of its sinks, waiting up to the deadline (see shutdown). False on timeout
+			virtual bool drain (std::chrono::steady_clock::time_point deadline);
+
+			// fork(): the locks of the backend (not the ones of its sinks), see registerLifecycleHandlers
+			virtual void prepareFork ();
+			virtual void afterFork (bool child);
 	};
 
 	class StackLoggerMTSafe : public StackLogger
 	{
-		private:
+		protected:
 			std::mutex mtx;
 
+		private:
 			// Prevent illegal usage: this class is a singleton
 			StackLoggerMTSafe (const StackLoggerMTSafe &)            = delete;    // no copies
 			StackLoggerMTSafe &operator= (const StackLoggerMTSafe &) = delete;    // no self-assignments
 			StackLoggerMTSafe (StackLoggerMTSafe &&)                 = delete;    // no move constructor
 			StackLoggerMTSafe &operator= (StackLoggerMTSafe &&)      = delete;    // no move assignments
 
+		protected:
+			void pollOverload () override;
+
 		public:
-			// Wee need the constructor to be public, as this class is a singleton
-			StackLoggerMTSafe();
+			// Wee need the constructor to be public, as this class is a singleton (one per channel)
+			StackLoggerMTSafe (const std::string &channelName);
 
 			// Dont need to override destructor: we dont need mutex as this calss is a singelton, and we will use the
 			// base class destructor
 			//~StackLoggerMTSafe();
 
-			void log (LogLevel logLevel, std::string &event) override;
+			void log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site) override;
+			void log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site) override;
 			void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel) override;
+			void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel, std::string_view fieldKey,
+			                 std::string_view fieldValue) override;
 			void subscribePushEvents (LogEventsSubscriber &receiver, LogLevel logLevel) override;
+			void addSink (std::shared_ptr<LogSink> sink) override;
+			void removeSink (const std::shared_ptr<LogSink> &sink) override;
+			bool openFlightRecorder (const std::string &filePath) override;
+			void sendPreviousRunEvents (LogEventsSubscriber &receiver, LogLevel logLevel) override;
+
+			EventContainer &emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId) override;
+			void startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+			                      DeferredTextPtr deferred) override;
+			void appendTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+			                       DeferredTextPtr deferred) override;
+			void finishTimedEvent (EventContainer &event) override;
+
+			void logBufferedEvent (EventContainer &event) override;
 
-			EventContainer &emplaceEvent (LogLevel logLevel) override;
+			bool drain (std::chrono::steady_clock::time_point deadline) override;
+			void prepareFork () override;
+			void afterFork (bool child) override;
 	};
 
+	/**
+	 * Multi thread safe, with the ingestion sharded: the producers fill the event out of any lock, and add it to the
+	 * pending events of its shard (each one with its lock). A consumer thread merges the shards by sequence number,
+	 * and stores and sends the events in that order. The operations wich need the previous events (pull, timed
+	 * events...) merge the pending ones first
+	 */
+	class StackLoggerSharded : public StackLoggerMTSafe
+	{
+		private:
+			struct PendingEvent
+			{
+					std::uint64_t sequence;
+					EventContainer event;
+			};
+
+			// Each one in its own cache lines: the producers of a shard don't touch the others
+			struct alignas (64) Shard
+			{
+					std::mutex mtx;
+					std::vector<PendingEvent> pending;    // In sequence order
+			};
+
+			const unsigned int shardCount;
+			const ShardAffinity affinity;
+			unsigned int coresPerShard;
+			std::unique_ptr<Shard []> shards;
+			std::atomic<std::uint64_t> nextSequence {0};
+
+			// Taken by a merge, but not mergeable yet: a producer may still be adding a previous one
+			std::vector<PendingEvent> carried;
+			std::vector<PendingEvent> merging;
+			std::vector<std::uint32_t> mergeOrder;
+
+			//--- Consumer: it polls while there are events, and sleeps (until a producer wakes it) when idle ---
+			std::thread consumer;
+			std::mutex consumerMtx;
+			std::condition_variable consumerCv;
+			std::atomic<bool> consumerIdle {true};
+			bool stopping = false;
+
+			Shard &getShard ();
+			void enqueue (EventContainer &&event);
+			void consumerLoop ();
+			void wakeConsumer ();
+
+			// Stores and sends the pending events, in order. Inside the lock (mtx). Returns how many
+			std::size_t mergeShards ();
+
+		public:
+			StackLoggerSharded (const std::string &channelName, unsigned int shardCount, ShardAffinity affinity);
+			~StackLoggerSharded();
+
+			void log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site) override;
+			void log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site) override;
+			void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel) override;
+			void sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel, std::string_view fieldKey,
+			                 std::string_view fieldValue) override;
+			void removeSink (const std::shared_ptr<LogSink> &sink) override;
+			bool openFlightRecorder (const std::string &filePath) override;
+
+			EventContainer &emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId) override;
+			void startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+			                      DeferredTextPtr deferred) override;
+			void finishTimedEvent (EventContainer &event) override;
+
+			void logBufferedEvent (EventContainer &event) override;
+
+			bool drain (std::chrono::steady_clock::time_point deadline) override;
+			void prepareFork () override;
+			void afterFork (bool child) override;
+	};
+
+	//--- Configuration vars (see Config): constant initialized, usable before main ---
+	extern std::atomic<bool> gMultiThreadSafe;
+	extern std::atomic<bool> isLoggerInitialized;
+
+	// Sharded backends (only the multi-thread safe ones): for the backends created after setting it
+	extern std::atomic<unsigned int> gShardCount;
+	extern std::atomic<ShardAffinity> gShardAffinity;
+
 	StackLogger &getLogger ();
+	StackLogger &getChannelLogger (const std::string &channelName);
+
+	//--- Level overrides ---
+	std::int64_t steadyNowNs ();
+	LogLevel getSiteOverrideLevel ();
+	bool isSiteOverridden (const CallSite &site, LogLevel logLevel, std::int64_t nowNs);
+
+	// After a change in the call site overrides: all the backends created so far
+	void refreshLoggersLevels ();
+
+	// The formatters, without locks: the file and the line of a site never change once registered (nullptr if unknown)
+	const CallSite *findCallSite (std::uint32_t id);
+
+	// fork(): no call site is half registered in the child
+	void lockCallSiteRegistry ();
+	void unlockCallSiteRegistry ();
+
+	// All the channels created so far (not the default logger)
+	void forEachChannelLogger (const std::function<void (StackLogger &)> &action);
 
 }    // namespace IgnacioPomar::Util::StreamLogger
 #endif    // STACKLOGGER_H
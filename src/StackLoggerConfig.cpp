@@ -4,17 +4,17 @@
  *	Copyright	(C) 2024  Ignacio Pomar Ballestero
  ********************************************************************************************/
 
+#include <atomic>
 #include <string>
 
 #include "StreamLoggerConsts.h"
 #include "StackLoggerConfig.h"
 #include "StackLogger.h"
 #include "StreamLogger.h"
+#include "CrashHandler.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
-	extern bool gMultiThreadSafe;
-	extern bool isLoggerInitialized;
 	namespace Config
 	{
 		void setMultiThreadSafe (bool multiThreadSafe)
@@ -30,6 +30,12 @@ namespace IgnacioPomar::Util::StreamLogger
 			}
 		}
 
+		void setShards (unsigned int shardCount, ShardAffinity affinity)
+		{
+			gShardCount    = shardCount;
+			gShardAffinity = affinity;
+		}
+
 		void setStackSize (unsigned int stackSize)
 		{
 			getLogger().setStackSize (stackSize);
@@ -63,129 +69,305 @@ namespace IgnacioPomar::Util::StreamLogger
 		{
 			getLogger().setStackLevel (logLevel);
 		}
+
+		void setLevelOverride (LogLevel logLevel, std::chrono::seconds duration)
+		{
+			getLogger().setLevelOverride (logLevel, duration);
+		}
+
+		void setChannelLevelOverride (const std::string &channelName, LogLevel logLevel, std::chrono::seconds duration)
+		{
+			getChannelLogger (channelName).setLevelOverride (logLevel, duration);
+		}
+
+		void setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter)
+		{
+			getLogger().setConsoleFormatter (std::move (formatter));
+		}
+
+		void setFileFormatter (std::shared_ptr<const LogFormatter> formatter)
+		{
+			getLogger().setFileFormatter (std::move (formatter));
+		}
+
+		void setFileIndex (std::uint32_t eventsPerEntry)
+		{
+			getLogger().setFileIndex (eventsPerEntry);
+		}
+
+		void setOverloadShedding (std::size_t maxQueuedEvents, std::chrono::microseconds maxWriteLatency)
+		{
+			getLogger().setOverloadShedding (maxQueuedEvents, maxWriteLatency);
+		}
+
+		void addSink (std::shared_ptr<LogSink> sink)
+		{
+			getLogger().addSink (std::move (sink));
+		}
+
+		void removeSink (const std::shared_ptr<LogSink> &sink)
+		{
+			getLogger().removeSink (sink);
+		}
+
+		bool setFlightRecorder (const std::string &filePath)
+		{
+			return getLogger().openFlightRecorder (filePath);
+		}
 	};    // namespace Config
 
 	//--------------  Configuration functions ----------------
 	void StackLoggerConfig::setLevelColor (LogLevel logLevel, LogColor logColor)
 	{
-		this->levelColors [static_cast<int> (logLevel)] = logColor;
-		this->setEffectiveLevel();
+		this->consoleSink->setLevelColor (logLevel, logColor);
 	}
 
 	void StackLoggerConfig::setConsoleLevel (LogLevel logLevel)
 	{
-		// this->consoleLevel = (logLevel > LogLevel::FATAL) ? LogLevel::FATAL : logLevel;
-		this->consoleLevel = logLevel;
+		this->consoleSink->setLevel (logLevel);
 		this->setEffectiveLevel();
 	}
 
 	void StackLoggerConfig::setFileLevel (LogLevel logLevel)
 	{
-		// this->fileLevel = (logLevel > LogLevel::FATAL) ? LogLevel::FATAL : logLevel;
-		this->fileLevel = logLevel;
+		this->fileSink->setLevel (logLevel);
 		this->setEffectiveLevel();
 	}
 
 	void StackLoggerConfig::setStackLevel (LogLevel logLevel)
 	{
-		if (this->maxStoredEvents != 0)
+		this->updateConfig ([logLevel] (ConfigSnapshot &next) {
+			if (next.maxStoredEvents != 0)
+			{
+				// next.stackLevel = (logLevel > LogLevel::FATAL) ? LogLevel::FATAL : logLevel;
+				next.stackLevel = logLevel;
+			}
+			else
+			{
+				next.stackLevel = LogLevel::OFF;
+			}
+		});
+	}
+
+	void StackLoggerConfig::setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter)
+	{
+		this->consoleSink->setFormatter (std::move (formatter));
+	}
+
+	void StackLoggerConfig::setFileFormatter (std::shared_ptr<const LogFormatter> formatter)
+	{
+		this->fileSink->setFormatter (std::move (formatter));
+	}
+
+	void StackLoggerConfig::setFileIndex (std::uint32_t eventsPerEntry)
+	{
+		this->fileSink->setIndexInterval (eventsPerEntry);
+	}
+
+	void StackLoggerConfig::setEffectiveLevel()
+	{
+		// The levels are computed on each publication
+		this->updateConfig ([] (ConfigSnapshot &) {});
+	}
+
+	void StackLoggerConfig::close()
+	{
+		this->updateConfig ([] (ConfigSnapshot &next) { next.closed = true; });
+	}
+
+	void StackLoggerConfig::publishConfig (std::shared_ptr<const ConfigSnapshot> next)
+	{
+		// The lowest level wich someone (the stack or any sink) wants to receive
+		LogLevel baseLevel = next->stackLevel;
+		for (auto &sink : next->sinks)
 		{
-			// this->stackLevel = (logLevel > LogLevel::FATAL) ? LogLevel::FATAL : logLevel;
-			this->stackLevel = logLevel;
+			LogLevel sinkLevel = sink->getLevel();
+			if (sinkLevel < baseLevel)
+			{
+				baseLevel = sinkLevel;
+			}
 		}
-		else
+
+		// And the overrides may let through lower ones
+		LogLevel effLevel = baseLevel;
+		LogLevel overrides [] = {this->levelOverride.load (std::memory_order_relaxed), getSiteOverrideLevel()};
+		for (LogLevel overrideLevel : overrides)
 		{
-			this->stackLevel = LogLevel::OFF;
+			if (overrideLevel < effLevel)
+			{
+				effLevel = overrideLevel;
+			}
 		}
-		this->setEffectiveLevel();
+
+		LevelThresholds levels = {effLevel, baseLevel};
+		if (next->closed)
+		{
+			levels = {LogLevel::OFF, LogLevel::OFF};
+		}
+
+		// The previous one is freed by its last reader (or here, out of the lock)
+		{
+			std::lock_guard<std::mutex> lock (this->snapshotMtx);
+			this->config.swap (next);
+		}
+		this->levels.store (levels, std::memory_order_relaxed);
+	}
+
+	std::shared_ptr<const ConfigSnapshot> StackLoggerConfig::getConfig() const
+	{
+		std::lock_guard<std::mutex> lock (this->snapshotMtx);
+		return this->config;
 	}
 
-	void StackLoggerConfig::resetSubscriberLevel()
+	void StackLoggerConfig::setLevelOverride (LogLevel logLevel, std::chrono::seconds duration)
 	{
-		this->subscriberLevel = LogLevel::OFF;
+		std::int64_t expiry = (duration.count() > 0) ? steadyNowNs() + std::chrono::nanoseconds (duration).count() : 0;
+
+		// The expiry first: a producer wich sees the new level must not see the old expiry
+		this->overrideExpiry.store (expiry, std::memory_order_relaxed);
+		this->levelOverride.store (logLevel, std::memory_order_release);
 		this->setEffectiveLevel();
 	}
 
-	void StackLoggerConfig::addSubscriberLevel (LogLevel logLevel)
+	bool StackLoggerConfig::isOverridden (LogLevel logLevel, const CallSite *site)
 	{
-		// LogLevel sbsLevel = (logLevel > LogLevel::FATAL) ? LogLevel::FATAL : logLevel;
+		std::int64_t nowNs = steadyNowNs();
 
-		if (logLevel < this->subscriberLevel)
+		if (logLevel >= this->levelOverride.load (std::memory_order_acquire))
 		{
-			// this->subscriberLevel = sbsLevel;
-			this->subscriberLevel = logLevel;
+			std::int64_t expiry = this->overrideExpiry.load (std::memory_order_relaxed);
+			if (expiry == 0 || nowNs < expiry)
+			{
+				return true;
+			}
+
+			// Expired: only the first one wich sees it restores the levels
+			LogLevel expiredLevel = this->levelOverride.load (std::memory_order_relaxed);
+			if (expiredLevel != LogLevel::OFF
+			    && this->levelOverride.compare_exchange_strong (expiredLevel, LogLevel::OFF, std::memory_order_relaxed))
+			{
+				this->setEffectiveLevel();
+			}
 		}
 
-		this->setEffectiveLevel();
+		return site != nullptr && isSiteOverridden (*site, logLevel, nowNs);
 	}
 
-	void StackLoggerConfig::setEffectiveLevel()
+	void StackLoggerConfig::setOverloadShedding (std::size_t maxQueuedEvents, std::chrono::microseconds maxWriteLatency)
 	{
-		LogLevel effLevel = this->stackLevel;
-		if (this->consoleLevel < effLevel)
+		this->updateConfig ([maxQueuedEvents, maxWriteLatency] (ConfigSnapshot &next) {
+			next.overload = {maxQueuedEvents, maxWriteLatency};
+		});
+		if (maxQueuedEvents == 0)
 		{
-			effLevel = this->consoleLevel;
+			this->shedLevel.store (LogLevel::TRACE, std::memory_order_relaxed);
 		}
-		if (this->fileLevel < effLevel)
-		{
-			effLevel = this->fileLevel;
-		}
-		if (this->subscriberLevel < effLevel)
+	}
+
+	void StackLoggerConfig::countShed (LogLevel logLevel, const CallSite *site)
+	{
+		// Only the ones wich would have passed without the shedding
+		if (logLevel < this->getLevels().base && !this->isOverridden (logLevel, site))
 		{
-			effLevel = this->subscriberLevel;
+			return;
 		}
-		if (this->stackLevel < effLevel)
+
+		std::uint64_t shed = this->shedCounts [static_cast<int> (logLevel)].fetch_add (1, std::memory_order_relaxed);
+
+		// While the lower levels are shed the logger may get no event at all: the producers check the sinks
+		constexpr std::uint64_t POLL_EVENTS = 64;
+		if (shed % POLL_EVENTS == 0)
 		{
-			effLevel = this->stackLevel;
+			auto now = std::chrono::system_clock::now().time_since_epoch();
+			if (std::chrono::duration_cast<std::chrono::nanoseconds> (now).count()
+			    >= this->nextOverloadCheck.load (std::memory_order_relaxed))
+			{
+				this->pollOverload();
+			}
 		}
-		this->effectiveLevel = effLevel;
 	}
 
-	StackLoggerConfig::StackLoggerConfig()
+	StackLoggerConfig::StackLoggerConfig (const std::string &channelName)
+	    : channelName (channelName)
 	{
-		this->maxStoredEvents = DEFAULTS::STACK_SIZE;
-		this->stackLevel      = DEFAULTS::STACK_LEVEL;
-		this->consoleLevel    = DEFAULTS::CONSOLE_LEVEL;
-		this->fileLevel       = DEFAULTS::FILE_LEVEL;
+		std::string logFilePattern;
+		if (channelName.empty())
+		{
+			logFilePattern = DEFAULTS::FILE_NAME;
+		}
+		else
+		{
+			// Each channel has its own file, to avoid sharing it between backends
+			logFilePattern = DEFAULTS::CHANNEL_FILE_NAME;
+			size_t pos     = logFilePattern.find ("%c");
+			logFilePattern.replace (pos, 2, channelName);
+		}
 
-		this->resetSubscriberLevel();
+		this->consoleSink    = std::make_shared<ConsoleSink> (DEFAULTS::CONSOLE_LEVEL);
+		this->fileSink       = std::make_shared<FileSink> (DEFAULTS::FILE_LEVEL, logFilePattern);
+		this->subscriberSink = std::make_shared<SubscriberSink>();
 
-		this->hasRotation    = true;
-		this->logFilePattern = DEFAULTS::FILE_NAME;
-		this->lastLogDate    = std::chrono::year_month_day {};
+		auto initial             = std::make_shared<ConfigSnapshot>();
+		initial->maxStoredEvents = DEFAULTS::STACK_SIZE;
+		initial->stackLevel      = DEFAULTS::STACK_LEVEL;
+		initial->sinks.push_back (this->consoleSink);
+		initial->sinks.push_back (this->fileSink);
+		initial->sinks.push_back (this->subscriberSink);
 
-		this->logPath = "";
+		if (isCrashHandlerEnabled())
+		{
+			initial->recorder = std::make_shared<EventRecorder> (channelName, initial->maxStoredEvents);
+		}
 
-		this->levelColors [0] = DEFAULTS::COLOR_TRACE;
-		this->levelColors [1] = DEFAULTS::COLOR_DEBUG;
-		this->levelColors [2] = DEFAULTS::COLOR_INFO;
-		this->levelColors [3] = DEFAULTS::COLOR_WARN;
-		this->levelColors [4] = DEFAULTS::COLOR_ERROR;
-		this->levelColors [5] = DEFAULTS::COLOR_FATAL;
+		std::lock_guard<std::mutex> lock (this->configMtx);
+		this->publishConfig (std::move (initial));
+	}
+
+	void StackLoggerConfig::enableRecorder()
+	{
+		this->updateConfig ([this] (ConfigSnapshot &next) {
+			if (!next.recorder)
+			{
+				unsigned int size = (next.maxStoredEvents > 0) ? next.maxStoredEvents : DEFAULTS::STACK_SIZE;
+				next.recorder     = std::make_shared<EventRecorder> (this->channelName, size);
+			}
+		});
+	}
+
+	bool StackLoggerConfig::enableRecorder (const std::string &filePath)
+	{
+		bool opened = false;
+		this->updateConfig ([this, &filePath, &opened] (ConfigSnapshot &next) {
+			unsigned int size = (next.maxStoredEvents > 0) ? next.maxStoredEvents : DEFAULTS::STACK_SIZE;
+			auto recorder = std::make_shared<EventRecorder> (this->channelName, size, DEFAULTS::RECORD_SIZE, filePath);
+			if (recorder->isOpen())
+			{
+				next.recorder = std::move (recorder);
+				opened        = true;
+			}
+		});
+		return opened;
 	}
 
 	void StackLoggerConfig::setStackSize (unsigned int stackSize)
 	{
-		this->maxStoredEvents = stackSize;
-		if (stackSize == 0)
-		{
-			this->stackLevel = LogLevel::OFF;
-		}
-		this->cleanExcedentEvents();
+		this->updateConfig ([stackSize] (ConfigSnapshot &next) {
+			next.maxStoredEvents = stackSize;
+			if (stackSize == 0)
+			{
+				next.stackLevel = LogLevel::OFF;
+			}
+		});
 	}
 
 	void StackLoggerConfig::setOutFile (const std::string fileName)
 	{
-		this->logFilePattern = fileName;
-
-		// Force "reset" the file, and rotation config
-		this->hasRotation = true;
-		this->lastLogDate = std::chrono::year_month_day {};
+		this->fileSink->setOutFile (fileName);
 	}
 
 	void StackLoggerConfig::setOutPath (const std::string filePath)
 	{
-		this->logPath = filePath;
+		this->fileSink->setOutPath (filePath);
 	}
 
 }    // namespace IgnacioPomar::Util::StreamLogger
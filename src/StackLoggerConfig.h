@@ -8,24 +8,72 @@
 #ifndef _STACK_LOGGER_CONFIG_H_
 #	define _STACK_LOGGER_CONFIG_H_
 
-#	include <list>
-#	include <string>
-#	include <fstream>
+#	include <atomic>
 #	include <chrono>
-
+#	include <cstdint>
+#	include <memory>
 #	include <mutex>
+#	include <string>
+#	include <vector>
 
+#	include "StreamLoggerCallSites.h"
 #	include "StreamLoggerInterfaces.h"
 #	include "StreamLoggerConsts.h"
+#	include "StreamLoggerSinks.h"
 #	include "EventContainer.h"
+#	include "EventRecorder.h"
 
 namespace IgnacioPomar::Util::StreamLogger
 {
+	/**
+	 * Both levels in one atomic: the producers decide with a single relaxed load
+	 */
+	struct LevelThresholds
+	{
+			LogLevel effective;    // Lowest level wich may pass, overrides included
+			LogLevel base;         // Lowest level wich someone (the stack or any sink) wants
+	};
+
+	/**
+	 * Overload shedding: the limits of each sink. A 0 queue limit disables it
+	 */
+	struct OverloadLimits
+	{
+			std::size_t maxQueuedEvents = 0;
+			std::chrono::microseconds maxWriteLatency {0};
+	};
+
+	/**
+	 * The configuration read by the producers. Never modified once published: the writers publish a new copy
+	 */
+	struct ConfigSnapshot
+	{
+			LogLevel stackLevel;
+			OverloadLimits overload;
+
+			// After shutdown: every event is discarded
+			bool closed = false;
+
+			// In the current implementation, the Timed Events are, while running, in the stack
+			// That means that it can have more than maxStoredEvents events
+			// And that the stack may contain lower level events than the stackLevel
+			// There is no unlimited stack: 0 means no stack
+			// YAGNI: Consider extract the timed events to a aditional list
+			unsigned int maxStoredEvents;
+
+			// All the outputs, in the order they receive the events. The first three are the standard ones
+			std::vector<std::shared_ptr<LogSink>> sinks;
+
+			// Copy of the stack in preallocated memory, for the crash handler (nullptr if not enabled)
+			std::shared_ptr<EventRecorder> recorder;
+	};
+
 	class StackLoggerConfig
 	{
 		public:    // methods
-			StackLoggerConfig();
+			StackLoggerConfig (const std::string &channelName);
 
+			// The stack is trimmed by the producers, the next time they log
 			void setStackSize (unsigned int stackSize);
 
 			void setOutFile (const std::string fileName);    // It'll rotate each day if the template has a %d
@@ -36,36 +84,107 @@ namespace IgnacioPomar::Util::StreamLogger
 			void setFileLevel (LogLevel logLevel);
 			void setStackLevel (LogLevel logLevel);
 
-			void resetSubscriberLevel ();
-			void addSubscriberLevel (LogLevel logLevel);
+			void setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter);
+			void setFileFormatter (std::shared_ptr<const LogFormatter> formatter);
+			void setFileIndex (std::uint32_t eventsPerEntry);
 
-		private:
+			// Lets through the events of this channel from this level. OFF removes it
+			void setLevelOverride (LogLevel logLevel, std::chrono::seconds duration);
+
+			// When the sinks don't keep up, the lower levels are shed, one more each interval (up to INFO: WARN and
+			// above always pass). They are restored, one each interval, when the sinks are below the half of the
+			// limits; each restored level sends a WARN event with the events shed since the previous one. A 0 queue
+			// limit disables it
+			void setOverloadShedding (std::size_t maxQueuedEvents, std::chrono::microseconds maxWriteLatency);
+
+			// Recomputes the thresholds (p.e. when a call site override changes)
 			void setEffectiveLevel ();
 
+			// Discards the next events (see shutdown)
+			void close ();
+
+			// Keeps a copy of the stack in a preallocated recorder (see the crash handler)
+			void enableRecorder ();
+
+			// The same, but in a memory mapped file wich survives the process. Replaces the memory one
+			bool enableRecorder (const std::string &filePath);
+
+			// The current configuration. The reader keeps it alive: a replaced one is freed by its last reader
+			// Not in the fast path: the producers wich discard the event only read the levels
+			std::shared_ptr<const ConfigSnapshot> getConfig () const;
+
+			// The levels of the current configuration: one relaxed load
+			LevelThresholds getLevels () const
+			{
+				return this->levels.load (std::memory_order_relaxed);
+			}
+
+			// Fast path: may the event be logged? (it doesn't check the call site is enabled)
+			bool isLoggable (LogLevel logLevel, const CallSite *site)
+			{
+				LevelThresholds levels = this->getLevels();
+				if (logLevel < levels.effective)
+				{
+					return false;
+				}
+				if (logLevel < this->shedLevel.load (std::memory_order_relaxed))
+				{
+					this->countShed (logLevel, site);
+					return false;
+				}
+				return logLevel >= levels.base || this->isOverridden (logLevel, site);
+			}
+
 		protected:
-			virtual void cleanExcedentEvents () = 0;
+			// Slow path: only when there are overrides
+			bool isOverridden (LogLevel logLevel, const CallSite *site);
 
-		public:    // properties
-			LogColor levelColors [6];
+			// Slow path: only while shedding. And, from time to time, pollOverload
+			void countShed (LogLevel logLevel, const CallSite *site);
 
-			LogLevel consoleLevel;
-			LogLevel fileLevel;
-			LogLevel stackLevel;
-			LogLevel subscriberLevel;
-			LogLevel effectiveLevel;
+			// Overload: the events below it are discarded (TRACE: none)
+			// Not in the configuration: it changes each interval while the sinks are behind
+			std::atomic<LogLevel> shedLevel {LogLevel::TRACE};
 
-			// In the current implementation, the Timed Events are, while running, in the stack
-			// That means that it can have more than maxStoredEvents events
-			// And that the stack may contain lower level events than the stackLevel
-			// There is no unlimited stack: 0 means no stack
-			// YAGNI: Consider extract the timed events to a aditional list
-			unsigned int maxStoredEvents;
+			// Checks the sinks, if it's the time (see StackLogger::checkOverload)
+			virtual void pollOverload () = 0;
+
+			// The shed events of each level (only the ones below WARN are shed), and when the sinks must be checked
+			std::atomic<std::uint64_t> shedCounts [static_cast<int> (LogLevel::WARN)] {};
+			std::atomic<std::int64_t> nextOverloadCheck {0};    // system_clock ns
+
+			// Copy on write: copies the current configuration, applies the change and publishes it
+			template <typename Change> void updateConfig (Change &&change)
+			{
+				std::lock_guard<std::mutex> lock (this->configMtx);
+				auto next = std::make_shared<ConfigSnapshot> (*this->getConfig());
+				change (*next);
+				this->publishConfig (std::move (next));
+			}
+
+			std::mutex configMtx;    // Only for the writers
+
+		private:
+			void publishConfig (std::shared_ptr<const ConfigSnapshot> next);
+
+			// Each reader holds a reference: the old ones (and its sinks and recorder) are freed when the last
+			// reader drops them. A lock, not std::atomic<std::shared_ptr> (see LogSink::formatter)
+			mutable std::mutex snapshotMtx;
+			std::shared_ptr<const ConfigSnapshot> config;
+			std::atomic<LevelThresholds> levels {LevelThresholds {LogLevel::OFF, LogLevel::OFF}};
+
+		public:    // properties
+			// Empty for the default logger
+			const std::string channelName;
+
+			// Channel (module) override
+			std::atomic<LogLevel> levelOverride {LogLevel::OFF};
+			std::atomic<std::int64_t> overrideExpiry {0};    // steady_clock ns, 0 means never
 
-			std::chrono::year_month_day lastLogDate;
-			std::string logPath;
-			std::string logFilename;
-			std::string logFilePattern;
-			bool hasRotation;
+			// The standard sinks: they are never removed. Their settings are atomic or locked by themselves
+			std::shared_ptr<ConsoleSink> consoleSink;
+			std::shared_ptr<FileSink> fileSink;
+			std::shared_ptr<SubscriberSink> subscriberSink;
 	};
 }    // namespace IgnacioPomar::Util::StreamLogger
 
@@ -0,0 +1,335 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+
+#ifdef __linux__
+#	include <sched.h>
+#endif
+
+#include "StackLogger.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	// Round robin of the threads between the shards (ShardAffinity::THREAD)
+	static std::atomic<unsigned int> nextThreadShard {0};
+
+	StackLoggerSharded::StackLoggerSharded (const std::string &channelName, unsigned int shardCount,
+	                                        ShardAffinity affinity)
+	    : StackLoggerMTSafe (channelName)
+	    , shardCount ((shardCount > 0) ? shardCount : 1)
+	    , affinity (affinity)
+	    , shards (std::make_unique<Shard []> (this->shardCount))
+	{
+		// The cores are numbered by node: contiguous groups are usually in the same node
+		unsigned int cores  = std::max (std::thread::hardware_concurrency(), 1u);
+		this->coresPerShard = std::max ((cores + this->shardCount - 1) / this->shardCount, 1u);
+
+		this->consumer = std::thread (&StackLoggerSharded::consumerLoop, this);
+	}
+
+	StackLoggerSharded::~StackLoggerSharded()
+	{
+		{
+			std::lock_guard<std::mutex> lock (this->consumerMtx);
+			this->stopping = true;
+		}
+		this->consumerCv.notify_one();
+		if (this->consumer.joinable())
+		{
+			this->consumer.join();
+		}
+
+		// The last ones: no producer is left
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+	}
+
+	StackLoggerSharded::Shard &StackLoggerSharded::getShard()
+	{
+#ifdef __linux__
+		if (this->affinity == ShardAffinity::CPU)
+		{
+			int cpu = sched_getcpu();
+			if (cpu >= 0)
+			{
+				return this->shards [(static_cast<unsigned int> (cpu) / this->coresPerShard) % this->shardCount];
+			}
+		}
+#endif
+		thread_local unsigned int threadShard = nextThreadShard.fetch_add (1, std::memory_order_relaxed);
+		return this->shards [threadShard % this->shardCount];
+	}
+
+	void StackLoggerSharded::enqueue (EventContainer &&event)
+	{
+		Shard &shard = this->getShard();
+		bool wasEmpty;
+		bool full;
+		{
+			std::lock_guard<std::mutex> lock (shard.mtx);
+			wasEmpty = shard.pending.empty();
+
+			// Inside the shard lock: the merge knows that the lower sequences of the shard are already in it
+			std::uint64_t sequence = this->nextSequence.fetch_add (1, std::memory_order_relaxed);
+			shard.pending.push_back ({sequence, std::move (event)});
+			full = shard.pending.size() >= DEFAULTS::SHARD_EVENTS;
+		}
+
+		if (full)
+		{
+			// The consumer is behind: this producer helps (and waits for it), so the memory doesn't grow
+			std::lock_guard<std::mutex> lock (this->mtx);
+			this->mergeShards();
+		}
+		else if (wasEmpty && this->consumerIdle.load())
+		{
+			this->wakeConsumer();
+		}
+	}
+
+	void StackLoggerSharded::wakeConsumer()
+	{
+		if (this->consumerIdle.exchange (false))
+		{
+			std::lock_guard<std::mutex> lock (this->consumerMtx);
+			this->consumerCv.notify_one();
+		}
+	}
+
+	void StackLoggerSharded::consumerLoop()
+	{
+		std::unique_lock<std::mutex> consumerLock (this->consumerMtx);
+		while (!this->stopping)
+		{
+			if (this->consumerIdle.load())
+			{
+				this->consumerCv.wait (consumerLock, [this] { return this->stopping || !this->consumerIdle.load(); });
+			}
+			else
+			{
+				// Active: the events of this interval are merged together
+				this->consumerCv.wait_for (consumerLock, DEFAULTS::SHARD_INTERVAL, [this] { return this->stopping; });
+			}
+			if (this->stopping)
+			{
+				break;
+			}
+			consumerLock.unlock();
+
+			{
+				std::lock_guard<std::mutex> lock (this->mtx);
+				if (this->mergeShards() == 0 && this->carried.empty())
+				{
+					// Nothing: idle. Checked once more, as a producer may have seen it active just before
+					this->consumerIdle.store (true);
+					if (this->mergeShards() > 0 || !this->carried.empty())
+					{
+						this->consumerIdle.store (false);
+					}
+				}
+			}
+
+			consumerLock.lock();
+		}
+	}
+
+	std::size_t StackLoggerSharded::mergeShards()
+	{
+		// Every event below it is already in its shard (see enqueue): the later ones wait for the next merge
+		std::uint64_t limit = this->nextSequence.load (std::memory_order_acquire);
+
+		this->merging.swap (this->carried);
+		for (unsigned int i = 0; i < this->shardCount; i++)
+		{
+			Shard &shard = this->shards [i];
+			std::lock_guard<std::mutex> lock (shard.mtx);
+			if (shard.pending.empty())
+			{
+				continue;
+			}
+			if (this->merging.empty())
+			{
+				this->merging.swap (shard.pending);
+				continue;
+			}
+			std::move (shard.pending.begin(), shard.pending.end(), std::back_inserter (this->merging));
+			shard.pending.clear();
+		}
+
+		// The events are not moved to sort them: only its indexes
+		this->mergeOrder.resize (this->merging.size());
+		for (std::uint32_t i = 0; i < this->mergeOrder.size(); i++)
+		{
+			this->mergeOrder [i] = i;
+		}
+		std::sort (this->mergeOrder.begin(), this->mergeOrder.end(), [this] (std::uint32_t a, std::uint32_t b) {
+			return this->merging [a].sequence < this->merging [b].sequence;
+		});
+
+		std::size_t stored = 0;
+		for (std::uint32_t i : this->mergeOrder)
+		{
+			PendingEvent &pending = this->merging [i];
+			if (pending.sequence >= limit)
+			{
+				this->carried.push_back (std::move (pending));
+			}
+			else
+			{
+				this->storeEvent (pending.event);
+				stored++;
+			}
+		}
+		this->merging.clear();
+		return stored;
+	}
+
+	void StackLoggerSharded::log (LogLevel logLevel, std::string &event, LogFields &fields, const CallSite *site)
+	{
+		if (!this->isLoggable (logLevel, site))
+		{
+			this->bufferEvent (logLevel, event, fields, site);
+			return;
+		}
+		checkBufferFlush (logLevel);
+
+		EventContainer newEvent (logLevel);
+		this->prepareEvent (newEvent, event, fields, site, nullptr);
+		this->enqueue (std::move (newEvent));
+	}
+
+	void StackLoggerSharded::log (LogLevel logLevel, DeferredTextPtr text, LogFields &fields, const CallSite *site)
+	{
+		std::string noText;
+		if (!this->isLoggable (logLevel, site))
+		{
+			this->bufferEvent (logLevel, noText, fields, site, std::move (text));
+			return;
+		}
+		checkBufferFlush (logLevel);
+
+		EventContainer newEvent (logLevel);
+		this->prepareEvent (newEvent, noText, fields, site, std::move (text));
+		this->enqueue (std::move (newEvent));
+	}
+
+	void StackLoggerSharded::sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::sendEvents (receiver, logLevel);
+	}
+
+	void StackLoggerSharded::sendEvents (LogEventsSubscriber &receiver, LogLevel logLevel, std::string_view fieldKey,
+	                                     std::string_view fieldValue)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::sendEvents (receiver, logLevel, fieldKey, fieldValue);
+	}
+
+	void StackLoggerSharded::removeSink (const std::shared_ptr<LogSink> &sink)
+	{
+		// The events logged before the removal still go to it
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::removeSink (sink);
+	}
+
+	bool StackLoggerSharded::openFlightRecorder (const std::string &filePath)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		return StackLogger::openFlightRecorder (filePath);
+	}
+
+	EventContainer &StackLoggerSharded::emplaceTimedEvent (LogLevel logLevel, std::uint32_t callSiteId)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		return StackLogger::emplaceTimedEvent (logLevel, callSiteId);
+	}
+
+	void StackLoggerSharded::startTimedEvent (EventContainer &event, std::string &message, LogFields &fields,
+	                                          DeferredTextPtr deferred)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::startTimedEvent (event, message, fields, std::move (deferred));
+	}
+
+	void StackLoggerSharded::finishTimedEvent (EventContainer &event)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::finishTimedEvent (event);
+	}
+
+	void StackLoggerSharded::logBufferedEvent (EventContainer &event)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		StackLogger::logBufferedEvent (event);
+	}
+
+	bool StackLoggerSharded::drain (std::chrono::steady_clock::time_point deadline)
+	{
+		std::lock_guard<std::mutex> lock (this->mtx);
+		this->mergeShards();
+		if (!this->carried.empty())
+		{
+			// Its producers have already added them: the second merge takes them
+			this->mergeShards();
+		}
+		return StackLogger::drain (deadline);
+	}
+
+	void StackLoggerSharded::prepareFork()
+	{
+		// The consumer is out of the merge when the producers lock is taken: it waits in its own lock
+		StackLoggerMTSafe::prepareFork();
+		this->consumerMtx.lock();
+		for (unsigned int i = 0; i < this->shardCount; i++)
+		{
+			this->shards [i].mtx.lock();
+		}
+	}
+
+	void StackLoggerSharded::afterFork (bool child)
+	{
+		if (child)
+		{
+			// The events of the parent were already merged there, or are still pending there: not in the child
+			for (unsigned int i = 0; i < this->shardCount; i++)
+			{
+				this->shards [i].pending.clear();
+			}
+			this->carried.clear();
+			this->merging.clear();
+			this->consumerIdle.store (true);
+
+			// The consumer doesn't exist in the child: its waiters, neither
+			new (&this->consumerCv) std::condition_variable();
+			new (&this->consumer) std::thread();
+		}
+
+		for (unsigned int i = 0; i < this->shardCount; i++)
+		{
+			this->shards [i].mtx.unlock();
+		}
+		this->consumerMtx.unlock();
+		StackLoggerMTSafe::afterFork (child);
+
+		if (child && !this->stopping)
+		{
+			this->consumer = std::thread (&StackLoggerSharded::consumerLoop, this);
+		}
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
@@ -4,6 +4,19 @@
  *	Copyright	(C) 2024  Ignacio Pomar Ballestero
  ********************************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#	include <pthread.h>
+#endif
+
 #include "StreamLoggerConsts.h"
 #include "StackLogger.h"
 #include "StreamLogger.h"
@@ -12,28 +25,261 @@ namespace IgnacioPomar::Util::StreamLogger
 {
 
 	//--------------  Static values: Configuration Vars ----------------
+	// All of them constant initialized: they can be used from the static initializers of any unit (before main)
+
+	constinit std::atomic<bool> gMultiThreadSafe {false};
+	constinit std::atomic<bool> isLoggerInitialized {false};
 
-	bool gMultiThreadSafe    = false;
-	bool isLoggerInitialized = false;
+	// Sharded backends (only the multi-thread safe ones): for the backends created after setting it
+	constinit std::atomic<unsigned int> gShardCount {0};
+	constinit std::atomic<ShardAffinity> gShardAffinity {ShardAffinity::THREAD};
 
-	StackLogger &initSTDLogger ()
+	// The default logger: created on its first use, with the thread safety set then
+	static constinit std::atomic<StackLogger *> defaultLogger {nullptr};
+	static constinit std::mutex defaultLoggerMtx;
+
+	static std::unique_ptr<StackLogger> createMTSafeLogger (const std::string &channelName)
 	{
-		static StackLogger logger;
-		isLoggerInitialized = true;
-		return logger;
-	};
+		unsigned int shardCount = gShardCount;
+		if (shardCount > 1)
+		{
+			return std::make_unique<StackLoggerSharded> (channelName, shardCount, gShardAffinity);
+		}
+		return std::make_unique<StackLoggerMTSafe> (channelName);
+	}
+
+	// After shutdown(): the backends created later discard its events too
+	static constinit std::atomic<bool> gShutdown {false};
 
-	StackLogger &initMTSafeLogger ()
+	static void registerLifecycleHandlers ();
+
+	static StackLogger &createDefaultLogger ()
 	{
-		static StackLoggerMTSafe loggerMTSafe;
-		isLoggerInitialized = true;
-		return loggerMTSafe;
-	};
+		registerLifecycleHandlers();
+
+		std::lock_guard<std::mutex> lock (defaultLoggerMtx);
+		StackLogger *logger = defaultLogger.load (std::memory_order_relaxed);
+		if (logger == nullptr)
+		{
+			// Never destroyed: other threads may be logging while the process exits (see shutdown)
+			logger = gMultiThreadSafe ? createMTSafeLogger ("").release() : new StackLogger ("");
+			if (gShutdown)
+			{
+				logger->close();
+			}
+			isLoggerInitialized = true;
+			defaultLogger.store (logger, std::memory_order_release);
+		}
+		return *logger;
+	}
 
 	StackLogger &getLogger ()
 	{
-		static StackLogger &logger = (gMultiThreadSafe) ? initMTSafeLogger() : initSTDLogger();
-		return logger;
+		// Once created, a single load: no guard of a function static
+		StackLogger *logger = defaultLogger.load (std::memory_order_acquire);
+		return (logger != nullptr) ? *logger : createDefaultLogger();
+	}
+
+	//--------------  Channels ----------------
+
+	struct ChannelRegistry
+	{
+			std::mutex mtx;
+			std::map<std::string, std::unique_ptr<StackLogger>> channels;
+	};
+
+	static ChannelRegistry &getChannels()
+	{
+		// Never destroyed, as the default logger
+		static ChannelRegistry *registry = new ChannelRegistry;
+		return *registry;
+	}
+
+	StackLogger &getChannelLogger (const std::string &channelName)
+	{
+		if (channelName.empty())
+		{
+			return getLogger();
+		}
+
+		// Only used when a Channel is built: the handles keep the reference, so this is not in the hot path
+		registerLifecycleHandlers();
+		ChannelRegistry &registry = getChannels();
+		auto &channels            = registry.channels;
+
+		std::lock_guard<std::mutex> lock (registry.mtx);
+
+		auto it = channels.find (channelName);
+		if (it == channels.end())
+		{
+			std::unique_ptr<StackLogger> channel;
+			if (gMultiThreadSafe)
+			{
+				channel = createMTSafeLogger (channelName);
+			}
+			else
+			{
+				channel = std::make_unique<StackLogger> (channelName);
+			}
+			if (gShutdown)
+			{
+				channel->close();
+			}
+			isLoggerInitialized = true;
+
+			it = channels.emplace (channelName, std::move (channel)).first;
+		}
+
+		return *it->second;
+	}
+
+	void refreshLoggersLevels()
+	{
+		// The ones not created yet will get the levels in its constructor
+		StackLogger *logger = defaultLogger.load (std::memory_order_acquire);
+		if (logger != nullptr)
+		{
+			logger->setEffectiveLevel();
+		}
+
+		forEachChannelLogger ([] (StackLogger &channel) { channel.setEffectiveLevel(); });
+	}
+
+	void forEachChannelLogger (const std::function<void (StackLogger &)> &action)
+	{
+		ChannelRegistry &registry = getChannels();
+		std::lock_guard<std::mutex> lock (registry.mtx);
+		for (auto &channel : registry.channels)
+		{
+			action (*channel.second);
+		}
+	}
+
+	//--------------  Lifecycle: exit and fork ----------------
+
+	// The backends created so far. With the registry locked
+	static void collectBackends (std::vector<StackLogger *> &backends)
+	{
+		StackLogger *logger = defaultLogger.load (std::memory_order_acquire);
+		if (logger != nullptr)
+		{
+			backends.push_back (logger);
+		}
+		for (auto &channel : getChannels().channels)
+		{
+			backends.push_back (channel.second.get());
+		}
+	}
+
+	bool shutdown (std::chrono::milliseconds timeout)
+	{
+		std::vector<StackLogger *> backends;
+		{
+			ChannelRegistry &registry = getChannels();
+			std::lock_guard<std::mutex> lock (registry.mtx);
+			std::lock_guard<std::mutex> defaultLock (defaultLoggerMtx);
+			gShutdown = true;
+			collectBackends (backends);
+		}
+
+		// First all of them are closed: the events logged to one channel while other is draining are not lost
+		for (StackLogger *backend : backends)
+		{
+			backend->close();
+		}
+
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		bool drained  = true;
+		for (StackLogger *backend : backends)
+		{
+			drained = backend->drain (deadline) && drained;
+		}
+		return drained;
+	}
+
+	static void shutdownAtExit ()
+	{
+		shutdown (DEFAULTS::SHUTDOWN_TIMEOUT);
+	}
+
+#ifndef _WIN32
+	// Locked by the parent before the fork, in this order, and unlocked in reverse order by both processes
+	static std::vector<StackLogger *> forkBackends;
+	static std::vector<LogSink *> forkSinks;
+
+	static void prepareFork ()
+	{
+		getChannels().mtx.lock();
+		defaultLoggerMtx.lock();
+
+		// The backends first: they take the locks of the sinks while they send an event
+		collectBackends (forkBackends);
+		for (StackLogger *backend : forkBackends)
+		{
+			backend->prepareFork();
+		}
+
+		// A sink may be in several backends: locked once
+		for (StackLogger *backend : forkBackends)
+		{
+			auto config = backend->getConfig();
+			for (auto &sink : config->sinks)
+			{
+				if (std::find (forkSinks.begin(), forkSinks.end(), sink.get()) == forkSinks.end())
+				{
+					forkSinks.push_back (sink.get());
+				}
+			}
+		}
+		for (LogSink *sink : forkSinks)
+		{
+			sink->prepareFork();
+		}
+
+		// The last one: a registration may be in progress while the backends and the sinks write (the formatters
+		// read the sites without it)
+		lockCallSiteRegistry();
+	}
+
+	static void afterFork (bool child)
+	{
+		unlockCallSiteRegistry();
+		for (auto it = forkSinks.rbegin(); it != forkSinks.rend(); ++it)
+		{
+			(*it)->afterFork (child);
+		}
+		for (auto it = forkBackends.rbegin(); it != forkBackends.rend(); ++it)
+		{
+			(*it)->afterFork (child);
+		}
+		forkSinks.clear();
+		forkBackends.clear();
+
+		defaultLoggerMtx.unlock();
+		getChannels().mtx.unlock();
+	}
+
+	static void afterForkParent ()
+	{
+		afterFork (false);
+	}
+
+	static void afterForkChild ()
+	{
+		afterFork (true);
+	}
+#endif
+
+	static void registerLifecycleHandlers ()
+	{
+		static constinit std::once_flag registered;
+		std::call_once (registered, [] {
+			// Registered before the first backend: the atexit ones run after the static objects built later
+			std::atexit (shutdownAtExit);
+#ifndef _WIN32
+			pthread_atfork (prepareFork, afterForkParent, afterForkChild);
+#endif
+		});
 	}
 
 }    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,517 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#if __has_include(<format>)
+#	include <format>
+#endif
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <filesystem>
+
+#include "StreamLoggerConsts.h"
+#include "StreamLoggerSinks.h"
+
+#include "LoggerConsoleUtils.h"
+#include "LogIndexWriter.h"
+#include "CrashHandler.h"
+#include "RawIO.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	namespace fs = std::filesystem;
+
+	//-------------- ConsoleSink ----------------
+
+	ConsoleSink::ConsoleSink (LogLevel level, SinkMode mode)
+	    : LogSink (level, mode)
+	{
+		this->levelColors [0] = DEFAULTS::COLOR_TRACE;
+		this->levelColors [1] = DEFAULTS::COLOR_DEBUG;
+		this->levelColors [2] = DEFAULTS::COLOR_INFO;
+		this->levelColors [3] = DEFAULTS::COLOR_WARN;
+		this->levelColors [4] = DEFAULTS::COLOR_ERROR;
+		this->levelColors [5] = DEFAULTS::COLOR_FATAL;
+	}
+
+	ConsoleSink::~ConsoleSink()
+	{
+		this->stopWorker();
+	}
+
+	void ConsoleSink::setLevelColor (LogLevel logLevel, LogColor logColor)
+	{
+		int lvl = static_cast<int> (logLevel);
+		if (lvl <= 5)
+		{
+			this->levelColors [lvl].store (logColor, std::memory_order_relaxed);
+		}
+	}
+
+	void ConsoleSink::write (const EventContainer &event)
+	{
+		int lvl = static_cast<int> (event.logLevel);
+		if (lvl > 5)
+		{
+			lvl = static_cast<int> (LogLevel::FATAL);
+		}
+
+		// The whole line in a buffer, between the color codes (on POSIX): then a single write
+		LogColor color = this->levelColors [lvl].load (std::memory_order_relaxed);
+		auto formatter = this->getFormatter();
+		std::string line (getColorCode (color));
+		if (const TextRope *rope = getRope (*formatter, event))
+		{
+			std::string suffix;
+			formatter->formatAround (event, line, suffix);
+			line.reserve (line.size() + rope->size() + suffix.size() + 16);
+			for (auto &chunk : rope->getChunks())
+			{
+				line += *chunk;
+			}
+			line += suffix;
+		}
+		else
+		{
+			formatEvent (*formatter, event, line);
+		}
+		line += getResetCode();
+		line += '\n';
+
+		writeConsoleLine (color, line);
+	}
+
+	bool ConsoleSink::writesRopes() const
+	{
+		return this->getFormatter()->writesTextAsIs();
+	}
+
+	//-------------- FileSink ----------------
+
+	FileSink::FileSink (LogLevel level, const std::string &filePattern, SinkMode mode)
+	    : LogSink (level, mode)
+	    , lastLogDate {}
+	    , logPath ("")
+	    , logFilePattern (filePattern)
+	    , hasRotation (true)
+	{
+		this->buffer = std::make_unique<char []> (DEFAULTS::FILE_BUFFER_SIZE);
+		registerCrashFileSink (this);
+	}
+
+	FileSink::~FileSink()
+	{
+		unregisterCrashFileSink (this);
+		this->stopWorker();
+
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->closeFile();
+	}
+
+	void FileSink::setOutFile (const std::string &fileName)
+	{
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->logFilePattern = fileName;
+
+		// Force "reset" the file, and rotation config
+		this->hasRotation = true;
+		this->lastLogDate = std::chrono::year_month_day {};
+		this->closeFile();
+	}
+
+	void FileSink::setOutPath (const std::string &filePath)
+	{
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->logPath = filePath;
+		this->closeFile();
+	}
+
+	void FileSink::setIndexInterval (std::uint32_t eventsPerEntry)
+	{
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->indexInterval = eventsPerEntry;
+
+		// Opened again (with or without index) on the next event
+		this->closeFile();
+	}
+
+	void FileSink::checkRotation (const EventContainer &event)
+	{
+		if (!hasRotation)
+		{
+			return;
+		}
+
+		auto dp  = floor<std::chrono::days> (event.timePoint);
+		auto ymd = std::chrono::year_month_day {dp};
+
+		if (ymd == lastLogDate)
+		{
+			return;
+		}
+
+		lastLogDate = ymd;
+		this->closeFile();
+
+#if __has_include(<format>)
+		auto formattedDate = std::format ("{:04}-{:02}-{:02}", int (ymd.year()), unsigned (ymd.month()),
+		                                  unsigned (ymd.day()));
+#else
+		std::ostringstream oss;
+		oss << std::setw (4) << std::setfill ('0') << int (ymd.year()) << "-";
+		oss << std::setw (2) << std::setfill ('0') << unsigned (ymd.month()) << "-";
+		oss << std::setw (2) << std::setfill ('0') << unsigned (ymd.day());
+
+		std::string formattedDate = oss.str();
+#endif
+		// Work on a copy: the pattern must keep the %d for the next rotation
+		this->logFilename = logFilePattern;
+		size_t pos        = this->logFilename.find ("%d");
+		if (pos != std::string::npos)
+		{
+			this->logFilename.replace (pos, 2, formattedDate);
+		}
+		else
+		{
+			hasRotation = false;
+		}
+	}
+
+	void FileSink::openFile()
+	{
+		if (this->fd.load (std::memory_order_relaxed) >= 0)
+		{
+			return;
+		}
+
+		fs::path filePath = fs::path (logPath) / this->logFilename;
+		int newFd         = RawIO::openFile (filePath.string().c_str(), false);
+		this->fd.store (newFd, std::memory_order_release);
+		if (newFd >= 0)
+		{
+			this->fileOffset = RawIO::getSize (newFd);
+			if (this->indexInterval > 0)
+			{
+				this->index = std::make_unique<LogIndexWriter> (this->indexInterval);
+				if (!this->index->open (filePath.string()))
+				{
+					this->index.reset();
+					this->reportError ("Unable to open log index: " + filePath.string() + ".idx");
+				}
+			}
+		}
+		else
+		{
+			// Disable file logging
+			this->setLevel (LogLevel::OFF);
+
+			// The logger will generate the event: unable to open log File
+			this->reportError ("Unable to open log file: " + filePath.string());
+		}
+	}
+
+	void FileSink::closeFile()
+	{
+		this->flushBuffer();
+		if (this->index)
+		{
+			this->index->close (this->fileOffset);
+			this->index.reset();
+		}
+		int oldFd = this->fd.exchange (-1, std::memory_order_acq_rel);
+		if (oldFd >= 0)
+		{
+			RawIO::closeFile (oldFd);
+		}
+	}
+
+	void FileSink::flushBuffer()
+	{
+		std::size_t pending = this->buffered.load (std::memory_order_relaxed);
+		int currentFd       = this->fd.load (std::memory_order_relaxed);
+		if (pending > 0 && currentFd >= 0)
+		{
+			RawIO::writeAll (currentFd, this->buffer.get(), pending);
+		}
+		this->buffered.store (0, std::memory_order_release);
+	}
+
+	bool FileSink::writeLines (const EventContainer &firstEvent, const std::string &lines, std::uint64_t &offset)
+	{
+		this->checkRotation (firstEvent);
+		this->openFile();
+		if (this->fd.load (std::memory_order_relaxed) < 0)
+		{
+			return false;
+		}
+
+		offset = this->fileOffset;
+		this->fileOffset += lines.size();
+
+		std::size_t pending = this->buffered.load (std::memory_order_relaxed);
+		if (pending + lines.size() > DEFAULTS::FILE_BUFFER_SIZE)
+		{
+			this->flushBuffer();
+			pending = 0;
+		}
+
+		if (lines.size() > DEFAULTS::FILE_BUFFER_SIZE)
+		{
+			// Too big for the buffer
+			RawIO::writeAll (this->fd.load (std::memory_order_relaxed), lines.data(), lines.size());
+			return true;
+		}
+
+		std::memcpy (this->buffer.get() + pending, lines.data(), lines.size());
+		this->buffered.store (pending + lines.size(), std::memory_order_release);
+		return true;
+	}
+
+	bool FileSink::writeRope (const LogFormatter &formatter, const EventContainer &event, const TextRope &rope,
+	                          std::uint64_t &offset)
+	{
+		std::string prefix;
+		std::string suffix;
+		formatter.formatAround (event, prefix, suffix);
+		suffix += '\n';
+
+		this->checkRotation (event);
+		this->openFile();
+		int currentFd = this->fd.load (std::memory_order_relaxed);
+		if (currentFd < 0)
+		{
+			return false;
+		}
+
+		// The pending block goes first: a single write for all, and the pieces are not copied
+		std::vector<RawIO::TextPiece> pieces;
+		pieces.reserve (rope.getChunks().size() + 3);
+		std::size_t pending = this->buffered.load (std::memory_order_relaxed);
+		if (pending > 0)
+		{
+			pieces.push_back ({this->buffer.get(), pending});
+		}
+		pieces.push_back ({prefix.data(), prefix.size()});
+		for (auto &chunk : rope.getChunks())
+		{
+			pieces.push_back ({chunk->data(), chunk->size()});
+		}
+		pieces.push_back ({suffix.data(), suffix.size()});
+
+		RawIO::writeVector (currentFd, pieces.data(), pieces.size());
+		this->buffered.store (0, std::memory_order_release);
+
+		offset = this->fileOffset;
+		this->fileOffset += prefix.size() + rope.size() + suffix.size();
+		return true;
+	}
+
+	void FileSink::indexEvent (const EventContainer &event, std::uint64_t offset)
+	{
+		this->index->add (
+		    offset,
+		    std::chrono::duration_cast<std::chrono::nanoseconds> (event.timePoint.time_since_epoch()).count(),
+		    event.logLevel);
+	}
+
+	void FileSink::write (const EventContainer &event)
+	{
+		auto formatter = this->getFormatter();
+		if (const TextRope *rope = getRope (*formatter, event))
+		{
+			std::lock_guard<std::mutex> lock (this->fileMtx);
+			std::uint64_t offset;
+			if (this->writeRope (*formatter, event, *rope, offset) && this->index)
+			{
+				this->indexEvent (event, offset);
+			}
+			return;
+		}
+
+		std::string line;
+		formatEvent (*formatter, event, line);
+		line += '\n';
+
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		std::uint64_t offset;
+		if (this->writeLines (event, line, offset) && this->index)
+		{
+			this->indexEvent (event, offset);
+		}
+	}
+
+	void FileSink::writeBatch (const std::vector<EventContainer> &events)
+	{
+		if (events.empty())
+		{
+			return;
+		}
+
+		std::string lines;
+		const EventContainer *firstPending = &events.front();
+		auto formatter                     = this->getFormatter();
+
+		// Offset of each pending line inside lines (only with index)
+		std::vector<std::size_t> lineOffsets;
+
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		bool indexed = this->indexInterval > 0;
+		auto writePending = [&] (const EventContainer *next) {
+			std::uint64_t offset;
+			if (!lines.empty() && this->writeLines (*firstPending, lines, offset) && this->index)
+			{
+				for (std::size_t i = 0; i < lineOffsets.size(); i++)
+				{
+					this->indexEvent (firstPending [i], offset + lineOffsets [i]);
+				}
+			}
+			lines.clear();
+			lineOffsets.clear();
+			firstPending = next;
+		};
+
+		for (auto &event : events)
+		{
+			// The rotation may happen in the middle of the batch: the pending lines go to the previous file
+			if (hasRotation && floor<std::chrono::days> (event.timePoint)
+			                       != floor<std::chrono::days> (firstPending->timePoint))
+			{
+				writePending (&event);
+			}
+			if (const TextRope *rope = getRope (*formatter, event))
+			{
+				// After the pending lines, by itself
+				writePending (&event);
+				std::uint64_t offset;
+				if (this->writeRope (*formatter, event, *rope, offset) && this->index)
+				{
+					this->indexEvent (event, offset);
+				}
+				firstPending = &event + 1;
+				continue;
+			}
+			if (indexed)
+			{
+				lineOffsets.push_back (lines.size());
+			}
+			formatEvent (*formatter, event, lines);
+			lines += '\n';
+		}
+
+		writePending (nullptr);
+	}
+
+	bool FileSink::writesRopes() const
+	{
+		return this->getFormatter()->writesTextAsIs();
+	}
+
+	void FileSink::flush()
+	{
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->flushBuffer();
+	}
+
+	void FileSink::onShutdown()
+	{
+		// Closed (the buffer and the index written): a later event opens it again
+		std::lock_guard<std::mutex> lock (this->fileMtx);
+		this->closeFile();
+	}
+
+	void FileSink::prepareFork()
+	{
+		LogSink::prepareFork();
+		this->fileMtx.lock();
+	}
+
+	void FileSink::afterFork (bool child)
+	{
+		if (child)
+		{
+			// The pending block is the parent's, and so the file description: the child opens the file on its next
+			// write. Without index: the offsets of a file written by both would be wrong
+			this->buffered.store (0, std::memory_order_relaxed);
+			this->indexInterval = 0;
+			this->index.reset();
+			int oldFd = this->fd.exchange (-1, std::memory_order_acq_rel);
+			if (oldFd >= 0)
+			{
+				RawIO::closeFile (oldFd);
+			}
+		}
+		this->fileMtx.unlock();
+		LogSink::afterFork (child);
+	}
+
+	void FileSink::flushOnCrash()
+	{
+		std::size_t pending = this->buffered.load (std::memory_order_acquire);
+		int currentFd       = this->fd.load (std::memory_order_acquire);
+		if (pending > 0 && currentFd >= 0)
+		{
+			RawIO::writeAll (currentFd, this->buffer.get(), pending);
+			this->buffered.store (0, std::memory_order_relaxed);
+		}
+	}
+
+	//-------------- SubscriberSink ----------------
+
+	SubscriberSink::EventSubscriber::EventSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	    : subscriber (subscriber)
+	    , logLevel (logLevel)
+	{
+	}
+
+	SubscriberSink::SubscriberSink (SinkMode mode)
+	    : LogSink (LogLevel::OFF, mode)
+	{
+	}
+
+	SubscriberSink::~SubscriberSink()
+	{
+		this->stopWorker();
+	}
+
+	void SubscriberSink::addSubscriber (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		std::lock_guard<std::mutex> lock (this->subscribersMtx);
+		this->subscribers.emplace_back (subscriber, logLevel);
+		if (logLevel < this->getLevel())
+		{
+			this->setLevel (logLevel);
+		}
+	}
+
+	void SubscriberSink::prepareFork()
+	{
+		LogSink::prepareFork();
+		this->subscribersMtx.lock();
+	}
+
+	void SubscriberSink::afterFork (bool child)
+	{
+		this->subscribersMtx.unlock();
+		LogSink::afterFork (child);
+	}
+
+	void SubscriberSink::write (const EventContainer &event)
+	{
+		// YAGNI: consider a thread for each subscriber
+		// We would need a thread pool?
+		std::lock_guard<std::mutex> lock (this->subscribersMtx);
+		for (auto &subscriber : subscribers)
+		{
+			if (event.logLevel >= subscriber.logLevel)
+			{
+				subscriber.subscriber.onLogRecord (event);
+			}
+		}
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
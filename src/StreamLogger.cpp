@@ -13,58 +13,240 @@
 
 namespace IgnacioPomar::Util::StreamLogger
 {
+	//-------------- Log context ----------------
+	thread_local LogContextPtr currentLogContext;
+
+	const LogContextPtr &getLogContext()
+	{
+		return currentLogContext;
+	}
+
+	LogContextPtr setLogContext (LogContextPtr context)
+	{
+		currentLogContext.swap (context);
+		return context;
+	}
 
 	//-------------- StaticLogger ----------------
-	StaticLogger::StaticLogger (LogLevel level)
-	    : level (level)
+	StackLogger &StaticLogger::getBackend()
 	{
+		return (backend != nullptr) ? *backend : getLogger();
 	}
 
 	void StaticLogger::log (std::string &message)
 	{
-		getLogger().log (level, message);
+		getBackend().log (level, message);
+	}
+
+	void StaticLogger::log (std::string &message, LogFields &fields, const CallSite *site)
+	{
+		getBackend().log (level, message, fields, site);
+	}
+
+	void StaticLogger::log (DeferredTextPtr text, LogFields &fields, const CallSite *site)
+	{
+		getBackend().log (level, std::move (text), fields, site);
+	}
+
+	bool StaticLogger::isLoggable (const CallSite &site)
+	{
+		if (getBackend().isLoggable (level, &site))
+		{
+			return true;
+		}
+
+		// Below the levels, but a scoped buffer may keep it
+		ScopedLogBuffer *buffer = ScopedLogBuffer::getCurrent();
+		return buffer != nullptr && level >= buffer->captureLevel;
 	}
 
-	TimedEvent StaticLogger::startTimedEvent()
+	bool StaticLogger::isLevelEnabled()
 	{
+		// The effective level is already lowered to the lowest override
+		if (level >= getBackend().getLevels().effective)
+		{
+			return true;
+		}
+
+		ScopedLogBuffer *buffer = ScopedLogBuffer::getCurrent();
+		return buffer != nullptr && level >= buffer->captureLevel;
+	}
+
+	TimedEvent StaticLogger::startTimedEvent (const std::source_location &location)
+	{
+		CallSite &site = resolveCallSite (location);
+		site.count.fetch_add (1, std::memory_order_relaxed);
+
 		// Add new event in the stack logger (without the fill)
-		return TimedEvent (getLogger().emplaceEvent (level));
+		StackLogger &logger = getBackend();
+		return TimedEvent (logger.emplaceTimedEvent (level, site.id), logger);
 	}
 
-	//-------------- StaticLogger ----------------
+	//-------------- TimedEvent ----------------
 
 	TimedEvent::~TimedEvent()
 	{
 		// The event has finised, we mark as finished, and reprocess it
-		StackLogger &logger = getLogger();
-		logger.fillElapsedTime (event);
-		logger.processEvent (event);
+		logger.finishTimedEvent (event);
 
 		// YAGNI: If event inder the stackLevel, we should remove it from the stack
 	}
 
-	TimedEvent::TimedEvent (EventContainer &event)
+	TimedEvent::TimedEvent (EventContainer &event, StackLogger &logger)
 	    : event (event)
+	    , logger (logger)
 	{
-		event.eventType = EVENT_TYPE_TIMED_RUNNING;
 	}
 
 	void TimedEvent::log (std::string &message)
+	{
+		LogFields noFields;
+		this->log (message, noFields, nullptr);
+	}
+
+	// The call site is the startTimedEvent one
+	void TimedEvent::log (std::string &message, LogFields &fields, const CallSite *)
 	{
 		if (this->started)
 		{
 			// Call the log a second time means a second line of descriptions.
 			// we simply add the message to the event
-			event.event += message;
+			logger.appendTimedEvent (event, message, fields, nullptr);
 		}
 		else
 		{
 			// In timed Events, log is in fact a "Start" event
-			StackLogger &logger = getLogger();
-			logger.fillEvent (event, message);
-			logger.processEvent (event);
+			logger.startTimedEvent (event, message, fields, nullptr);
+			this->started = true;
+		}
+	}
+
+	void TimedEvent::log (DeferredTextPtr text, LogFields &fields, const CallSite *)
+	{
+		std::string noText;
+		if (this->started)
+		{
+			logger.appendTimedEvent (event, noText, fields, std::move (text));
+		}
+		else
+		{
+			logger.startTimedEvent (event, noText, fields, std::move (text));
 			this->started = true;
 		}
 	}
 
+	//-------------- Channel ----------------
+
+	Channel::Channel (const std::string &channelName)
+	    : backend (getChannelLogger (channelName))
+	    , trace (LogLevel::TRACE, backend)
+	    , debug (LogLevel::DEBUG, backend)
+	    , info (LogLevel::INFO, backend)
+	    , warn (LogLevel::WARN, backend)
+	    , error (LogLevel::ERROR, backend)
+	    , fatal (LogLevel::FATAL, backend)
+	{
+	}
+
+	const std::string &Channel::getName() const
+	{
+		return backend.channelName;
+	}
+
+	void Channel::setStackSize (unsigned int stackSize)
+	{
+		backend.setStackSize (stackSize);
+	}
+
+	void Channel::setOutFile (const std::string fileName)
+	{
+		backend.setOutFile (fileName);
+	}
+
+	void Channel::setOutPath (const std::string filePath)
+	{
+		backend.setOutPath (filePath);
+	}
+
+	void Channel::setLevelColor (LogLevel logLevel, LogColor logColor)
+	{
+		backend.setLevelColor (logLevel, logColor);
+	}
+
+	void Channel::setConsoleLevel (LogLevel logLevel)
+	{
+		backend.setConsoleLevel (logLevel);
+	}
+
+	void Channel::setFileLevel (LogLevel logLevel)
+	{
+		backend.setFileLevel (logLevel);
+	}
+
+	void Channel::setStackLevel (LogLevel logLevel)
+	{
+		backend.setStackLevel (logLevel);
+	}
+
+	void Channel::setLevelOverride (LogLevel logLevel, std::chrono::seconds duration)
+	{
+		backend.setLevelOverride (logLevel, duration);
+	}
+
+	void Channel::setConsoleFormatter (std::shared_ptr<const LogFormatter> formatter)
+	{
+		backend.setConsoleFormatter (std::move (formatter));
+	}
+
+	void Channel::setFileFormatter (std::shared_ptr<const LogFormatter> formatter)
+	{
+		backend.setFileFormatter (std::move (formatter));
+	}
+
+	void Channel::setFileIndex (std::uint32_t eventsPerEntry)
+	{
+		backend.setFileIndex (eventsPerEntry);
+	}
+
+	void Channel::setOverloadShedding (std::size_t maxQueuedEvents, std::chrono::microseconds maxWriteLatency)
+	{
+		backend.setOverloadShedding (maxQueuedEvents, maxWriteLatency);
+	}
+
+	void Channel::addSink (std::shared_ptr<LogSink> sink)
+	{
+		backend.addSink (std::move (sink));
+	}
+
+	void Channel::removeSink (const std::shared_ptr<LogSink> &sink)
+	{
+		backend.removeSink (sink);
+	}
+
+	bool Channel::setFlightRecorder (const std::string &filePath)
+	{
+		return backend.openFlightRecorder (filePath);
+	}
+
+	void Channel::pullPreviousRunEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		backend.sendPreviousRunEvents (subscriber, logLevel);
+	}
+
+	void Channel::pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		backend.sendEvents (subscriber, logLevel);
+	}
+
+	void Channel::pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel, std::string_view fieldKey,
+	                             std::string_view fieldValue)
+	{
+		backend.sendEvents (subscriber, logLevel, fieldKey, fieldValue);
+	}
+
+	void Channel::subscribePushEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		backend.subscribePushEvents (subscriber, logLevel);
+	}
+
 }    // namespace IgnacioPomar::Util::StreamLogger
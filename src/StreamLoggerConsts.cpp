@@ -10,21 +10,34 @@
 
 namespace IgnacioPomar::Util::StreamLogger
 {
-	const std::string logLevelNames [6] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+	constexpr std::string_view logLevelNames [7] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OFF"};
 
 	//--------------  Static Logger instances ----------------
 
-	StaticLogger trace (LogLevel::TRACE);
-	StaticLogger debug (LogLevel::DEBUG);
-	StaticLogger info (LogLevel::INFO);
-	StaticLogger warn (LogLevel::WARN);
-	StaticLogger error (LogLevel::ERROR);
-	StaticLogger fatal (LogLevel::FATAL);
+	// Constant initialized: usable from the static initializers of any unit (the backend is created on first use)
+	constinit StaticLogger trace (LogLevel::TRACE);
+	constinit StaticLogger debug (LogLevel::DEBUG);
+	constinit StaticLogger info (LogLevel::INFO);
+	constinit StaticLogger warn (LogLevel::WARN);
+	constinit StaticLogger error (LogLevel::ERROR);
+	constinit StaticLogger fatal (LogLevel::FATAL);
 
 	//--------------   Utility Functions ----------------
-	const std::string &getLevelName (LogLevel logLevel)
+	std::string_view getLevelName (LogLevel logLevel)
 	{
-		return logLevelNames [static_cast<int> (logLevel)];
+		// OFF (and any invalid value) is the last one
+		int lvl = static_cast<int> (logLevel);
+		return logLevelNames [(lvl <= 5) ? lvl : 6];
+	}
+
+	const std::string &getLevelNameString (LogLevel logLevel)
+	{
+		static const std::string names [7] = {
+		    std::string (logLevelNames [0]), std::string (logLevelNames [1]), std::string (logLevelNames [2]),
+		    std::string (logLevelNames [3]), std::string (logLevelNames [4]), std::string (logLevelNames [5]),
+		    std::string (logLevelNames [6])};
+		int lvl = static_cast<int> (logLevel);
+		return names [(lvl <= 5) ? lvl : 6];
 	}
 
 	//-------------- Event retransmission ----------------
@@ -34,9 +47,37 @@ namespace IgnacioPomar::Util::StreamLogger
 		getLogger().sendEvents (subscriber, logLevel);
 	}
 
+	void pullLogEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel, std::string_view fieldKey,
+	                    std::string_view fieldValue)
+	{
+		getLogger().sendEvents (subscriber, logLevel, fieldKey, fieldValue);
+	}
+
 	void subscribePushEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel)
 	{
 		getLogger().subscribePushEvents (subscriber, logLevel);
 	}
 
+	void pullPreviousRunEvents (LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		getLogger().sendPreviousRunEvents (subscriber, logLevel);
+	}
+
+	bool pullRecorderFileEvents (const std::string &filePath, LogEventsSubscriber &subscriber, const LogLevel logLevel)
+	{
+		std::list<EventContainer> events;
+		if (!StackLogger::loadRecorderFile (filePath, events))
+		{
+			return false;
+		}
+		for (auto &event : events)
+		{
+			if (event.logLevel >= logLevel)
+			{
+				subscriber.onLogRecord (event);
+			}
+		}
+		return true;
+	}
+
 }    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,210 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "StreamLoggerConsts.h"
+#include "StreamLoggerInterfaces.h"
+#include "StreamLoggerSinks.h"
+
+#include "EscapingWriter.h"
+#include "StackLogger.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	static inline std::int64_t toNs (std::chrono::system_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (duration).count();
+	}
+
+	//-------------- JsonLinesFormatter ----------------
+
+	// The fields of the context first, and then the ones of the event
+	static void appendJsonFields (std::string &out, const LogFields *contextFields, const LogFields &fields)
+	{
+		out += ",\"fields\":{";
+		bool first      = true;
+		auto appendField = [&] (const FieldView &field) {
+			if (!first)
+			{
+				out += ',';
+			}
+			first = false;
+
+			out += '"';
+			appendJsonEscaped (out, field.key);
+			out += "\":";
+			switch (field.type)
+			{
+			case FieldType::STRING:
+				out += '"';
+				appendJsonEscaped (out, field.strValue);
+				out += '"';
+				break;
+			case FieldType::DOUBLE:
+				// json has no NaN nor infinity
+				if (!std::isfinite (field.doubleValue))
+				{
+					out += "null";
+					break;
+				}
+				[[fallthrough]];
+			default: field.appendValue (out); break;
+			}
+		};
+		if (contextFields != nullptr)
+		{
+			contextFields->forEach (appendField);
+		}
+		fields.forEach (appendField);
+		out += '}';
+	}
+
+	void JsonLinesFormatter::format (const EventContainer &event, std::string &out) const
+	{
+		out += "{\"ts\":\"";
+		appendRfc3339 (out, toNs (event.timePoint.time_since_epoch()));
+		out += "\",\"level\":\"";
+		out += getLevelName (event.logLevel);
+		out += "\",\"msg\":\"";
+		appendJsonEscaped (out, event.event);
+		out += '"';
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			out += ",\"duration_ns\":";
+			appendInteger (out, toNs (event.endTimePoint - event.timePoint));
+		}
+
+		if (event.sampleRate > 1)
+		{
+			out += ",\"sample_rate\":";
+			appendInteger (out, event.sampleRate);
+		}
+		if (event.threadIndex != 0)
+		{
+			out += ",\"thread\":";
+			appendInteger (out, event.threadIndex);
+			std::string_view threadName = getThreadName (event.threadIndex);
+			if (!threadName.empty())
+			{
+				out += ",\"thread_name\":\"";
+				appendJsonEscaped (out, threadName);
+				out += '"';
+			}
+		}
+		if (const CallSite *site = findCallSite (event.callSiteId))
+		{
+			out += ",\"site\":\"";
+			appendJsonEscaped (out, site->file);
+			out += ':';
+			appendInteger (out, site->line);
+			out += '"';
+		}
+
+		const LogFields *contextFields = nullptr;
+		if (event.context)
+		{
+			out += ",\"request_id\":\"";
+			appendJsonEscaped (out, event.context->requestId);
+			out += '"';
+			if (!event.context->spanId.empty())
+			{
+				out += ",\"span_id\":\"";
+				appendJsonEscaped (out, event.context->spanId);
+				out += '"';
+			}
+			if (!event.context->fields.empty())
+			{
+				contextFields = &event.context->fields;
+			}
+		}
+		if (!event.fields.empty() || contextFields != nullptr)
+		{
+			appendJsonFields (out, contextFields, event.fields);
+		}
+		out += '}';
+	}
+
+	//-------------- LogfmtFormatter ----------------
+
+	void LogfmtFormatter::format (const EventContainer &event, std::string &out) const
+	{
+		out += "ts=";
+		appendRfc3339 (out, toNs (event.timePoint.time_since_epoch()));
+		out += " level=";
+		out += getLevelName (event.logLevel);
+		out += " msg=";
+		appendLogfmtValue (out, event.event);
+		if (EVENT_TYPE_TIMED_FINISHED == event.eventType)
+		{
+			out += " duration_ns=";
+			appendInteger (out, toNs (event.endTimePoint - event.timePoint));
+		}
+		if (event.sampleRate > 1)
+		{
+			out += " sample_rate=";
+			appendInteger (out, event.sampleRate);
+		}
+		if (event.threadIndex != 0)
+		{
+			out += " thread=";
+			appendInteger (out, event.threadIndex);
+			std::string_view threadName = getThreadName (event.threadIndex);
+			if (!threadName.empty())
+			{
+				out += " thread_name=";
+				appendLogfmtValue (out, threadName);
+			}
+		}
+		if (const CallSite *site = findCallSite (event.callSiteId))
+		{
+			// file:line, inside the quotes if the file needs them
+			out += " site=";
+			appendLogfmtValue (out, site->file);
+			bool quoted = out.back() == '"';
+			if (quoted)
+			{
+				out.pop_back();
+			}
+			out += ':';
+			appendInteger (out, site->line);
+			if (quoted)
+			{
+				out += '"';
+			}
+		}
+
+		// Flat: the keys are written as they are
+		auto appendField = [&] (const FieldView &field) {
+			out += ' ';
+			out += field.key;
+			out += '=';
+			if (field.type == FieldType::STRING)
+			{
+				appendLogfmtValue (out, field.strValue);
+			}
+			else
+			{
+				field.appendValue (out);
+			}
+		};
+		if (event.context)
+		{
+			out += " request_id=";
+			appendLogfmtValue (out, event.context->requestId);
+			if (!event.context->spanId.empty())
+			{
+				out += " span_id=";
+				appendLogfmtValue (out, event.context->spanId);
+			}
+			event.context->fields.forEach (appendField);
+		}
+		event.fields.forEach (appendField);
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
@@ -0,0 +1,92 @@
+/*********************************************************************************************
+ * Description  : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "StreamLoggerInterfaces.h"
+#include "StreamLogger.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	namespace
+	{
+		// The names, by thread index: blocks allocated when a thread of its range is named, and never freed
+		// The formatters read them without a lock
+		constexpr std::uint32_t NAMES_PER_BLOCK = 1024;
+		constexpr std::uint32_t MAX_NAME_BLOCKS = 64;
+
+		struct NameBlock
+		{
+				std::atomic<const std::string *> names [NAMES_PER_BLOCK] {};
+		};
+
+		constinit std::atomic<std::uint32_t> nextThreadIndex {1};
+		constinit std::atomic<NameBlock *> nameBlocks [MAX_NAME_BLOCKS] {};
+		constinit std::mutex namesMtx;    // Only for the writers
+
+		// Trivially destructible: still valid in the static destructors
+		constinit thread_local std::uint32_t threadIndex = 0;
+
+		std::uint32_t assignThreadIndex ()
+		{
+			threadIndex = nextThreadIndex.fetch_add (1, std::memory_order_relaxed);
+			return threadIndex;
+		}
+	}    // namespace
+
+	std::uint32_t getThreadIndex()
+	{
+		// Once assigned, a single thread_local load
+		return (threadIndex != 0) ? threadIndex : assignThreadIndex();
+	}
+
+	std::string_view getThreadName (std::uint32_t threadIndex)
+	{
+		std::uint32_t block = threadIndex / NAMES_PER_BLOCK;
+		if (block >= MAX_NAME_BLOCKS)
+		{
+			return {};
+		}
+		NameBlock *names = nameBlocks [block].load (std::memory_order_acquire);
+		if (names == nullptr)
+		{
+			return {};
+		}
+		const std::string *name = names->names [threadIndex % NAMES_PER_BLOCK].load (std::memory_order_acquire);
+		return (name != nullptr) ? std::string_view (*name) : std::string_view {};
+	}
+
+	namespace Config
+	{
+		void setThreadName (const std::string &name)
+		{
+			std::uint32_t index = getThreadIndex();
+			std::uint32_t block = index / NAMES_PER_BLOCK;
+			if (block >= MAX_NAME_BLOCKS)
+			{
+				// YAGNI: more than 64K threads. Its events have the index
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock (namesMtx);
+			NameBlock *names = nameBlocks [block].load (std::memory_order_relaxed);
+			if (names == nullptr)
+			{
+				names = new NameBlock;
+				nameBlocks [block].store (names, std::memory_order_release);
+			}
+
+			// The previous name is not freed: a formatter may be reading it. The threads are rarely renamed
+			const std::string *newName = name.empty() ? nullptr : new std::string (name);
+			names->names [index % NAMES_PER_BLOCK].store (newName, std::memory_order_release);
+		}
+	}    // namespace Config
+
+}    // namespace IgnacioPomar::Util::StreamLogger
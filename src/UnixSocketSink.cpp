@@ -0,0 +1,300 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#ifndef _WIN32
+
+#	include <cerrno>
+#	include <cstring>
+
+#	include <sys/socket.h>
+#	include <sys/time.h>
+#	include <sys/un.h>
+#	include <unistd.h>
+
+#	include "StreamLoggerSocketSink.h"
+
+namespace IgnacioPomar::Util::StreamLogger
+{
+	// The worker wakes up with this period to retry the connection and send the spilled frames
+	constexpr std::chrono::milliseconds SOCKET_IDLE_INTERVAL {50};
+
+	UnixSocketSink::UnixSocketSink (const std::string &socketPath, LogLevel level, SocketType socketType,
+	                                std::size_t maxSpillBytes)
+	    : LogSink (level, SinkMode::ASYNC)
+	    , socketPath (socketPath)
+	    , socketType (socketType)
+	    , maxSpillBytes (maxSpillBytes)
+	    , nextConnect (std::chrono::steady_clock::now())
+	    , backoff (DEFAULTS::SOCKET_BACKOFF_MIN_MS)
+	{
+		this->setIdleInterval (SOCKET_IDLE_INTERVAL);
+	}
+
+	UnixSocketSink::~UnixSocketSink()
+	{
+		// The worker writes the pending events before stopping
+		this->stopWorker();
+
+		// Last chance for the spilled ones
+		this->nextConnect = std::chrono::steady_clock::now();
+		this->sendSpill();
+		this->disconnect();
+	}
+
+	void UnixSocketSink::onShutdown()
+	{
+		// Last chance for the spilled ones (the worker is waiting: the connection is ours)
+		this->nextConnect = std::chrono::steady_clock::now();
+		this->sendSpill();
+	}
+
+	void UnixSocketSink::afterFork (bool child)
+	{
+		if (child)
+		{
+			// The connection and the spilled frames are the parent's: the child connects by itself
+			if (this->fd >= 0)
+			{
+				::close (this->fd);
+				this->fd = -1;
+			}
+			this->connected.store (false, std::memory_order_relaxed);
+			this->spill.clear();
+			this->spillBytes  = 0;
+			this->backoff     = std::chrono::milliseconds (DEFAULTS::SOCKET_BACKOFF_MIN_MS);
+			this->nextConnect = std::chrono::steady_clock::now();
+		}
+		LogSink::afterFork (child);
+	}
+
+	bool UnixSocketSink::isConnected() const
+	{
+		return this->connected.load (std::memory_order_relaxed);
+	}
+
+	std::uint64_t UnixSocketSink::getDropped() const
+	{
+		return this->dropped.load (std::memory_order_relaxed);
+	}
+
+	bool UnixSocketSink::connectSocket()
+	{
+		if (this->fd >= 0)
+		{
+			return true;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now < this->nextConnect)
+		{
+			return false;
+		}
+
+		sockaddr_un addr {};
+		addr.sun_family = AF_UNIX;
+		if (this->socketPath.size() >= sizeof (addr.sun_path))
+		{
+			this->setLevel (LogLevel::OFF);
+			this->reportError ("Socket path too long: " + this->socketPath);
+			return false;
+		}
+		std::memcpy (addr.sun_path, this->socketPath.c_str(), this->socketPath.size() + 1);
+
+		int type = (this->socketType == SocketType::STREAM) ? SOCK_STREAM : SOCK_DGRAM;
+		int sock = socket (AF_UNIX, type | SOCK_CLOEXEC, 0);
+		if (sock >= 0)
+		{
+			// A stuck agent must not stop the worker forever: it will be handled as a disconnection
+			timeval timeout {1, 0};
+			setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+			if (connect (sock, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) == 0)
+			{
+				this->fd      = sock;
+				this->backoff = std::chrono::milliseconds (DEFAULTS::SOCKET_BACKOFF_MIN_MS);
+				this->connected.store (true, std::memory_order_relaxed);
+				return true;
+			}
+			::close (sock);
+		}
+
+		// Exponential backoff
+		this->nextConnect = now + this->backoff;
+		this->backoff *= 2;
+		if (this->backoff > std::chrono::milliseconds (DEFAULTS::SOCKET_BACKOFF_MAX_MS))
+		{
+			this->backoff = std::chrono::milliseconds (DEFAULTS::SOCKET_BACKOFF_MAX_MS);
+		}
+		return false;
+	}
+
+	void UnixSocketSink::disconnect()
+	{
+		if (this->fd >= 0)
+		{
+			::close (this->fd);
+			this->fd = -1;
+		}
+		this->connected.store (false, std::memory_order_relaxed);
+		this->nextConnect = std::chrono::steady_clock::now() + this->backoff;
+	}
+
+	bool UnixSocketSink::sendFrame (const std::string &frame, std::uint32_t events)
+	{
+		if (!this->connectSocket())
+		{
+			return false;
+		}
+
+		if (this->socketType == SocketType::DATAGRAM)
+		{
+			if (send (this->fd, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t> (frame.size()))
+			{
+				return true;
+			}
+			if (errno == EMSGSIZE)
+			{
+				// Too big for a datagram: it would be rejected again after each reconnection
+				this->dropped.fetch_add (events, std::memory_order_relaxed);
+				return true;
+			}
+			this->disconnect();
+			return false;
+		}
+
+		// Stream: the length prefix, and the lines, maybe in several sends
+		std::uint32_t len      = static_cast<std::uint32_t> (frame.size());
+		unsigned char prefix [4] = {static_cast<unsigned char> (len >> 24), static_cast<unsigned char> (len >> 16),
+		                            static_cast<unsigned char> (len >> 8), static_cast<unsigned char> (len)};
+
+		iovec iov [2];
+		iov [0].iov_base = prefix;
+		iov [0].iov_len  = sizeof (prefix);
+		iov [1].iov_base = const_cast<char *> (frame.data());
+		iov [1].iov_len  = frame.size();
+
+		msghdr msg {};
+		msg.msg_iov    = iov;
+		msg.msg_iovlen = 2;
+
+		std::size_t pending = sizeof (prefix) + frame.size();
+		while (pending > 0)
+		{
+			ssize_t sent = sendmsg (this->fd, &msg, MSG_NOSIGNAL);
+			if (sent < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				// The whole frame will be sent again with the next connection: the agent discards a partial frame
+				this->disconnect();
+				return false;
+			}
+
+			pending -= static_cast<std::size_t> (sent);
+			while (sent > 0 && msg.msg_iovlen > 0)
+			{
+				std::size_t used = (static_cast<std::size_t> (sent) < msg.msg_iov->iov_len)
+				                       ? static_cast<std::size_t> (sent)
+				                       : msg.msg_iov->iov_len;
+				msg.msg_iov->iov_base = static_cast<char *> (msg.msg_iov->iov_base) + used;
+				msg.msg_iov->iov_len -= used;
+				sent -= static_cast<ssize_t> (used);
+				if (msg.msg_iov->iov_len == 0)
+				{
+					msg.msg_iov++;
+					msg.msg_iovlen--;
+				}
+			}
+		}
+		return true;
+	}
+
+	void UnixSocketSink::spillFrame (std::string &&frame, std::uint32_t events)
+	{
+		this->spillBytes += frame.size();
+		this->spill.push_back ({std::move (frame), events});
+
+		// Bounded: the oldest events are the less interesting ones
+		while (this->spillBytes > this->maxSpillBytes && !this->spill.empty())
+		{
+			this->spillBytes -= this->spill.front().frame.size();
+			this->dropped.fetch_add (this->spill.front().events, std::memory_order_relaxed);
+			this->spill.pop_front();
+		}
+	}
+
+	void UnixSocketSink::sendSpill()
+	{
+		while (!this->spill.empty())
+		{
+			if (!this->sendFrame (this->spill.front().frame, this->spill.front().events))
+			{
+				return;
+			}
+			this->spillBytes -= this->spill.front().frame.size();
+			this->spill.pop_front();
+		}
+	}
+
+	void UnixSocketSink::sendOrSpill (std::string &frame, std::uint32_t events)
+	{
+		// Keep the order: the new frames wait for the spilled ones
+		this->sendSpill();
+		if (!this->spill.empty() || !this->sendFrame (frame, events))
+		{
+			this->spillFrame (std::move (frame), events);
+		}
+		frame.clear();
+	}
+
+	void UnixSocketSink::writeBatch (const std::vector<EventContainer> &events)
+	{
+		std::string frame;
+		std::uint32_t frameEvents = 0;
+		std::string line;
+		auto formatter = this->getFormatter();
+
+		for (auto &event : events)
+		{
+			line.clear();
+			formatter->format (event, line);
+			line += '\n';
+
+			if (!frame.empty() && frame.size() + line.size() > DEFAULTS::SOCKET_FRAME_SIZE)
+			{
+				this->sendOrSpill (frame, frameEvents);
+				frameEvents = 0;
+			}
+
+			// A line bigger than the frame size goes alone (a datagram socket may reject it: it is dropped)
+			frame += line;
+			frameEvents++;
+		}
+
+		if (!frame.empty())
+		{
+			this->sendOrSpill (frame, frameEvents);
+		}
+	}
+
+	void UnixSocketSink::write (const EventContainer &event)
+	{
+		this->writeBatch (std::vector<EventContainer> {event});
+	}
+
+	void UnixSocketSink::onIdle()
+	{
+		if (!this->spill.empty())
+		{
+			this->sendSpill();
+		}
+	}
+
+}    // namespace IgnacioPomar::Util::StreamLogger
+
+#endif    // _WIN32
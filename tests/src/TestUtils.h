@@ -0,0 +1,64 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The checks of the tests, and the scenarios in a child process
+
+#pragma once
+#ifndef _LGGR_TEST_UTILS_H_
+#	define _LGGR_TEST_UTILS_H_
+
+#	include <cstdlib>
+#	include <functional>
+#	include <iostream>
+#	include <string>
+
+#	include <sys/wait.h>
+#	include <unistd.h>
+
+inline int failures = 0;
+
+inline void check (bool condition, const std::string &what)
+{
+	std::cout << (condition ? "[ OK ]\t" : "[FAIL]\t") << what << std::endl;
+	if (!condition)
+	{
+		failures++;
+	}
+}
+
+// True if the child ends by itself, with a 0 exit code
+inline bool waitChild (pid_t pid)
+{
+	int status = 0;
+	waitpid (pid, &status, 0);
+	return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+// Runs the scenario in a child process, as the configuration of the loggers is global (and shutdown is final)
+// Its exit code is the number of failed checks
+inline void runScenario (const std::string &name, const std::function<void()> &scenario)
+{
+	std::cout.flush();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		alarm (600);    // A deadlock ends the child (long: the sanitized builds are slow)
+		failures = 0;
+		scenario();
+		std::cout.flush();
+		_exit (failures);
+	}
+	check (waitChild (pid), name + ": the scenario ends without failures");
+}
+
+// The last line, and the exit code of main
+inline int testsResult ()
+{
+	std::cout << (failures == 0 ? "All tests passed" : "Some tests failed") << std::endl;
+	return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif    // _LGGR_TEST_UTILS_H_
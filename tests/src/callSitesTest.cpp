@@ -0,0 +1,260 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The call sites: registered once (by several threads at the same time), only when the levels may let the call
+// through, and its sampling. Each scenario runs in its own process
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerCallSites.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+static void silenceStandardSinks()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	lggr::Config::setStackLevel (lggr::LL::INFO);
+}
+
+// The registered sites of a function of this file
+static std::vector<lggr::CallSiteStats> getSitesOf (const std::string &function)
+{
+	std::vector<lggr::CallSiteStats> found;
+	for (auto &site : lggr::CallSites::getAll())
+	{
+		if (site.file.ends_with ("callSitesTest.cpp") && site.function.find (function) != std::string::npos)
+		{
+			found.push_back (site);
+		}
+	}
+	return found;
+}
+
+//-------------- Registration ----------------
+
+// 80 sites: each statement of a line is in its own column
+// clang-format off
+static void logEachSite()
+{
+	lggr::info << 0;  lggr::info << 1;  lggr::info << 2;  lggr::info << 3;  lggr::info << 4;  lggr::info << 5;
+	lggr::info << 6;  lggr::info << 7;  lggr::info << 8;  lggr::info << 9;  lggr::info << 10; lggr::info << 11;
+	lggr::info << 12; lggr::info << 13; lggr::info << 14; lggr::info << 15; lggr::info << 16; lggr::info << 17;
+	lggr::info << 18; lggr::info << 19; lggr::info << 20; lggr::info << 21; lggr::info << 22; lggr::info << 23;
+	lggr::info << 24; lggr::info << 25; lggr::info << 26; lggr::info << 27; lggr::info << 28; lggr::info << 29;
+	lggr::info << 30; lggr::info << 31; lggr::info << 32; lggr::info << 33; lggr::info << 34; lggr::info << 35;
+	lggr::info << 36; lggr::info << 37; lggr::info << 38; lggr::info << 39; lggr::info << 40; lggr::info << 41;
+	lggr::info << 42; lggr::info << 43; lggr::info << 44; lggr::info << 45; lggr::info << 46; lggr::info << 47;
+	lggr::info << 48; lggr::info << 49; lggr::info << 50; lggr::info << 51; lggr::info << 52; lggr::info << 53;
+	lggr::info << 54; lggr::info << 55; lggr::info << 56; lggr::info << 57; lggr::info << 58; lggr::info << 59;
+	lggr::info << 60; lggr::info << 61; lggr::info << 62; lggr::info << 63; lggr::info << 64; lggr::info << 65;
+	lggr::info << 66; lggr::info << 67; lggr::info << 68; lggr::info << 69; lggr::info << 70; lggr::info << 71;
+	lggr::info << 72; lggr::info << 73; lggr::info << 74; lggr::info << 75; lggr::info << 76; lggr::info << 77;
+	lggr::info << 78; lggr::info << 79;
+}
+// clang-format on
+
+static void concurrentRegistration()
+{
+	constexpr int THREADS = 4;
+	constexpr int ROUNDS  = 50;
+	silenceStandardSinks();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; t++)
+	{
+		threads.emplace_back ([] {
+			for (int i = 0; i < ROUNDS; i++)
+			{
+				logEachSite();
+			}
+		});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	auto sites    = getSitesOf ("logEachSite");
+	bool countsOk = true;
+	for (auto &site : sites)
+	{
+		lggr::CallSiteStats byId;
+		countsOk = countsOk && site.count == THREADS * ROUNDS && lggr::CallSites::getCallSite (site.id, byId)
+		        && byId.line == site.line;
+	}
+	check (sites.size() == 80, "registration: each site once, whatever thread logs it first");
+	check (countsOk, "registration: each site counts the calls of all the threads, and is found by its id");
+}
+
+static void discardedNotRegistered()
+{
+	silenceStandardSinks();
+	lggr::trace << "below every level";
+	lggr::trace.log ("below every level {}", 1);
+	check (getSitesOf ("discardedNotRegistered").empty(),
+	       "discarded: the calls below the levels don't resolve its site");
+
+	lggr::Config::setStackLevel (lggr::LL::TRACE);
+	lggr::trace << "now it passes";
+	check (getSitesOf ("discardedNotRegistered").size() == 1, "discarded: the site is registered once it may pass");
+}
+
+//-------------- Sampling ----------------
+
+// Keeps the text and the rate of the written events
+class SampledSink : public lggr::LogSink
+{
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			this->events.push_back ({event.event, event.sampleRate});
+		}
+
+	public:
+		struct Kept
+		{
+				std::string text;
+				std::uint32_t sampleRate;
+		};
+
+		SampledSink()
+		    : LogSink (lggr::LL::INFO)
+		{
+		}
+
+		std::vector<Kept> events;
+
+		// The kept calls of a batch (its events start with the prefix), and if all of them have this rate
+		std::size_t count (const std::string &prefix, std::uint32_t rate, bool &sameRate) const
+		{
+			std::size_t found = 0;
+			for (auto &event : this->events)
+			{
+				if (event.text.starts_with (prefix))
+				{
+					found++;
+					sameRate = sameRate && event.sampleRate == rate;
+				}
+			}
+			return found;
+		}
+};
+
+static void sampledSite (const std::string &text, int call)
+{
+	lggr::info << text << call;
+}
+
+static void logBatch (const std::string &text, int calls)
+{
+	for (int i = 0; i < calls; i++)
+	{
+		sampledSite (text, i);
+	}
+}
+
+// The sink, and the site of sampledSite with this sampling (registered by a first call)
+static std::shared_ptr<SampledSink> sampleSite (lggr::SamplingMode mode, std::uint32_t n,
+                                                std::chrono::milliseconds interval = std::chrono::seconds (1))
+{
+	silenceStandardSinks();
+	auto sink = std::make_shared<SampledSink>();
+	lggr::Config::addSink (sink);
+	sampledSite ("register", 0);
+	auto sites = getSitesOf ("sampledSite");
+	check (sites.size() == 1 && lggr::CallSites::setSampling (sites [0].id, mode, n, interval),
+	       "sampling: set on the site");
+	return sink;
+}
+
+static void everyNth()
+{
+	auto sink = sampleSite (lggr::SamplingMode::EVERY_NTH, 10);
+	logBatch ("call ", 1000);
+
+	bool sameRate = true;
+	check (sink->count ("call ", 10, sameRate) == 100, "every nth: 1 of each 10 calls");
+	check (sameRate, "every nth: each kept event stands for 10 calls (sample_rate)");
+	check (sink->events.size() > 3 && sink->events [1].text == "call 0" && sink->events [2].text == "call 10"
+	           && sink->events.back().text == "call 990",
+	       "every nth: the 1st, the 11th...");
+}
+
+static void perInterval()
+{
+	constexpr auto INTERVAL = std::chrono::milliseconds (1000);
+	auto sink               = sampleSite (lggr::SamplingMode::PER_INTERVAL, 5, INTERVAL);
+	lggr::CallSites::seedRandomSampling (7);
+
+	// The first interval has no previous rate: the first n
+	logBatch ("first ", 1000);
+	bool sameRate = true;
+	check (sink->count ("first ", 1, sameRate) == 5 && sameRate, "per interval: the first n calls of the first one");
+	check (sink->events.size() == 6 && sink->events [1].text == "first 0" && sink->events [5].text == "first 4",
+	       "per interval: in order (after the registering call)");
+
+	// The next ones, spread with the rate of the previous one: never more than n
+	std::this_thread::sleep_for (INTERVAL + std::chrono::milliseconds (50));
+	logBatch ("second ", 1000);
+	sameRate           = true;
+	std::size_t second = sink->count ("second ", 200, sameRate);
+	check (second > 0 && second <= 5, "per interval: up to n in the next one (" + std::to_string (second) + ")");
+	check (sameRate, "per interval: each kept event stands for the calls of the previous interval / n (200)");
+
+	std::this_thread::sleep_for (INTERVAL + std::chrono::milliseconds (50));
+	logBatch ("third ", 5000);
+	sameRate          = true;
+	std::size_t third = sink->count ("third ", 200, sameRate);
+	check (third > 0 && third <= 5 && sameRate, "per interval: the limit starts again in each interval ("
+	                                                + std::to_string (third) + ")");
+}
+
+static void randomRate()
+{
+	constexpr int CALLS = 20000;
+	auto sink           = sampleSite (lggr::SamplingMode::RANDOM, 10);
+	lggr::CallSites::seedRandomSampling (42);
+
+	logBatch ("call ", CALLS);
+	bool sameRate    = true;
+	std::size_t kept = sink->count ("call ", 10, sameRate);
+	check (kept >= CALLS / 10 * 9 / 10 && kept <= CALLS / 10 * 11 / 10,
+	       "random: about 1 of each 10 calls (" + std::to_string (kept) + " of " + std::to_string (CALLS) + ")");
+	check (sameRate, "random: each kept event stands for 10 calls");
+
+	// The same seed, the same calls
+	auto first = std::move (sink->events);
+	sink->events.clear();
+	lggr::CallSites::seedRandomSampling (42);
+	logBatch ("call ", CALLS);
+	bool repeated = first.size() == kept + 1 && sink->events.size() == kept;
+	for (std::size_t i = 0; repeated && i < kept; i++)
+	{
+		repeated = sink->events [i].text == first [i + 1].text;    // first [0]: the registering call
+	}
+	check (repeated, "random: the same seed keeps the same calls");
+}
+
+int main()
+{
+	runScenario ("concurrent registration", concurrentRegistration);
+	runScenario ("discarded calls", discardedNotRegistered);
+	runScenario ("every nth sampling", everyNth);
+	runScenario ("per interval sampling", perInterval);
+	runScenario ("random sampling", randomRate);
+
+	return testsResult();
+}
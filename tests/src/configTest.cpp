@@ -0,0 +1,164 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The configuration snapshots: each change publishes a new one, and the replaced ones are freed (with its sinks) once
+// no producer reads them. Each scenario runs in its own process
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Counts the written INFO events (while overridden, the DEBUG ones are written too)
+class CountingSink : public lggr::LogSink
+{
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			if (event.logLevel == lggr::LL::INFO)
+			{
+				this->written.fetch_add (1, std::memory_order_relaxed);
+			}
+		}
+
+	public:
+		CountingSink()
+		    : LogSink (lggr::LL::INFO)
+		{
+		}
+
+		std::atomic<std::size_t> written {0};
+};
+
+// The bytes allocated by the process (0 if the allocator doesn't tell, p.e. with AddressSanitizer)
+static std::size_t allocatedBytes()
+{
+	return mallinfo2().uordblks;
+}
+
+static void silenceStandardSinks()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+}
+
+//-------------- Bounded memory ----------------
+
+static void overrideToggling()
+{
+	constexpr int TOGGLES = 20000;
+	silenceStandardSinks();
+	lggr::info << "first use";
+
+	// Each toggle publishes two snapshots: kept, they would be some MB
+	for (int i = 0; i < 100; i++)
+	{
+		lggr::Config::setLevelOverride (lggr::LL::TRACE);
+		lggr::Config::setLevelOverride (lggr::LL::OFF);
+	}
+	std::size_t before = allocatedBytes();
+	for (int i = 0; i < TOGGLES; i++)
+	{
+		lggr::Config::setLevelOverride (lggr::LL::TRACE);
+		lggr::Config::setLevelOverride (lggr::LL::OFF);
+	}
+	std::size_t after = allocatedBytes();
+	check (after < before + 64 * 1024, "toggling: the memory stays bounded (" + std::to_string (before) + " -> "
+	                                       + std::to_string (after) + " bytes)");
+}
+
+static void removedSinkFreed()
+{
+	silenceStandardSinks();
+	auto counting = std::make_shared<CountingSink>();
+	lggr::Config::addSink (counting);
+
+	// Some configurations after it: all of them have the sink
+	std::weak_ptr<CountingSink> removed = counting;
+	for (int i = 0; i < 10; i++)
+	{
+		lggr::Config::setStackLevel ((i % 2 == 0) ? lggr::LL::DEBUG : lggr::LL::INFO);
+		lggr::info << "event " << i;
+	}
+	lggr::Config::removeSink (counting);
+	check (counting->written == 10, "removed sink: it got the events while attached");
+	counting.reset();
+	check (removed.expired(), "removed sink: freed when the last configuration with it is freed");
+}
+
+//-------------- Concurrent changes ----------------
+
+// The producers read the configuration while other thread replaces it: no event is lost, and the replaced ones are
+// not used after being freed (see the sanitized builds)
+static void concurrentChanges()
+{
+	constexpr int THREADS = 4;
+	constexpr int EVENTS  = 5000;
+	silenceStandardSinks();
+	auto counting = std::make_shared<CountingSink>();
+	lggr::Config::addSink (counting);
+
+	std::atomic<bool> done {false};
+	std::vector<std::weak_ptr<CountingSink>> removed;
+	std::thread changer ([&] {
+		while (!done.load())
+		{
+			lggr::Config::setLevelOverride (lggr::LL::DEBUG);
+			auto temporary = std::make_shared<CountingSink>();
+			lggr::Config::addSink (temporary);
+			lggr::Config::setLevelOverride (lggr::LL::OFF);
+			lggr::Config::removeSink (temporary);
+			removed.push_back (temporary);
+		}
+	});
+
+	std::vector<std::thread> producers;
+	for (int t = 0; t < THREADS; t++)
+	{
+		producers.emplace_back ([t] {
+			for (int i = 0; i < EVENTS; i++)
+			{
+				lggr::info.log ("thread {} event {}", t, i);
+				lggr::debug.log ("thread {} detail {}", t, i);
+			}
+		});
+	}
+	for (auto &producer : producers)
+	{
+		producer.join();
+	}
+	done = true;
+	changer.join();
+
+	check (counting->written == THREADS * EVENTS, "concurrent: the sink gets every INFO event once");
+
+	bool allFreed = true;
+	for (auto &sink : removed)
+	{
+		allFreed = allFreed && sink.expired();
+	}
+	check (!removed.empty() && allFreed, "concurrent: the removed sinks are freed");
+}
+
+int main()
+{
+	runScenario ("override toggling", overrideToggling);
+	runScenario ("removed sink", removedSinkFreed);
+	runScenario ("concurrent changes", concurrentChanges);
+
+	return testsResult();
+}
@@ -0,0 +1,174 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The crash handler and the flight recorder: a forked child logs and crashes (or is killed) on purpose, and the
+// parent checks what was saved
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerInterfaces.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+static std::string readFile (const std::string &path)
+{
+	std::ifstream file (path);
+	std::stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+// Runs the child until it crashes. Returns its termination signal (0 if it didn't die by a signal)
+static int runCrashingChild (const std::string &name, const std::function<void()> &crash)
+{
+	std::string logFile   = "/tmp/lggrCrashTest_" + name + ".log";
+	std::string crashFile = "/tmp/lggrCrashTest_" + name + ".crash";
+	std::remove (logFile.c_str());
+	std::remove (crashFile.c_str());
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		lggr::Config::setConsoleLevel (lggr::LL::OFF);
+		lggr::Config::setOutPath ("/tmp");
+		lggr::Config::setOutFile ("lggrCrashTest_" + name + ".log");
+		lggr::Config::enableCrashHandler (crashFile);
+
+		for (int i = 0; i < 10; i++)
+		{
+			lggr::info << "Event " << i;
+		}
+		auto running = lggr::warn.startTimedEvent();
+		running << "Last words";
+
+		crash();
+		_exit (0);
+	}
+
+	int status = 0;
+	waitpid (pid, &status, 0);
+	return WIFSIGNALED (status) ? WTERMSIG (status) : 0;
+}
+
+static void checkReports (const std::string &name, const std::string &reason)
+{
+	std::string log   = readFile ("/tmp/lggrCrashTest_" + name + ".log");
+	std::string crash = readFile ("/tmp/lggrCrashTest_" + name + ".crash");
+
+	check (log.find ("Event 9") != std::string::npos, name + ": the file sink buffer is flushed");
+	check (crash.find ("*** Crash: " + reason) != std::string::npos, name + ": the crash file has the reason");
+	check (crash.find ("[INFO]\tEvent 0") != std::string::npos, name + ": the crash file has the first event");
+	check (crash.find ("[WARN]\tLast words\t(running)") != std::string::npos,
+	       name + ": the crash file has the running timed event");
+}
+
+//-------------- Flight recorder ----------------
+
+class CollectingSubscriber : public lggr::LogEventsSubscriber
+{
+	public:
+		std::vector<lggr::EventContainer> events;
+
+		void onLogEvent (const std::string &, const std::string, const lggr::LogLevel) override
+		{
+		}
+
+		void onLogRecord (const lggr::EventContainer &event) override
+		{
+			this->events.push_back (event);
+		}
+};
+
+// A kill -9 runs nothing: the next run gets the events from the file
+static void flightRecorder()
+{
+	std::string recorderFile = "/tmp/lggrCrashTest_flight.rec";
+	std::remove (recorderFile.c_str());
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		lggr::Config::setConsoleLevel (lggr::LL::OFF);
+		lggr::Config::setFileLevel (lggr::LL::OFF);
+		lggr::Config::setFlightRecorder (recorderFile);
+
+		for (int i = 0; i < 10; i++)
+		{
+			lggr::info << "Event " << i;
+		}
+		{
+			// Recorded when it starts, and again (with more text) when it finishes
+			auto finished = lggr::info.startTimedEvent();
+			finished << "Connecting";
+			finished << " to the database";
+		}
+		auto running = lggr::warn.startTimedEvent();
+		running << "Last words";
+
+		kill (getpid(), SIGKILL);
+		_exit (0);
+	}
+	int status = 0;
+	waitpid (pid, &status, 0);
+	check (WIFSIGNALED (status) && WTERMSIG (status) == SIGKILL, "flight recorder: the child is killed");
+
+	// The next run
+	check (lggr::Config::setFlightRecorder (recorderFile), "flight recorder: the file is reopened");
+	CollectingSubscriber subscriber;
+	lggr::pullPreviousRunEvents (subscriber, lggr::LL::TRACE);
+	auto &events = subscriber.events;
+
+	bool inOrder = events.size() == 12;
+	for (int i = 0; inOrder && i < 10; i++)
+	{
+		inOrder = events [i].event == "Event " + std::to_string (i) && events [i].logLevel == lggr::LL::INFO;
+	}
+	check (inOrder, "flight recorder: the events of the killed run, in order");
+	check (inOrder && events [10].event == "Connecting to the database"
+	           && events [10].eventType == lggr::EVENT_TYPE_TIMED_FINISHED,
+	       "flight recorder: a finished timed event only once, with its whole text");
+	check (inOrder && events [11].event == "Last words" && events [11].eventType == lggr::EVENT_TYPE_TIMED_RUNNING
+	           && events [11].logLevel == lggr::LL::WARN,
+	       "flight recorder: the running timed event");
+
+	CollectingSubscriber warnings;
+	lggr::pullPreviousRunEvents (warnings, lggr::LL::WARN);
+	check (warnings.events.size() == 1, "flight recorder: the events are filtered by level");
+}
+
+int main()
+{
+	int sig = runCrashingChild ("segv", [] {
+		volatile int *nothing = nullptr;
+		*nothing              = 1;
+	});
+	check (sig == SIGSEGV, "segv: the child ends with the original signal");
+	checkReports ("segv", "signal 11");
+
+	sig = runCrashingChild ("abort", [] { std::abort(); });
+	check (sig == SIGABRT, "abort: the child ends with the original signal");
+	checkReports ("abort", "signal 6");
+
+	sig = runCrashingChild ("terminate", [] { std::terminate(); });
+	check (sig == SIGABRT, "terminate: the child ends aborting");
+	checkReports ("terminate", "std::terminate");
+
+	runScenario ("flight recorder", flightRecorder);
+
+	return testsResult();
+}
@@ -0,0 +1,122 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The typed fields of the events: the limits of its keys and values (never splitting an UTF-8 char), and the pull
+// of the stored events by a field value, with the numbers and the booleans compared as text
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// The texts of the pulled events
+class TextCollector : public lggr::LogEventsSubscriber
+{
+	public:
+		std::vector<std::string> texts;
+
+		void onLogEvent (const std::string &, const std::string logTxt, const lggr::LogLevel) override
+		{
+			texts.push_back (logTxt);
+		}
+};
+
+static std::vector<std::string> pullWith (lggr::LogLevel level, std::string_view key, std::string_view value)
+{
+	TextCollector collector;
+	lggr::pullLogEvents (collector, level, key, value);
+	return collector.texts;
+}
+
+static std::vector<lggr::FieldView> fieldsOf (const lggr::LogFields &fields)
+{
+	std::vector<lggr::FieldView> found;
+	fields.forEach ([&] (const lggr::FieldView &field) { found.push_back (field); });
+	return found;
+}
+
+//-------------- Scenarios ----------------
+
+static void limits()
+{
+	const std::string euro = "\xE2\x82\xAC";    // 3 bytes
+
+	lggr::LogFields fields;
+	fields.add (std::string (300, 'k'), 1);
+	fields.add (std::string (254, 'k') + euro, 2);    // The char would end at 257
+	fields.add ("big", std::string (70000, 'v'));
+	fields.add ("utf8", std::string (lggr::LogFields::MAX_VALUE_SIZE - 1, 'v') + euro);
+	fields.add ("next", std::string_view ("after"));
+
+	auto found = fieldsOf (fields);
+	check (found.size() == 5, "limits: the oversized fields are kept");
+	if (found.size() != 5)
+	{
+		return;
+	}
+	check (found [0].key == std::string (lggr::LogFields::MAX_KEY_SIZE, 'k') && found [0].intValue == 1,
+	       "limits: the key truncated to MAX_KEY_SIZE bytes");
+	check (found [1].key == std::string (254, 'k') && found [1].intValue == 2,
+	       "limits: the key truncated before the UTF-8 char wich doesn't fit");
+	check (found [2].strValue == std::string (lggr::LogFields::MAX_VALUE_SIZE, 'v'),
+	       "limits: the value truncated to MAX_VALUE_SIZE bytes");
+	check (found [3].strValue == std::string (lggr::LogFields::MAX_VALUE_SIZE - 1, 'v'),
+	       "limits: the value truncated before the UTF-8 char wich doesn't fit");
+	check (found [4].key == "next" && found [4].strValue == "after", "limits: the next field is read right");
+
+	// Room enough: untouched
+	lggr::LogFields fits;
+	fits.add (std::string (252, 'k') + euro, std::string (lggr::LogFields::MAX_VALUE_SIZE - 3, 'v') + euro);
+	found = fieldsOf (fits);
+	check (found.size() == 1 && found [0].key.size() == lggr::LogFields::MAX_KEY_SIZE
+	           && found [0].strValue.size() == lggr::LogFields::MAX_VALUE_SIZE && found [0].strValue.ends_with (euro),
+	       "limits: the fields of the max size are not truncated");
+}
+
+static void pullByField()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	lggr::Config::setStackLevel (lggr::LL::DEBUG);
+
+	lggr::info.with ("user", "bob").with ("id", 42) << "string and int";
+	lggr::info.with ("id", std::uint64_t {42}).with ("ok", true) << "uint and bool";
+	lggr::warn.with ("ratio", 2.5).with ("ok", false) << "double and bool";
+	lggr::debug.with ("id", -7).with ("user", "alice") << "negative";
+	lggr::info.with ("id", 43).with ("id", 42) << "repeated key";
+	lggr::info << "no fields";
+
+	using Texts = std::vector<std::string>;
+	check (pullWith (lggr::LL::TRACE, "user", "bob") == Texts {"string and int"}, "filter: by a string value");
+	check (pullWith (lggr::LL::TRACE, "id", "42") == Texts {"string and int", "uint and bool"},
+	       "filter: the int and uint values, as text (only the first field with the key)");
+	check (pullWith (lggr::LL::TRACE, "id", "-7") == Texts {"negative"}, "filter: a negative value");
+	check (pullWith (lggr::LL::TRACE, "ok", "true") == Texts {"uint and bool"}
+	           && pullWith (lggr::LL::TRACE, "ok", "false") == Texts {"double and bool"},
+	       "filter: the booleans as true and false");
+	check (pullWith (lggr::LL::TRACE, "ratio", "2.5") == Texts {"double and bool"}, "filter: a double value");
+	check (pullWith (lggr::LL::TRACE, "id", "42.0").empty() && pullWith (lggr::LL::TRACE, "ok", "1").empty()
+	           && pullWith (lggr::LL::TRACE, "Id", "42").empty(),
+	       "filter: other texts of the same value, or other key, don't match");
+	check (pullWith (lggr::LL::TRACE, "id", "43") == Texts {"repeated key"}, "filter: the first field of a key");
+	check (pullWith (lggr::LL::INFO, "id", "-7").empty() && pullWith (lggr::LL::WARN, "id", "42").empty()
+	           && pullWith (lggr::LL::WARN, "ratio", "2.5") == Texts {"double and bool"},
+	       "filter: with the level too");
+}
+
+int main()
+{
+	limits();
+	runScenario ("pull by field", pullByField);
+
+	return testsResult();
+}
@@ -0,0 +1,192 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The escaping of the structured formatters (JSON Lines and logfmt): the texts with the chars to escape in every
+// position, so both the 16 bytes blocks and the tail of the vectorized search are used
+
+#include <string>
+#include <string_view>
+
+#include "EventContainer.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+//-------------- Reference escaping ----------------
+
+// Byte by byte, as the formatters must write it
+static std::string jsonEscaped (std::string_view text)
+{
+	static const char hex [] = "0123456789abcdef";
+
+	std::string out;
+	for (char ch : text)
+	{
+		unsigned char c = static_cast<unsigned char> (ch);
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		default:
+			if (c < 0x20)
+			{
+				out += "\\u00";
+				out += hex [c >> 4];
+				out += hex [c & 0x0F];
+			}
+			else
+			{
+				out += ch;
+			}
+			break;
+		}
+	}
+	return out;
+}
+
+static std::string logfmtValue (std::string_view text)
+{
+	bool plain = !text.empty();
+	for (char ch : text)
+	{
+		unsigned char c = static_cast<unsigned char> (ch);
+		plain           = plain && c > 0x20 && c != '"' && c != '\\' && c != '=';
+	}
+	return plain ? std::string (text) : '"' + jsonEscaped (text) + '"';
+}
+
+//-------------- Formatted events ----------------
+
+static const std::string EPOCH = "1970-01-01T00:00:00.000000000Z";
+
+static std::string formatMsg (const lggr::LogFormatter &formatter, std::string_view msg)
+{
+	lggr::EventContainer event (lggr::LL::INFO);
+	event.event = msg;
+	std::string out;
+	formatter.format (event, out);
+	return out;
+}
+
+static std::string jsonLine (std::string_view msg)
+{
+	return "{\"ts\":\"" + EPOCH + "\",\"level\":\"INFO\",\"msg\":\"" + jsonEscaped (msg) + "\"}";
+}
+
+static std::string logfmtLine (std::string_view msg)
+{
+	return "ts=" + EPOCH + " level=INFO msg=" + logfmtValue (msg);
+}
+
+//-------------- Scenarios ----------------
+
+static void knownEscapes()
+{
+	lggr::JsonLinesFormatter json;
+	lggr::LogfmtFormatter logfmt;
+
+	std::string msg = "say \"hi\" C:\\tmp\n\r\t\b\f";
+	msg += '\x01';
+	msg += '\x1F';
+	msg += '\0';
+	std::string expected = "say \\\"hi\\\" C:\\\\tmp\\n\\r\\t\\b\\f\\u0001\\u001f\\u0000";
+	check (formatMsg (json, msg) == "{\"ts\":\"" + EPOCH + "\",\"level\":\"INFO\",\"msg\":\"" + expected + "\"}",
+	       "json: quotes, backslashes and control chars escaped");
+	check (formatMsg (logfmt, msg) == "ts=" + EPOCH + " level=INFO msg=\"" + expected + "\"",
+	       "logfmt: the same escapes, inside quotes");
+
+	// UTF-8 (and DEL) are written as they are, also in the 16 bytes blocks
+	std::string utf8 = "año ñandú €uro 日本語 \x7F";
+	check (formatMsg (json, utf8).find (utf8) != std::string::npos, "json: UTF-8 untouched");
+	check (formatMsg (logfmt, "日本語€ñ\x7F") == logfmtLine ("日本語€ñ\x7F")
+	           && logfmtLine ("日本語€ñ\x7F").ends_with ("msg=日本語€ñ\x7F"),
+	       "logfmt: UTF-8 not quoted");
+
+	check (formatMsg (logfmt, "plain") == "ts=" + EPOCH + " level=INFO msg=plain", "logfmt: plain value not quoted");
+	check (formatMsg (logfmt, "two words") == "ts=" + EPOCH + " level=INFO msg=\"two words\"",
+	       "logfmt: value with spaces quoted");
+	check (formatMsg (logfmt, "a=b") == "ts=" + EPOCH + " level=INFO msg=\"a=b\"", "logfmt: value with '=' quoted");
+	check (formatMsg (logfmt, "") == "ts=" + EPOCH + " level=INFO msg=\"\"", "logfmt: empty value quoted");
+}
+
+// Each special char in each position of texts of 0 to 48 bytes: before, inside and after the 16 bytes blocks
+static void everyPosition()
+{
+	lggr::JsonLinesFormatter json;
+	lggr::LogfmtFormatter logfmt;
+
+	const std::string specials = std::string ("\"\\\n\x01\x1F =\xC3\x7F") + '\0';
+	bool jsonOk                = true;
+	bool logfmtOk              = true;
+	std::string failed;
+	for (std::size_t len = 0; len <= 48; len++)
+	{
+		std::string clean (len, 'a');
+		jsonOk   = jsonOk && formatMsg (json, clean) == jsonLine (clean);
+		logfmtOk = logfmtOk && formatMsg (logfmt, clean) == logfmtLine (clean);
+		for (std::size_t pos = 0; pos < len; pos++)
+		{
+			for (char special : specials)
+			{
+				// Two of them: the first one found, and the clean run after it
+				std::string msg = clean;
+				msg [pos]       = special;
+				msg [len - 1]   = special;
+
+				bool jsonMatch   = formatMsg (json, msg) == jsonLine (msg);
+				bool logfmtMatch = formatMsg (logfmt, msg) == logfmtLine (msg);
+				jsonOk           = jsonOk && jsonMatch;
+				logfmtOk         = logfmtOk && logfmtMatch;
+				if (!(jsonMatch && logfmtMatch) && failed.empty())
+				{
+					failed = " (first failure: length " + std::to_string (len) + ", position " + std::to_string (pos)
+					       + ", char " + std::to_string (static_cast<unsigned char> (special)) + ")";
+				}
+			}
+		}
+	}
+	check (jsonOk, "json: escaped in any position of the text" + failed);
+	check (logfmtOk, "logfmt: quoted and escaped in any position of the text" + failed);
+}
+
+static void escapedFields()
+{
+	lggr::JsonLinesFormatter json;
+	lggr::LogfmtFormatter logfmt;
+
+	lggr::EventContainer event (lggr::LL::INFO);
+	event.event = "msg";
+	event.fields.add ("path", std::string_view ("C:\\dir \"x\"\n"));
+	event.fields.add ("k\"ey", std::string_view ("v"));
+	event.fields.add ("query", std::string_view ("a=1 b=2"));
+	event.fields.add ("n", 42);
+
+	std::string out;
+	json.format (event, out);
+	check (out.ends_with (",\"fields\":{\"path\":\"C:\\\\dir \\\"x\\\"\\n\",\"k\\\"ey\":\"v\","
+	                      "\"query\":\"a=1 b=2\",\"n\":42}}"),
+	       "json: the keys and the string values of the fields escaped");
+
+	out.clear();
+	logfmt.format (event, out);
+	check (out.ends_with (" path=\"C:\\\\dir \\\"x\\\"\\n\" k\"ey=v query=\"a=1 b=2\" n=42"),
+	       "logfmt: the string values with spaces, '=' or escapes quoted");
+}
+
+int main()
+{
+	knownEscapes();
+	everyPosition();
+	escapedFields();
+
+	return testsResult();
+}
@@ -0,0 +1,298 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// fork() and exit while other threads log, and shutdown(). Each scenario runs in its own process, as the
+// configuration of the loggers is global (and shutdown is final)
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// The messages of the file (the text from the first marker of each line, without the fields), and how many times
+// each one is there. The lines may be text or json
+static std::map<std::string, int> readMessages (const std::string &path)
+{
+	std::map<std::string, int> messages;
+	std::ifstream file (path);
+	std::string line;
+	while (std::getline (file, line))
+	{
+		std::size_t pos = line.find ("msg:");
+		if (pos != std::string::npos)
+		{
+			std::size_t end = line.find_first_of ("\t\"", pos);
+			messages [line.substr (pos, (end != std::string::npos) ? end - pos : end)]++;
+		}
+	}
+	return messages;
+}
+
+static std::string setFileOutput (const std::string &name, bool async)
+{
+	std::string logFile = "/tmp/lggrLifecycleTest_" + name + ".log";
+	std::remove (logFile.c_str());
+
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	if (async)
+	{
+		lggr::Config::setFileLevel (lggr::LL::OFF);
+		auto sink = std::make_shared<lggr::FileSink> (lggr::LL::TRACE, logFile, lggr::SinkMode::ASYNC);
+
+		// Its worker looks up the call sites while the others fork
+		sink->setFormatter (std::make_shared<lggr::JsonLinesFormatter>());
+		lggr::Config::addSink (sink);
+	}
+	else
+	{
+		lggr::Config::setFileLevel (lggr::LL::TRACE);
+		lggr::Config::setOutPath ("/tmp");
+		lggr::Config::setOutFile ("lggrLifecycleTest_" + name + ".log");
+	}
+	return logFile;
+}
+
+//-------------- fork while other threads log ----------------
+
+static void forkWhileLogging (const std::string &name, unsigned int shards, bool async)
+{
+	constexpr int THREADS  = 3;
+	constexpr int CHILDREN = 8;
+	constexpr int LINES    = 200;
+
+	lggr::Config::setMultiThreadSafe (true);
+	if (shards > 0)
+	{
+		lggr::Config::setShards (shards);
+	}
+	std::string logFile   = setFileOutput (name, async);
+	std::string childFile = "/tmp/lggrLifecycleTest_" + name + "Child.log";
+	std::remove (childFile.c_str());
+
+	std::atomic<bool> stop {false};
+	std::vector<int> logged (THREADS, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; t++)
+	{
+		threads.emplace_back ([&, t] {
+			while (!stop.load())
+			{
+				lggr::info.log ("msg:parent {} {};", t, logged [t]);
+				logged [t]++;
+			}
+		});
+	}
+
+	bool childrenOk = true;
+	for (int c = 0; c < CHILDREN; c++)
+	{
+		std::this_thread::sleep_for (std::chrono::milliseconds (5));
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			// Only this thread exists here: the loggers must be usable, and its threads restarted
+			alarm (60);
+			lggr::Channel channel ("child" + std::to_string (c));
+			channel.setConsoleLevel (lggr::LL::OFF);
+			channel.setFileLevel (lggr::LL::TRACE);
+			channel.setOutPath ("/tmp");
+			channel.setOutFile ("lggrLifecycleTest_" + name + "Child.log");
+			for (int i = 0; i < LINES; i++)
+			{
+				lggr::info.log ("msg:child {} {};", c, i);
+				channel.debug.log ("msg:childChannel {} {};", c, i);
+			}
+			std::exit (0);
+		}
+
+		childrenOk = waitChild (pid) && childrenOk;
+	}
+	check (childrenOk, name + ": every child logs and exits (no lock left taken)");
+
+	stop = true;
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	check (lggr::shutdown(), name + ": shutdown writes the pending events");
+
+	auto messages      = readMessages (logFile);
+	auto childMessages = readMessages (childFile);
+	int missing        = 0;
+	int repeated       = 0;
+	for (int c = 0; c < CHILDREN; c++)
+	{
+		for (int i = 0; i < LINES; i++)
+		{
+			std::string index = " " + std::to_string (c) + " " + std::to_string (i) + ";";
+			auto it           = messages.find ("msg:child" + index);
+			auto channelIt    = childMessages.find ("msg:childChannel" + index);
+			missing += (it == messages.end()) ? 1 : 0;
+			missing += (channelIt == childMessages.end()) ? 1 : 0;
+			repeated += (it != messages.end() && it->second > 1) ? 1 : 0;
+			repeated += (channelIt != childMessages.end() && channelIt->second > 1) ? 1 : 0;
+		}
+	}
+	check (missing == 0, name + ": the events of the children are written");
+	check (repeated == 0, name + ": the events of the children are written once");
+
+	missing  = 0;
+	repeated = 0;
+	for (int t = 0; t < THREADS; t++)
+	{
+		for (int i = 0; i < logged [t]; i++)
+		{
+			auto it = messages.find ("msg:parent " + std::to_string (t) + " " + std::to_string (i) + ";");
+			missing += (it == messages.end()) ? 1 : 0;
+			repeated += (it != messages.end() && it->second > 1) ? 1 : 0;
+		}
+	}
+	check (missing == 0, name + ": the events of the parent are written");
+	check (repeated == 0, name + ": the pending events of the parent are not written by the children");
+}
+
+//-------------- exit while other threads log ----------------
+
+static void exitWhileLogging (const std::string &name, unsigned int shards, bool async)
+{
+	std::string logFile = "/tmp/lggrLifecycleTest_" + name + ".log";
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		alarm (60);
+		lggr::Config::setMultiThreadSafe (true);
+		if (shards > 0)
+		{
+			lggr::Config::setShards (shards);
+		}
+		setFileOutput (name, async);
+
+		// Never joined: they are logging while the static objects are destroyed
+		for (int t = 0; t < 4; t++)
+		{
+			std::thread ([t] {
+				lggr::Channel channel ("exit" + std::to_string (t));
+				channel.setConsoleLevel (lggr::LL::OFF);
+				channel.setFileLevel (lggr::LL::OFF);
+				channel.setStackLevel (lggr::LL::WARN);
+				for (int i = 0;; i++)
+				{
+					lggr::debug.log ("msg:running {} {};", t, i);
+					channel.warn << "msg:stream " << t << " " << i << ";";
+				}
+			}).detach();
+		}
+		std::this_thread::sleep_for (std::chrono::milliseconds (50));
+		lggr::info << "msg:last line;";
+		std::exit (0);
+	}
+
+	check (waitChild (pid), name + ": exit doesn't crash or hang");
+
+	auto messages = readMessages (logFile);
+	check (messages.count ("msg:last line;") == 1, name + ": the last event is written");
+}
+
+//-------------- shutdown ----------------
+
+// Counts the written events. Optionally slow
+class CountingSink : public lggr::LogSink
+{
+	public:
+		std::atomic<int> written {0};
+		std::chrono::milliseconds delay;
+
+		CountingSink (std::chrono::milliseconds delay)
+		    : LogSink (lggr::LL::TRACE, lggr::SinkMode::ASYNC)
+		    , delay (delay)
+		{
+		}
+
+		~CountingSink()
+		{
+			this->stopWorker();
+		}
+
+	protected:
+		void write (const lggr::EventContainer &) override
+		{
+			std::this_thread::sleep_for (this->delay);
+			this->written++;
+		}
+};
+
+static void shutdownDrains()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<CountingSink> (std::chrono::milliseconds (0));
+	lggr::Config::addSink (sink);
+
+	for (int i = 0; i < 5000; i++)
+	{
+		lggr::info.log ("msg:event {};", i);
+	}
+	check (lggr::shutdown(), "shutdown: returns true when the outputs finish");
+	check (sink->written == 5000, "shutdown: the queued events are written");
+
+	lggr::info << "msg:after shutdown;";
+	lggr::Channel late ("created after shutdown");
+	late.addSink (sink);
+	late.error << "msg:after shutdown;";
+	check (lggr::shutdown() && sink->written == 5000, "shutdown: the later events are discarded");
+}
+
+static void shutdownTimeout()
+{
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<CountingSink> (std::chrono::milliseconds (20));
+	lggr::Config::addSink (sink);
+
+	for (int i = 0; i < 100; i++)
+	{
+		lggr::info.log ("msg:event {};", i);
+	}
+	auto start   = std::chrono::steady_clock::now();
+	bool drained = lggr::shutdown (std::chrono::milliseconds (100));
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	check (!drained, "shutdown: returns false when an output doesn't finish in time");
+	check (elapsed < std::chrono::seconds (1), "shutdown: doesn't wait beyond the timeout");
+}
+
+int main()
+{
+	runScenario ("fork", [] { forkWhileLogging ("fork", 0, false); });
+	runScenario ("fork async", [] { forkWhileLogging ("forkAsync", 0, true); });
+	runScenario ("fork sharded", [] { forkWhileLogging ("forkSharded", 4, true); });
+
+	exitWhileLogging ("exit", 0, false);
+	exitWhileLogging ("exitAsync", 0, true);
+	exitWhileLogging ("exitSharded", 4, false);
+
+	runScenario ("shutdown", shutdownDrains);
+	runScenario ("shutdown timeout", shutdownTimeout);
+
+	return testsResult();
+}
@@ -0,0 +1,221 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// Scoped buffers: the DEBUG events of a scope are written only if it fails (an ERROR, fail(), or an exception), in
+// order and with its original time. Each scenario runs in its own process
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerBuffer.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Keeps the written events (INFO and above, as the file of a service)
+class RecordingSink : public lggr::LogSink
+{
+	private:
+		std::mutex mtx;
+		std::vector<lggr::EventContainer> written;
+
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			this->written.push_back (event);
+		}
+
+	public:
+		RecordingSink()
+		    : LogSink (lggr::LL::INFO)
+		{
+		}
+
+		std::vector<lggr::EventContainer> getWritten ()
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			return this->written;
+		}
+};
+
+static std::shared_ptr<RecordingSink> addRecordingSink()
+{
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	lggr::Config::setStackLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<RecordingSink>();
+	lggr::Config::addSink (sink);
+	return sink;
+}
+
+// Are the written texts these ones, in order?
+static bool hasTexts (const std::vector<lggr::EventContainer> &events, const std::vector<std::string> &texts)
+{
+	if (events.size() != texts.size())
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < texts.size(); i++)
+	{
+		if (events [i].event != texts [i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// The events of a buffer are logged before the time returned, with a tick between them
+static lggr::TimePoint logBuffered (const std::string &prefix)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		lggr::debug << prefix << " " << i;
+		std::this_thread::sleep_for (std::chrono::milliseconds (2));
+	}
+	return std::chrono::system_clock::now();
+}
+
+// Logged before the flush, and in order
+static bool keepTimes (const std::vector<lggr::EventContainer> &events, std::size_t from, lggr::TimePoint loggedBy)
+{
+	for (std::size_t i = from; i < from + 3; i++)
+	{
+		if (i >= events.size() || events [i].timePoint > loggedBy
+		    || (i > from && events [i].timePoint <= events [i - 1].timePoint))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-------------- Flushed ----------------
+
+static void flushedByError()
+{
+	auto sink = addRecordingSink();
+	{
+		lggr::ScopedLogBuffer buffer;
+		lggr::TimePoint loggedBy = logBuffered ("detail");
+		lggr::info << "written";
+		check (buffer.size() == 3 && hasTexts (sink->getWritten(), {"written"}),
+		       "error: the debug events wait in the buffer, the info one is written");
+
+		std::this_thread::sleep_for (std::chrono::milliseconds (2));
+		lggr::error << "failed";
+		lggr::debug << "after";
+
+		auto written = sink->getWritten();
+		check (hasTexts (written, {"written", "detail 0", "detail 1", "detail 2", "failed", "after"}),
+		       "error: the buffered events are written before it, and the next ones directly");
+		check (keepTimes (written, 1, loggedBy), "error: the buffered events keep its original time");
+		check (written [3].timePoint < written [4].timePoint, "error: the error is later than them");
+		check (buffer.hasFailed() && buffer.size() == 0, "error: the buffer is failed and empty");
+	}
+	check (sink->getWritten().size() == 6, "error: nothing more at the end of the scope");
+}
+
+static void flushedByFail()
+{
+	auto sink = addRecordingSink();
+	lggr::TimePoint loggedBy;
+	{
+		lggr::ScopedLogBuffer buffer;
+		loggedBy = logBuffered ("detail");
+		check (sink->getWritten().empty(), "fail: nothing is written before");
+		buffer.fail();
+		check (hasTexts (sink->getWritten(), {"detail 0", "detail 1", "detail 2"}), "fail: they are written, in order");
+	}
+	check (keepTimes (sink->getWritten(), 0, loggedBy), "fail: they keep its original time");
+}
+
+static void flushedByException()
+{
+	auto sink = addRecordingSink();
+	lggr::TimePoint loggedBy;
+	try
+	{
+		lggr::ScopedLogBuffer buffer;
+		loggedBy = logBuffered ("detail");
+		throw std::runtime_error ("failed");
+	}
+	catch (const std::exception &)
+	{
+		check (hasTexts (sink->getWritten(), {"detail 0", "detail 1", "detail 2"}),
+		       "exception: they are written when it leaves the scope, in order");
+	}
+	check (keepTimes (sink->getWritten(), 0, loggedBy), "exception: they keep its original time");
+
+	// A scope wich starts and ends inside the unwinding doesn't fail by it
+	struct Unwinding
+	{
+			~Unwinding()
+			{
+				lggr::ScopedLogBuffer buffer;
+				lggr::debug << "cleanup";
+			}
+	};
+	try
+	{
+		Unwinding unwinding;
+		throw std::runtime_error ("failed");
+	}
+	catch (const std::exception &)
+	{
+	}
+	check (sink->getWritten().size() == 3, "exception: a scope created while unwinding is not failed by it");
+}
+
+//-------------- Discarded ----------------
+
+static void discardedOnSuccess()
+{
+	auto sink = addRecordingSink();
+	{
+		lggr::ScopedLogBuffer buffer;
+		logBuffered ("detail");
+		lggr::warn << "not a failure";
+		check (buffer.size() == 3, "success: the debug events wait in the buffer");
+	}
+	check (hasTexts (sink->getWritten(), {"not a failure"}), "success: they are discarded at the end of the scope");
+
+	{
+		lggr::ScopedLogBuffer buffer;
+		logBuffered ("detail");
+		buffer.discard();
+		lggr::error << "failed";
+	}
+	check (hasTexts (sink->getWritten(), {"not a failure", "failed"}), "discard: the discarded ones are not flushed");
+
+	{
+		lggr::ScopedLogBuffer buffer (lggr::LL::TRACE, lggr::LL::ERROR, 2);
+		logBuffered ("detail");
+		check (buffer.getDropped() == 1, "limit: the oldest one is dropped");
+		buffer.fail();
+	}
+	auto written = sink->getWritten();
+	check (written.size() == 4 && written [2].event == "detail 1" && written [3].event == "detail 2",
+	       "limit: the newest ones are flushed");
+}
+
+int main()
+{
+	runScenario ("flushed by an error", flushedByError);
+	runScenario ("flushed by fail", flushedByFail);
+	runScenario ("flushed by an exception", flushedByException);
+	runScenario ("discarded on success", discardedOnSuccess);
+
+	return testsResult();
+}
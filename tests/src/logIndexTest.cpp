@@ -0,0 +1,331 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The side index of the log files: its blocks start and end at the start of a line and describe its events, and
+// logquery (built with the tests) finds the same lines as a linear scan of the file. The events cross the midnight
+// (a rotation), the file buffer is flushed many times, and some lines are bigger than it. Each scenario runs in its
+// own process
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerLogIndex.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+namespace fs   = std::filesystem;
+
+static std::string toolsDir;    // Where logquery is: the parent of the tests directory
+
+// The events start at 23:55 of this day, one each 500 ms: the ones from 00:00 go to the next day file
+static const std::chrono::sys_days FIRST_DAY {std::chrono::year {2024} / 4 / 17};
+static const lggr::TimePoint START = FIRST_DAY + std::chrono::hours (23) + std::chrono::minutes (55);
+
+static std::string formatSeconds (lggr::TimePoint timePoint)
+{
+	std::time_t seconds = std::chrono::system_clock::to_time_t (timePoint);
+	struct tm buf;
+	gmtime_r (&seconds, &buf);
+	char text [32];
+	return std::string (text, strftime (text, sizeof (text), "%F %T", &buf));
+}
+
+static std::string readFile (const fs::path &path)
+{
+	std::ifstream in (path, std::ios::binary);
+	return std::string (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char>());
+}
+
+//-------------- Linear scan ----------------
+
+// "YYYY-MM-DD HH:MM:SS... [LEVEL]": the first line of an event. Its seconds since the epoch and its level
+static bool parseEventStart (std::string_view line, std::int64_t &seconds, lggr::LogLevel &level)
+{
+	int year, month, day, hour, minute, second;
+	std::string head (line.substr (0, 19));
+	if (line.size() < 19 || std::sscanf (head.c_str(), "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute,
+	                                     &second) != 6)
+	{
+		return false;
+	}
+	std::chrono::sys_days days {std::chrono::year {year} / month / day};
+	seconds = days.time_since_epoch().count() * 86400 + hour * 3600 + minute * 60 + second;
+
+	std::size_t open  = line.find (" [");
+	std::size_t close = line.find (']', open);
+	for (int i = 0; open != std::string_view::npos && close != std::string_view::npos && i <= 5; i++)
+	{
+		if (line.substr (open + 2, close - open - 2) == lggr::getLevelName (static_cast<lggr::LogLevel> (i)))
+		{
+			level = static_cast<lggr::LogLevel> (i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// The lines of the events in [fromSec, toSec] from the level, with its continuation lines
+static std::string scanLog (std::string_view log, std::int64_t fromSec, std::int64_t toSec, lggr::LogLevel minLevel)
+{
+	std::string out;
+	bool keep = false;
+	while (!log.empty())
+	{
+		std::size_t eol       = log.find ('\n');
+		std::string_view line = log.substr (0, (eol == std::string_view::npos) ? log.size() : eol + 1);
+		log.remove_prefix (line.size());
+
+		std::int64_t seconds;
+		lggr::LogLevel level;
+		if (parseEventStart (line, seconds, level))
+		{
+			keep = seconds >= fromSec && seconds <= toSec && level >= minLevel;
+		}
+		if (keep)
+		{
+			out.append (line);
+		}
+	}
+	return out;
+}
+
+//-------------- logquery ----------------
+
+static std::string runQuery (const fs::path &logFile, const std::string &args)
+{
+	std::string command = toolsDir + "/logquery '" + logFile.string() + "' " + args;
+	std::string out;
+	if (FILE *pipe = popen (command.c_str(), "r"))
+	{
+		char buffer [64 * 1024];
+		std::size_t read;
+		while ((read = std::fread (buffer, 1, sizeof (buffer), pipe)) > 0)
+		{
+			out.append (buffer, read);
+		}
+		if (pclose (pipe) != 0)
+		{
+			out += "\n(logquery failed)";
+		}
+	}
+	return out;
+}
+
+// Some time ranges and levels of the file: logquery (with 1 and with 4 threads) against the linear scan
+static bool sameAsScan (const fs::path &logFile, const std::string &what)
+{
+	std::string log = readFile (logFile);
+	std::int64_t firstSec;
+	lggr::LogLevel level;
+	if (!parseEventStart (log, firstSec, level))
+	{
+		check (false, what + ": the log starts with an event");
+		return false;
+	}
+
+	struct Case
+	{
+			std::int64_t fromOffset;    // From the first event, in seconds
+			std::int64_t toOffset;
+			lggr::LogLevel level;
+	};
+	const Case cases [] = {{0, 100000, lggr::LL::TRACE}, {0, 0, lggr::LL::TRACE},    {10, 22, lggr::LL::TRACE},
+	                       {33, 33, lggr::LL::TRACE},   {0, 100000, lggr::LL::WARN}, {60, 250, lggr::LL::ERROR},
+	                       {190, 300, lggr::LL::INFO},  {-50, -1, lggr::LL::TRACE}, {5000, 9000, lggr::LL::TRACE}};
+
+	bool same = true;
+	for (const Case &test : cases)
+	{
+		std::int64_t fromSec = firstSec + test.fromOffset;
+		std::int64_t toSec   = firstSec + test.toOffset;
+		auto asTime          = [] (std::int64_t seconds) {
+			return formatSeconds (lggr::TimePoint (std::chrono::seconds (seconds)));
+		};
+		std::string args = "-f '" + asTime (fromSec) + "' -t '" + asTime (toSec) + "' -l "
+		                 + std::string (lggr::getLevelName (test.level));
+
+		std::string expected = scanLog (log, fromSec, toSec, test.level);
+		for (const char *threads : {" -j 1", " -j 4"})
+		{
+			std::string found = runQuery (logFile, args + threads);
+			if (found != expected)
+			{
+				same = false;
+				check (false, what + ": logquery " + args + threads + " finds " + std::to_string (found.size())
+				                  + " bytes, the scan " + std::to_string (expected.size()));
+			}
+		}
+	}
+	return same;
+}
+
+//-------------- Index layout ----------------
+
+// Each block starts and ends at the start of an event, has its events, times and levels, and they follow each other
+static bool checkIndex (const fs::path &logFile, std::size_t &indexedEvents)
+{
+	std::string log = readFile (logFile);
+	lggr::LogIndexReader index;
+	if (!index.open (logFile.string() + ".idx") || index.size() == 0)
+	{
+		return false;
+	}
+
+	bool ok              = true;
+	std::uint64_t offset = 0;
+	indexedEvents        = 0;
+	for (const lggr::LogIndexEntry &entry : index)
+	{
+		ok = ok && entry.offset == offset && entry.offset < entry.endOffset && entry.endOffset <= log.size();
+		ok = ok && (entry.endOffset == log.size() || log [entry.endOffset - 1] == '\n');
+		if (!ok)
+		{
+			break;
+		}
+
+		std::string_view block (log.data() + entry.offset, entry.endOffset - entry.offset);
+		std::uint32_t events    = 0;
+		std::uint32_t levelMask = 0;
+		bool inTime             = true;
+		bool startsWithEvent    = false;
+		while (!block.empty())
+		{
+			std::size_t eol       = block.find ('\n');
+			std::string_view line = block.substr (0, (eol == std::string_view::npos) ? block.size() : eol + 1);
+			std::int64_t seconds;
+			lggr::LogLevel level;
+			if (parseEventStart (line, seconds, level))
+			{
+				startsWithEvent = startsWithEvent || line.data() == log.data() + entry.offset;
+				events++;
+				levelMask |= lggr::levelBit (level);
+				inTime = inTime && seconds >= entry.firstTimestampNs / 1'000'000'000
+				      && seconds <= entry.lastTimestampNs / 1'000'000'000;
+			}
+			block.remove_prefix (line.size());
+		}
+		ok = ok && startsWithEvent && events == entry.eventCount && levelMask == entry.levelMask && inTime;
+		indexedEvents += events;
+		offset = entry.endOffset;
+	}
+	return ok && index.getIndexedEnd() == offset;
+}
+
+//-------------- Scenarios ----------------
+
+// Each level in turn. Some texts are bigger than the file buffer, some have line breaks
+static lggr::EventContainer makeEvent (int number)
+{
+	lggr::EventContainer event (static_cast<lggr::LogLevel> (number % 6));
+	event.timePoint = START + std::chrono::milliseconds (500) * number;
+	event.date      = formatSeconds (event.timePoint) + " UTC";
+	event.event     = "event " + std::to_string (number);
+	if (number % 97 == 0)
+	{
+		event.event += ' ' + std::string (lggr::DEFAULTS::FILE_BUFFER_SIZE + 100, 'x');
+	}
+	else if (number % 31 == 0)
+	{
+		event.event += "\n  continued\n  and continued";
+	}
+	return event;
+}
+
+static void indexAndQuery (lggr::SinkMode mode)
+{
+	constexpr int EVENTS         = 1000;    // 600 the first day, and 400 the next one
+	constexpr int INDEX_INTERVAL = 15;    // 7.5 s: some blocks start in the middle of a second
+	std::string name = (mode == lggr::SinkMode::INLINE) ? "inline" : "async";
+	fs::path dir     = fs::temp_directory_path() / ("lggrIndexTest-" + name + "-" + std::to_string (getpid()));
+	fs::remove_all (dir);
+	fs::create_directories (dir);
+
+	auto sink = std::make_unique<lggr::FileSink> (lggr::LL::TRACE, "index_%d.log", mode);
+	sink->setOutPath (dir.string());
+	sink->setIndexInterval (INDEX_INTERVAL);
+
+	// A batch each 50 events (one by one if inline)
+	auto writeEvents = [&] (int from, int to) {
+		for (int i = from; i < to; i++)
+		{
+			sink->submit (makeEvent (i));
+			if (i % 50 == 49)
+			{
+				sink->drain (std::chrono::steady_clock::now() + std::chrono::seconds (60));
+			}
+		}
+		sink->drain (std::chrono::steady_clock::now() + std::chrono::seconds (60));
+	};
+
+	// Two runs: the file is closed (drained) after each one, and appended by the next one
+	writeEvents (0, EVENTS / 2);
+	writeEvents (EVENTS / 2, EVENTS);
+	sink.reset();
+
+	fs::path firstFile = dir / "index_2024-04-17.log";
+	fs::path nextFile  = dir / "index_2024-04-18.log";
+	std::size_t firstEvents = 0;
+	std::size_t nextEvents  = 0;
+	bool indexed            = checkIndex (firstFile, firstEvents);
+	indexed                 = checkIndex (nextFile, nextEvents) && indexed;
+	check (indexed,
+	       name + ": the blocks of the index start and end at the start of an event, and describe its events");
+	check (firstEvents == 600 && nextEvents == 400, name + ": the rotation splits the events by day, all indexed");
+	check (sameAsScan (firstFile, name + " first day") && sameAsScan (nextFile, name + " next day"),
+	       name + ": logquery finds the same lines as a linear scan");
+
+	fs::remove_all (dir);
+}
+
+// The events after the last block are not indexed: logquery scans them
+static void notIndexedTail()
+{
+	fs::path dir = fs::temp_directory_path() / ("lggrIndexTest-tail-" + std::to_string (getpid()));
+	fs::remove_all (dir);
+	fs::create_directories (dir);
+
+	lggr::FileSink sink (lggr::LL::TRACE, "tail_%d.log");
+	sink.setOutPath (dir.string());
+	sink.setIndexInterval (64);
+	for (int i = 600; i < 900; i++)
+	{
+		sink.submit (makeEvent (i));
+	}
+
+	// The buffer written, but not the pending block of the index
+	sink.flushOnCrash();
+	fs::path logFile = dir / "tail_2024-04-18.log";
+	std::size_t indexedEvents = 0;
+	bool indexed              = checkIndex (logFile, indexedEvents);
+	check (indexed && indexedEvents == 256,
+	       "tail: only the complete blocks are indexed (" + std::to_string (indexedEvents) + " events)");
+	check (sameAsScan (logFile, "tail"), "tail: logquery finds the not indexed events too");
+
+	fs::remove_all (dir);
+}
+
+int main (int, char *argv [])
+{
+	toolsDir = fs::path (argv [0]).parent_path().parent_path().string();
+
+	runScenario ("inline sink", [] { indexAndQuery (lggr::SinkMode::INLINE); });
+	runScenario ("async sink", [] { indexAndQuery (lggr::SinkMode::ASYNC); });
+	runScenario ("not indexed tail", notIndexedTail);
+
+	return testsResult();
+}
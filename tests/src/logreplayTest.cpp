@@ -0,0 +1,207 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The round trip of logreplay (built with the tests): the text of the TextFormatter, converted to JSON Lines, must be
+// what the JsonLinesFormatter writes for the same events. With the timed events, the sample rate, the thread, the
+// context, typed fields and multi-line texts, in a file of several chunks
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerContext.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+namespace fs   = std::filesystem;
+
+static std::string toolsDir;    // Where logreplay is: the parent of the tests directory
+
+static const std::string THREAD_NAME = "replay-main";
+
+static std::string readFile (const fs::path &path)
+{
+	std::ifstream in (path, std::ios::binary);
+	return std::string (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char>());
+}
+
+static bool writeFile (const fs::path &path, const std::string &content)
+{
+	std::ofstream out (path, std::ios::binary);
+	out << content;
+	return out.good();
+}
+
+static std::string formatted (const lggr::LogFormatter &formatter, const lggr::EventContainer &event)
+{
+	std::string out;
+	formatter.format (event, out);
+	return out;
+}
+
+//-------------- Events ----------------
+
+static std::string formatSeconds (lggr::TimePoint timePoint)
+{
+	std::time_t seconds = std::chrono::system_clock::to_time_t (timePoint);
+	struct tm buf;
+	gmtime_r (&seconds, &buf);
+	char text [32];
+	return std::string (text, strftime (text, sizeof (text), "%F %T", &buf));
+}
+
+// Each kind of event in turn. The dates as the logger writes them: with nanoseconds (std::format) or in seconds
+static lggr::EventContainer makeEvent (int number)
+{
+	using namespace std::chrono;
+	lggr::EventContainer event (static_cast<lggr::LogLevel> (number % 6));
+	sys_seconds second = sys_days {year {2024} / 4 / 17} + hours (15) + seconds (number / 10);
+	if (number % 2 == 0)
+	{
+		std::string fraction = std::to_string (212848900 + number % 10);
+		event.timePoint      = second + nanoseconds (212848900 + number % 10);
+		event.date           = formatSeconds (second) + "." + fraction;
+	}
+	else
+	{
+		event.timePoint = second;
+		event.date      = formatSeconds (second) + " UTC";
+	}
+	event.event = "event " + std::to_string (number) + " with \"quotes\" and a\\backslash";
+
+	switch (number % 8)
+	{
+	case 1:
+		event.eventType    = lggr::EVENT_TYPE_TIMED_FINISHED;
+		event.usedTimeTxt  = "1\" 500ms";
+		event.endTimePoint = event.timePoint + milliseconds (1500);
+		break;
+	case 2: event.sampleRate = 10; break;
+	case 3: event.threadIndex = lggr::getThreadIndex(); break;
+	case 4:
+	{
+		auto context = std::make_shared<lggr::LogContext> ("req-" + std::to_string (number), "span-7");
+		context->with ("tenant", std::string_view ("acme"));
+		event.context = std::move (context);
+		event.fields.add ("count", number);
+		event.fields.add ("ratio", 2.5);
+		event.fields.add ("ok", true);
+		event.fields.add ("user", std::string_view ("bob"));
+		break;
+	}
+	case 5: event.context = std::make_shared<lggr::LogContext> ("req-" + std::to_string (number)); break;
+	case 6: event.event += "\n  at line two\n  and three"; break;
+	case 7:
+		event.threadIndex = lggr::getThreadIndex();
+		event.sampleRate  = 4;
+		event.context     = std::make_shared<lggr::LogContext> ("req-" + std::to_string (number));
+		event.fields.add ("bytes", std::uint64_t {1} << 40);
+		break;
+	}
+	return event;
+}
+
+// The names of the threads are not known by logreplay (other process): the name is kept as the last field
+static std::string expectedJson (const lggr::JsonLinesFormatter &json, const lggr::EventContainer &event)
+{
+	std::string line        = formatted (json, event);
+	const std::string name  = ",\"thread_name\":\"" + THREAD_NAME + "\"";
+	const std::string field = "\"thread_name\":\"" + THREAD_NAME + "\"";
+	std::size_t pos         = line.find (name);
+	if (pos == std::string::npos)
+	{
+		return line;
+	}
+	line.erase (pos, name.size());
+	line.pop_back();
+	if (line.back() == '}')
+	{
+		line.pop_back();
+		line += "," + field + "}}";
+	}
+	else
+	{
+		line += ",\"fields\":{" + field + "}}";
+	}
+	return line;
+}
+
+// The line of the first difference
+static std::string firstDifference (const std::string &found, const std::string &expected)
+{
+	if (found == expected)
+	{
+		return {};
+	}
+	std::size_t same = 0;
+	while (same < found.size() && same < expected.size() && found [same] == expected [same])
+	{
+		same++;
+	}
+	std::size_t lineStart = (same == 0) ? 0 : expected.rfind ('\n', same - 1) + 1;
+	return " (first difference in: " + expected.substr (lineStart, expected.find ('\n', same) - lineStart) + ")";
+}
+
+//-------------- Scenarios ----------------
+
+static void roundTrip()
+{
+	constexpr int EVENTS = 100000;    // About 10 MB: several chunks of the pool
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	lggr::Config::setThreadName (THREAD_NAME);
+
+	lggr::TextFormatter text (true);
+	lggr::JsonLinesFormatter json;
+	std::string textLog;
+	std::string expected;
+	for (int i = 0; i < EVENTS; i++)
+	{
+		lggr::EventContainer event = makeEvent (i);
+		textLog += formatted (text, event) + '\n';
+		expected += expectedJson (json, event) + '\n';
+	}
+
+	fs::path dir = fs::temp_directory_path() / ("lggrReplayTest-" + std::to_string (getpid()));
+	fs::remove_all (dir);
+	fs::create_directories (dir);
+	fs::path input = dir / "events.log";
+	check (writeFile (input, textLog) && textLog.size() > 8 * 1024 * 1024, "round trip: the text log is written");
+
+	for (const char *threads : {"1", "4"})
+	{
+		fs::path output     = dir / (std::string ("events-") + threads + ".json");
+		std::string command = toolsDir + "/logreplay '" + input.string() + "' -f json -j " + threads + " -o '"
+		                    + output.string() + "'";
+		check (std::system (command.c_str()) == 0, std::string ("round trip: logreplay -j ") + threads + " runs");
+
+		std::string replayed = readFile (output);
+		check (replayed == expected, std::string ("round trip: -j ") + threads + ", the JSON of the events"
+		                                 + firstDifference (replayed, expected));
+	}
+
+	fs::remove_all (dir);
+}
+
+int main (int, char *argv [])
+{
+	toolsDir = fs::path (argv [0]).parent_path().parent_path().string();
+
+	runScenario ("round trip", roundTrip);
+
+	return testsResult();
+}
@@ -0,0 +1,212 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// A sink wich falls behind: the overload shedding (a level more each interval, restored one each interval with a
+// summary of the shed events), and the bounded queue of the async sinks. Each scenario runs in its own process
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Async: its writes wait while it's blocked
+class BlockableSink : public lggr::LogSink
+{
+	public:
+		struct Written
+		{
+				lggr::LogLevel level;
+				std::string text;
+		};
+
+		std::atomic<bool> blocked {true};
+		std::mutex mtx;
+		std::vector<Written> written;
+
+		BlockableSink()
+		    : LogSink (lggr::LL::TRACE, lggr::SinkMode::ASYNC)
+		{
+		}
+
+		~BlockableSink()
+		{
+			this->blocked = false;
+			this->stopWorker();
+		}
+
+		using LogSink::setQueueLimit;
+
+		// The events of this level with this text
+		int count (lggr::LogLevel level, const std::string &text)
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			int found = 0;
+			for (auto &event : this->written)
+			{
+				found += (event.level == level && event.text == text) ? 1 : 0;
+			}
+			return found;
+		}
+
+		std::vector<std::string> startingWith (const std::string &prefix)
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			std::vector<std::string> found;
+			for (auto &event : this->written)
+			{
+				if (event.text.starts_with (prefix))
+				{
+					found.push_back (event.text);
+				}
+			}
+			return found;
+		}
+
+		void waitWritten ()
+		{
+			while (this->getQueueDepth() != 0)
+			{
+				std::this_thread::sleep_for (std::chrono::milliseconds (1));
+			}
+		}
+
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			while (this->blocked)
+			{
+				std::this_thread::sleep_for (std::chrono::milliseconds (1));
+			}
+			std::lock_guard<std::mutex> lock (this->mtx);
+			this->written.push_back ({event.logLevel, event.event});
+		}
+};
+
+static std::shared_ptr<BlockableSink> addBlockedSink()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<BlockableSink>();
+	lggr::Config::addSink (sink);
+	return sink;
+}
+
+static void logMany (lggr::StaticLogger &logger, const std::string &text, int events = 10)
+{
+	for (int i = 0; i < events; i++)
+	{
+		logger << text;
+	}
+}
+
+// The sinks are checked by the next event after each interval (WARN: never shed)
+static void nextInterval()
+{
+	std::this_thread::sleep_for (lggr::DEFAULTS::OVERLOAD_INTERVAL + std::chrono::milliseconds (20));
+	lggr::warn << "next interval";
+}
+
+//-------------- Overload shedding ----------------
+
+static void shedAndRestore()
+{
+	auto sink = addBlockedSink();
+	lggr::Config::setOverloadShedding (100, std::chrono::seconds (10));
+
+	// Behind: a level more each interval
+	logMany (lggr::info, "flood", 200);
+	nextInterval();
+	logMany (lggr::trace, "shed 1");
+	logMany (lggr::debug, "shed 1");
+	nextInterval();
+	logMany (lggr::trace, "shed 2");
+	logMany (lggr::debug, "shed 2");
+	logMany (lggr::info, "shed 2");
+	nextInterval();
+	logMany (lggr::info, "shed 3");
+	nextInterval();
+
+	// Caught up: a level less each interval
+	sink->blocked = false;
+	sink->waitWritten();
+	nextInterval();
+	logMany (lggr::debug, "restored 1");
+	logMany (lggr::info, "restored 1");
+	nextInterval();
+	logMany (lggr::trace, "restored 2");
+	logMany (lggr::debug, "restored 2");
+	nextInterval();
+	logMany (lggr::trace, "restored 3");
+	nextInterval();
+	sink->waitWritten();
+
+	check (sink->count (lggr::LL::INFO, "flood") == 200, "shedding: the events before it are written");
+	check (sink->count (lggr::LL::TRACE, "shed 1") == 0 && sink->count (lggr::LL::DEBUG, "shed 1") == 10,
+	       "shedding: first TRACE");
+	check (sink->count (lggr::LL::TRACE, "shed 2") == 0 && sink->count (lggr::LL::DEBUG, "shed 2") == 0
+	           && sink->count (lggr::LL::INFO, "shed 2") == 10,
+	       "shedding: then DEBUG");
+	check (sink->count (lggr::LL::INFO, "shed 3") == 0, "shedding: then INFO");
+	check (sink->count (lggr::LL::DEBUG, "restored 1") == 0 && sink->count (lggr::LL::INFO, "restored 1") == 10,
+	       "restoring: first INFO");
+	check (sink->count (lggr::LL::TRACE, "restored 2") == 0 && sink->count (lggr::LL::DEBUG, "restored 2") == 10,
+	       "restoring: then DEBUG");
+	check (sink->count (lggr::LL::TRACE, "restored 3") == 10, "restoring: then TRACE");
+
+	// One summary each restored level, with the events shed since the previous one
+	auto summaries = sink->startingWith ("Overload: ");
+	check (summaries.size() == 3, "summaries: one each restored level (" + std::to_string (summaries.size()) + ")");
+	if (summaries.size() == 3)
+	{
+		check (summaries [0].starts_with ("Overload: shed 20 TRACE, 10 DEBUG, 10 INFO events in ")
+		           && summaries [0].ends_with ("; the events below INFO are still shed"),
+		       "summaries: the shed events while behind");
+		check (summaries [1].starts_with ("Overload: shed 10 DEBUG events in ")
+		           && summaries [1].ends_with ("; the events below DEBUG are still shed"),
+		       "summaries: the ones shed since the previous summary");
+		check (summaries [2].starts_with ("Overload: shed 10 TRACE events in ")
+		           && summaries [2].ends_with (", as the outputs were behind"),
+		       "summaries: the last one, once restored");
+	}
+}
+
+//-------------- Bounded queue ----------------
+
+static void boundedQueue()
+{
+	auto sink = addBlockedSink();
+	sink->setQueueLimit (50);
+
+	logMany (lggr::info, "queued", 100);
+	check (sink->getQueueDepth() == 50, "queue: no more than its limit");
+	check (sink->getQueueDropped() == 50, "queue: the events beyond it are dropped and counted");
+
+	sink->blocked = false;
+	sink->waitWritten();
+	lggr::info << "after";
+	sink->waitWritten();
+
+	check (sink->count (lggr::LL::INFO, "queued") == 50 && sink->count (lggr::LL::INFO, "after") == 1,
+	       "queue: the queued events are written");
+	check (sink->count (lggr::LL::ERROR, "Sink queue full: 50 events dropped") == 1, "queue: the drops are reported");
+}
+
+int main()
+{
+	runScenario ("shed and restore", shedAndRestore);
+	runScenario ("bounded queue", boundedQueue);
+
+	return testsResult();
+}
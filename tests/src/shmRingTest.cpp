@@ -0,0 +1,250 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The shared memory ring: the events read by other process, the wrap-around of the slots, the events dropped when
+// the ring is full, several producers, and a reader of a ring wich is created again. Each scenario runs in its own
+// process
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerShmRing.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Each scenario its own ring
+static std::string ringName (const std::string &scenario)
+{
+	return "/lggrTest-" + scenario + "-" + std::to_string (getpid());
+}
+
+static lggr::EventContainer makeEvent (lggr::LogLevel level, const std::string &text)
+{
+	lggr::EventContainer event (level);
+	event.event     = text;
+	event.timePoint = std::chrono::system_clock::now();
+	return event;
+}
+
+// The texts of the events in the ring
+static std::vector<std::string> readAll (lggr::ShmRingReader &reader)
+{
+	std::vector<std::string> texts;
+	lggr::ShmEvent event;
+	std::string buffer;
+	while (reader.read (event, buffer))
+	{
+		texts.emplace_back (event.text);
+	}
+	return texts;
+}
+
+//-------------- Scenarios ----------------
+
+// Written in this process, read in other one
+static void roundTrip()
+{
+	std::string name = ringName ("roundTrip");
+	lggr::ShmRingSink sink (name, lggr::LL::TRACE, 128, 8);
+	check (sink.isOpen(), "round trip: the ring is created");
+
+	lggr::EventContainer normal = makeEvent (lggr::LL::WARN, "disk almost full");
+	lggr::EventContainer timed  = makeEvent (lggr::LL::INFO, "query");
+	timed.eventType             = lggr::EVENT_TYPE_TIMED_FINISHED;
+	timed.endTimePoint          = timed.timePoint + std::chrono::microseconds (1500);
+	lggr::EventContainer big    = makeEvent (lggr::LL::ERROR, std::string (500, 'x'));
+	sink.submit (normal);
+	sink.submit (timed);
+	sink.submit (big);
+	sink.submit (makeEvent (lggr::LL::DEBUG, ""));
+
+	auto nsOf = [] (lggr::TimePoint tp) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (tp.time_since_epoch()).count();
+	};
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		// The consumer: no shared state but the segment
+		lggr::ShmRingReader reader (name);
+		lggr::ShmEvent event;
+		std::string buffer;
+		bool ok = reader.open();
+		ok      = ok && reader.read (event, buffer) && event.text == "disk almost full"
+		     && event.logLevel == lggr::LL::WARN && event.timestampNs == nsOf (normal.timePoint)
+		     && event.durationNs == 0 && !event.truncated;
+		ok = ok && reader.read (event, buffer) && event.text == "query"
+		     && event.eventType == lggr::EVENT_TYPE_TIMED_FINISHED && event.durationNs == 1500000;
+		ok = ok && reader.read (event, buffer) && event.truncated && event.logLevel == lggr::LL::ERROR
+		     && event.text == std::string (128 - sizeof (lggr::ShmSlotHeader), 'x');
+		ok = ok && reader.read (event, buffer) && event.text.empty();
+		ok = ok && !reader.read (event, buffer) && reader.getDropped() == 0;
+		_exit (ok ? 0 : 1);
+	}
+	check (waitChild (pid), "round trip: other process reads the events, its fields, and the truncated text");
+
+	// The consumer released the slots
+	lggr::ShmRingReader reader (name);
+	check (reader.open() && readAll (reader).empty(), "round trip: the read events are not read again");
+	shm_unlink (name.c_str());
+}
+
+static void wrapAround()
+{
+	std::string name = ringName ("wrap");
+	lggr::ShmRingSink sink (name, lggr::LL::TRACE, 64, 8);
+	lggr::ShmRingReader reader (name);
+	check (reader.open(), "wrap-around: the reader opens the ring");
+
+	// 100 laps of 5 events in 8 slots: each lap starts in other slot
+	bool inOrder = true;
+	int next     = 0;
+	for (int lap = 0; lap < 100; lap++)
+	{
+		for (int i = 0; i < 5; i++)
+		{
+			sink.submit (makeEvent (lggr::LL::INFO, std::to_string (lap * 5 + i)));
+		}
+		for (auto &text : readAll (reader))
+		{
+			inOrder = inOrder && text == std::to_string (next++);
+		}
+	}
+	check (inOrder && next == 500, "wrap-around: all the events, in order");
+	check (sink.getDropped() == 0, "wrap-around: none dropped");
+	shm_unlink (name.c_str());
+}
+
+static void fullRing()
+{
+	std::string name = ringName ("full");
+	lggr::ShmRingSink sink (name, lggr::LL::TRACE, 64, 8);
+	lggr::ShmRingReader reader (name);
+	reader.open();
+
+	for (int i = 0; i < 20; i++)
+	{
+		sink.submit (makeEvent (lggr::LL::INFO, std::to_string (i)));
+	}
+	check (sink.getDropped() == 12 && reader.getDropped() == 12, "full: the events beyond the slots are dropped");
+
+	auto texts = readAll (reader);
+	check (texts.size() == 8 && texts.front() == "0" && texts.back() == "7", "full: the oldest ones are kept");
+
+	// Room again
+	sink.submit (makeEvent (lggr::LL::INFO, "after"));
+	texts = readAll (reader);
+	check (texts.size() == 1 && texts [0] == "after" && sink.getDropped() == 12, "full: written again once read");
+	shm_unlink (name.c_str());
+}
+
+// Several threads log while the consumer reads: each event is read or counted as dropped, in the order of its thread
+static void manyProducers()
+{
+	constexpr int THREADS = 4;
+	constexpr int EVENTS  = 5000;
+	std::string name      = ringName ("mpsc");
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<lggr::ShmRingSink> (name, lggr::LL::INFO, 64, 256);
+	lggr::Config::addSink (sink);
+
+	lggr::ShmRingReader reader (name);
+	reader.open();
+	std::atomic<int> finished {0};
+	std::vector<std::thread> producers;
+	for (int t = 0; t < THREADS; t++)
+	{
+		producers.emplace_back ([t, &finished] {
+			for (int i = 0; i < EVENTS; i++)
+			{
+				lggr::info.log ("{} {}", t, i);
+				if (i % 16 == 0)
+				{
+					std::this_thread::yield();    // Let the consumer read: some events read, some dropped
+				}
+			}
+			finished++;
+		});
+	}
+
+	std::vector<int> last (THREADS, -1);
+	std::size_t read = 0;
+	bool ordered     = true;
+	bool done        = false;
+	while (!done)
+	{
+		done = finished == THREADS;    // Then, the last read
+		for (auto &text : readAll (reader))
+		{
+			int thread    = std::stoi (text);
+			int number    = std::stoi (text.substr (text.find (' ') + 1));
+			ordered       = ordered && thread >= 0 && thread < THREADS && number > last [thread];
+			last [thread] = number;
+			read++;
+		}
+	}
+	for (auto &producer : producers)
+	{
+		producer.join();
+	}
+
+	check (read + sink->getDropped() == THREADS * EVENTS, "many producers: each event read or dropped ("
+	                                                          + std::to_string (read) + " read, "
+	                                                          + std::to_string (sink->getDropped()) + " dropped)");
+	check (ordered, "many producers: the events of each thread in order");
+	shm_unlink (name.c_str());
+}
+
+// The producer is restarted: the reader of the old ring notices it, and opens the new one
+static void reopen()
+{
+	std::string name = ringName ("reopen");
+	auto sink        = std::make_unique<lggr::ShmRingSink> (name, lggr::LL::TRACE, 64, 8);
+	lggr::ShmRingReader reader (name);
+	check (reader.open() && !reader.isStale(), "reopen: the current ring is not stale");
+
+	sink->submit (makeEvent (lggr::LL::INFO, "old"));
+	sink.reset();
+	shm_unlink (name.c_str());
+	check (!reader.isStale(), "reopen: no new ring yet");
+	auto texts = readAll (reader);
+	check (texts.size() == 1 && texts [0] == "old", "reopen: the unlinked ring is still read through its mapping");
+
+	lggr::ShmRingReader late (name);
+	check (!late.open(), "reopen: a removed ring can't be opened");
+
+	sink = std::make_unique<lggr::ShmRingSink> (name, lggr::LL::TRACE, 64, 8);
+	sink->submit (makeEvent (lggr::LL::INFO, "new"));
+	check (reader.isStale() && readAll (reader).empty(), "reopen: the new ring is detected, the old one is empty");
+	reader.close();
+	check (reader.open() && !reader.isStale(), "reopen: the new ring is opened");
+	texts = readAll (reader);
+	check (texts.size() == 1 && texts [0] == "new", "reopen: its events are read");
+	shm_unlink (name.c_str());
+}
+
+int main()
+{
+	runScenario ("round trip", roundTrip);
+	runScenario ("wrap-around", wrapAround);
+	runScenario ("full ring", fullRing);
+	runScenario ("many producers", manyProducers);
+	runScenario ("reopen", reopen);
+
+	return testsResult();
+}
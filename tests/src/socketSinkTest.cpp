@@ -0,0 +1,355 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// UnixSocketSink against a local agent: the framing, the reconnection when the agent restarts, and the spilled and
+// dropped events. Each scenario runs in its own process
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSocketSink.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+/**
+ * The local agent: a thread wich receives the frames, and keeps its lines
+ * A frame must have whole lines, and be no bigger than the frame size (but if it has a single line)
+ */
+class TestAgent
+{
+	private:
+		const std::string path;
+		const lggr::SocketType type;
+		int fd = -1;
+		std::atomic<bool> stopping {false};
+		std::thread thread;
+
+		std::mutex mtx;
+		std::vector<std::string> lines;
+		int frames    = 0;
+		bool framesOk = true;
+
+		void addFrame (const std::string &frame)
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			this->frames++;
+			std::size_t start = 0;
+			std::size_t count = 0;
+			std::size_t end;
+			while ((end = frame.find ('\n', start)) != std::string::npos)
+			{
+				this->lines.push_back (frame.substr (start, end - start));
+				start = end + 1;
+				count++;
+			}
+			bool tooBig = frame.size() > lggr::DEFAULTS::SOCKET_FRAME_SIZE && count > 1;
+			if (frame.empty() || start != frame.size() || tooBig)
+			{
+				this->framesOk = false;
+			}
+		}
+
+		// Stream: a 32 bits big endian length, and the frame. A partial frame of a closed connection is discarded
+		void receiveStream ()
+		{
+			int client = -1;
+			std::string pending;
+			char buffer [64 * 1024];
+			while (!this->stopping.load())
+			{
+				pollfd pfd {(client >= 0) ? client : this->fd, POLLIN, 0};
+				if (poll (&pfd, 1, 20) <= 0)
+				{
+					continue;
+				}
+				if (client < 0)
+				{
+					client = accept (this->fd, nullptr, nullptr);
+					pending.clear();
+					continue;
+				}
+
+				ssize_t received = recv (client, buffer, sizeof (buffer), 0);
+				if (received <= 0)
+				{
+					::close (client);
+					client = -1;
+					continue;
+				}
+				pending.append (buffer, static_cast<std::size_t> (received));
+
+				while (pending.size() >= 4)
+				{
+					auto byte       = [&] (int i) { return std::uint32_t {static_cast<unsigned char> (pending [i])}; };
+					std::size_t len = (byte (0) << 24) | (byte (1) << 16) | (byte (2) << 8) | byte (3);
+					if (pending.size() < 4 + len)
+					{
+						break;
+					}
+					this->addFrame (pending.substr (4, len));
+					pending.erase (0, 4 + len);
+				}
+			}
+			if (client >= 0)
+			{
+				::close (client);
+			}
+		}
+
+		// Datagram: each one is a frame
+		void receiveDatagrams ()
+		{
+			std::vector<char> buffer (1024 * 1024);
+			while (!this->stopping.load())
+			{
+				pollfd pfd {this->fd, POLLIN, 0};
+				if (poll (&pfd, 1, 20) <= 0)
+				{
+					continue;
+				}
+				ssize_t received = recv (this->fd, buffer.data(), buffer.size(), 0);
+				if (received > 0)
+				{
+					this->addFrame (std::string (buffer.data(), static_cast<std::size_t> (received)));
+				}
+			}
+		}
+
+	public:
+		TestAgent (const std::string &path, lggr::SocketType type)
+		    : path (path)
+		    , type (type)
+		{
+			std::remove (path.c_str());
+			sockaddr_un addr {};
+			addr.sun_family = AF_UNIX;
+			path.copy (addr.sun_path, sizeof (addr.sun_path) - 1);
+
+			bool stream = type == lggr::SocketType::STREAM;
+			this->fd    = socket (AF_UNIX, stream ? SOCK_STREAM : SOCK_DGRAM, 0);
+			bool ready  = bind (this->fd, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) == 0;
+			ready       = ready && (!stream || listen (this->fd, 4) == 0);
+			check (ready, "agent: listening on " + path);
+
+			this->thread = std::thread (stream ? &TestAgent::receiveStream : &TestAgent::receiveDatagrams, this);
+		}
+
+		~TestAgent()
+		{
+			this->stop();
+		}
+
+		// Closes the connection and the socket, as a crashed agent
+		void stop ()
+		{
+			if (this->thread.joinable())
+			{
+				this->stopping = true;
+				this->thread.join();
+				::close (this->fd);
+				std::remove (this->path.c_str());
+			}
+		}
+
+		std::vector<std::string> getLines ()
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			return this->lines;
+		}
+
+		int getFrames ()
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			return this->frames;
+		}
+
+		bool areFramesOk ()
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			return this->framesOk;
+		}
+
+		// Waits (up to some seconds) for a line with the text
+		bool waitFor (const std::string &text)
+		{
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds (10);
+			while (std::chrono::steady_clock::now() < deadline)
+			{
+				for (auto &line : this->getLines())
+				{
+					if (line.find (text) != std::string::npos)
+					{
+						return true;
+					}
+				}
+				std::this_thread::sleep_for (std::chrono::milliseconds (10));
+			}
+			return false;
+		}
+};
+
+// Are the lines these events, in order? The events are "msg:<prefix> <first>;" to "msg:<prefix> <last>;"
+static bool hasEvents (const std::vector<std::string> &lines, std::size_t from, const std::string &prefix, int first,
+                       int last)
+{
+	for (int i = first; i <= last; i++, from++)
+	{
+		std::string text = "msg:" + prefix + " " + std::to_string (i) + ";";
+		if (from >= lines.size() || lines [from].find (text) == std::string::npos)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static std::shared_ptr<lggr::UnixSocketSink> addSocketSink (const std::string &path, lggr::SocketType type,
+                                                             std::size_t maxSpillBytes)
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<lggr::UnixSocketSink> (path, lggr::LL::TRACE, type, maxSpillBytes);
+	lggr::Config::addSink (sink);
+	return sink;
+}
+
+//-------------- Framing ----------------
+
+static void framing (const std::string &name, lggr::SocketType type)
+{
+	constexpr int EVENTS = 3000;
+	std::string path     = "/tmp/lggrSocketTest_" + name + ".sock";
+	TestAgent agent (path, type);
+	auto sink = addSocketSink (path, type, lggr::DEFAULTS::SOCKET_SPILL_SIZE);
+
+	for (int i = 0; i < EVENTS; i++)
+	{
+		lggr::info.log ("msg:frame {};", i);
+	}
+	check (agent.waitFor ("msg:frame " + std::to_string (EVENTS - 1) + ";"), name + ": the agent gets the events");
+	check (hasEvents (agent.getLines(), 0, "frame", 0, EVENTS - 1), name + ": each event once, in order");
+	check (agent.areFramesOk(), name + ": each frame has whole lines, up to the frame size");
+	check (agent.getFrames() < EVENTS, name + ": the events are packed in frames");
+	check (sink->isConnected() && sink->getDropped() == 0, name + ": connected, and nothing dropped");
+}
+
+//-------------- Agent restart ----------------
+
+static void reconnect()
+{
+	std::string path = "/tmp/lggrSocketTest_reconnect.sock";
+	auto agent       = std::make_unique<TestAgent> (path, lggr::SocketType::STREAM);
+	auto sink        = addSocketSink (path, lggr::SocketType::STREAM, lggr::DEFAULTS::SOCKET_SPILL_SIZE);
+
+	for (int i = 0; i < 100; i++)
+	{
+		lggr::info.log ("msg:before {};", i);
+	}
+	check (agent->waitFor ("msg:before 99;"), "reconnect: the first agent gets the events");
+	agent->stop();
+
+	// Spilled while the agent is down
+	for (int i = 0; i < 100; i++)
+	{
+		lggr::info.log ("msg:down {};", i);
+	}
+	check (sink->drain (std::chrono::steady_clock::now() + std::chrono::seconds (5)), "reconnect: the sink drains");
+	check (!sink->isConnected(), "reconnect: the sink notices the agent is down");
+
+	agent = std::make_unique<TestAgent> (path, lggr::SocketType::STREAM);
+	for (int i = 0; i < 100; i++)
+	{
+		lggr::info.log ("msg:after {};", i);
+	}
+	check (agent->waitFor ("msg:after 99;"), "reconnect: the restarted agent gets the events");
+
+	auto lines = agent->getLines();
+	check (lines.size() == 200 && hasEvents (lines, 0, "down", 0, 99) && hasEvents (lines, 100, "after", 0, 99),
+	       "reconnect: the spilled events first, and then the new ones, once");
+	check (sink->isConnected() && sink->getDropped() == 0, "reconnect: connected, and nothing dropped");
+}
+
+//-------------- Spill and drops ----------------
+
+static void spillDrops()
+{
+	constexpr int EVENTS        = 500;
+	constexpr std::size_t SPILL = 8 * 1024;
+	std::string path            = "/tmp/lggrSocketTest_spill.sock";
+	std::remove (path.c_str());
+	auto sink = addSocketSink (path, lggr::SocketType::STREAM, SPILL);
+
+	// No agent: the spill keeps the newest ones
+	for (int i = 0; i < EVENTS; i++)
+	{
+		lggr::info.log ("msg:spill {};", i);
+		std::this_thread::sleep_for (std::chrono::microseconds (100));
+	}
+	check (sink->drain (std::chrono::steady_clock::now() + std::chrono::seconds (5)), "spill: the sink drains");
+	std::uint64_t dropped = sink->getDropped();
+	check (dropped > 0 && dropped < EVENTS, "spill: the oldest events are dropped beyond the spill size");
+
+	// The worker sends them when it reconnects (a new event could push out other one)
+	TestAgent agent (path, lggr::SocketType::STREAM);
+	check (agent.waitFor ("msg:spill 499;"), "spill: the agent gets them when it starts");
+
+	auto lines        = agent.getLines();
+	std::size_t bytes = 0;
+	for (auto &line : lines)
+	{
+		bytes += line.size() + 1;
+	}
+	check (lines.size() + dropped == EVENTS && sink->getDropped() == dropped,
+	       "spill: each event is sent or counted as dropped");
+	check (hasEvents (lines, 0, "spill", static_cast<int> (dropped), EVENTS - 1),
+	       "spill: the newest ones are sent, in order");
+	check (bytes <= SPILL, "spill: the spill is bounded");
+}
+
+// A datagram too big for the socket is dropped, and the next ones are sent
+static void oversizedDatagram()
+{
+	std::string path = "/tmp/lggrSocketTest_oversized.sock";
+	TestAgent agent (path, lggr::SocketType::DATAGRAM);
+	auto sink = addSocketSink (path, lggr::SocketType::DATAGRAM, lggr::DEFAULTS::SOCKET_SPILL_SIZE);
+
+	lggr::info.log ("msg:small 1;");
+	lggr::info.log ("msg:big {};", std::string (1024 * 1024, 'x'));
+	lggr::info.log ("msg:small 2;");
+	check (agent.waitFor ("msg:small 2;"), "oversized datagram: the next events are sent");
+
+	auto lines = agent.getLines();
+	check (lines.size() == 2 && hasEvents (lines, 0, "small", 1, 2), "oversized datagram: it is not sent");
+	check (sink->getDropped() == 1, "oversized datagram: it is counted as dropped");
+	check (sink->isConnected(), "oversized datagram: the sink stays connected");
+}
+
+int main()
+{
+	runScenario ("stream framing", [] { framing ("stream", lggr::SocketType::STREAM); });
+	runScenario ("datagram framing", [] { framing ("datagram", lggr::SocketType::DATAGRAM); });
+	runScenario ("reconnect", reconnect);
+	runScenario ("spill", spillDrops);
+	runScenario ("oversized datagram", oversizedDatagram);
+
+	return testsResult();
+}
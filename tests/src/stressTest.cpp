@@ -0,0 +1,427 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// Concurrency stress: many threads use the public entry points (the loggers, the channels, the timed events
+// finished by other thread, pull, push, scoped buffers and contexts) while other thread changes the configuration
+// (and the formatters of the checking sinks). Checking sinks verify that no event is lost, the order of the events
+// of each thread, the stack bounds and that each timed event starts once and finishes once, after starting.
+// The operations are chosen by a seeded generator: stressTest [operations per thread] [seed]
+// Build it with the sanitizers to find races: make StressTest SANITIZE=thread (or address)
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerBuffer.h"
+#include "StreamLoggerContext.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+constexpr int THREADS           = 6;
+constexpr int HANDOFF_MAX       = THREADS * 4;    // Timed events waiting for other thread to finish them
+constexpr unsigned int MAX_STACK = 200;
+
+// The numbers after the tag of the text: "s 3 17" (thread 3, sequence 17)
+static bool parseEvent (std::string_view text, std::string_view tag, std::uint64_t &thread, std::uint64_t &number)
+{
+	if (!text.starts_with (tag))
+	{
+		return false;
+	}
+	const char *pos = text.data() + tag.size();
+	const char *end = text.data() + text.size();
+	auto res        = std::from_chars (pos, end, thread);
+	if (res.ec != std::errc {} || res.ptr == end)
+	{
+		return false;
+	}
+	return std::from_chars (res.ptr + 1, end, number).ec == std::errc {};
+}
+
+/**
+ * Checks the events it receives: in order for each thread, and the timed ones paired
+ * Each event is also formatted, with the formatter wich the reconfiguring thread replaces
+ */
+class CheckingSink : public lggr::LogSink
+{
+	private:
+		std::mutex mtx;    // The worker writes, and the test reads at the end
+		std::map<std::uint64_t, std::uint8_t> timedStates;    // 1 started, 2 finished
+
+	public:
+		std::vector<std::uint64_t> nextSequence = std::vector<std::uint64_t> (THREADS, 0);
+		std::vector<std::uint32_t> threadIndexes = std::vector<std::uint32_t> (THREADS, 0);
+		std::uint64_t disordered  = 0;
+		std::uint64_t wrongThread = 0;
+		std::uint64_t badTimed    = 0;
+		std::uint64_t unknown     = 0;
+		std::uint64_t timedStarts = 0;
+		std::uint64_t timedFinish = 0;
+
+		CheckingSink (lggr::SinkMode mode)
+		    : LogSink (lggr::LL::TRACE, mode)
+		{
+		}
+
+		~CheckingSink()
+		{
+			this->stopWorker();
+		}
+
+		std::uint64_t getUnfinished ()
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			std::uint64_t unfinished = 0;
+			for (auto &timed : this->timedStates)
+			{
+				unfinished += (timed.second != 2) ? 1 : 0;
+			}
+			return unfinished;
+		}
+
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			std::string rendered;
+			std::string_view text = event.event;
+			if (event.deferred)
+			{
+				event.deferred->render (rendered);
+				text = rendered;
+			}
+			std::string line;
+			formatEvent (*this->getFormatter(), event, line);
+
+			std::lock_guard<std::mutex> lock (this->mtx);
+			if (line.find (text) == std::string::npos)
+			{
+				this->unknown++;
+				return;
+			}
+			std::uint64_t thread, number;
+			if (event.eventType & lggr::EVENT_TYPE_TIMED)
+			{
+				if (!parseEvent (text, "te ", thread, number) || thread >= THREADS)
+				{
+					this->unknown++;
+					return;
+				}
+				std::uint8_t &state = this->timedStates [(thread << 32) | number];
+				if (event.eventType == lggr::EVENT_TYPE_TIMED_RUNNING)
+				{
+					this->badTimed += (state != 0) ? 1 : 0;
+					state = 1;
+					this->timedStarts++;
+				}
+				else
+				{
+					this->badTimed += (state != 1) ? 1 : 0;
+					state = 2;
+					this->timedFinish++;
+				}
+			}
+			else if (parseEvent (text, "s ", thread, number) && thread < THREADS)
+			{
+				// Any gap, repetition or reordering breaks the sequence
+				this->disordered += (number != this->nextSequence [thread]) ? 1 : 0;
+				this->nextSequence [thread] = number + 1;
+			}
+			else
+			{
+				this->unknown++;
+				return;
+			}
+
+			// The same thread, the same index
+			std::uint32_t &index = this->threadIndexes [thread];
+			if (index == 0)
+			{
+				index = event.threadIndex;
+			}
+			this->wrongThread += (index != event.threadIndex) ? 1 : 0;
+		}
+};
+
+// Discards the events: only to be added and removed while logging
+class NullSink : public lggr::LogSink
+{
+	public:
+		NullSink()
+		    : LogSink (lggr::LL::INFO, lggr::SinkMode::ASYNC)
+		{
+		}
+
+		~NullSink()
+		{
+			this->stopWorker();
+		}
+
+	protected:
+		void write (const lggr::EventContainer &) override {}
+};
+
+class CountingSubscriber : public lggr::LogEventsSubscriber
+{
+	public:
+		std::atomic<std::uint64_t> events {0};
+
+		void onLogEvent (const std::string &, const std::string, const lggr::LogLevel) override
+		{
+			this->events++;
+		}
+};
+
+//-------------- The scenario ----------------
+
+struct Shared
+{
+		std::atomic<bool> stop {false};
+		std::atomic<std::uint64_t> maxPulled {0};
+
+		std::mutex handoffMtx;
+		std::deque<lggr::TimedEvent *> handoff;
+};
+
+static void finishOneHandoff (Shared &shared)
+{
+	lggr::TimedEvent *timed = nullptr;
+	{
+		std::lock_guard<std::mutex> lock (shared.handoffMtx);
+		if (!shared.handoff.empty())
+		{
+			timed = shared.handoff.front();
+			shared.handoff.pop_front();
+		}
+	}
+	delete timed;    // Finished by this thread
+}
+
+struct ThreadCounters
+{
+		std::uint64_t sequence        = 0;    // Default logger
+		std::uint64_t channelSequence = 0;
+		std::uint64_t timed           = 0;
+};
+
+static void logNormal (int t, std::uint64_t &sequence, lggr::StaticLogger &logger, std::mt19937 &random)
+{
+	switch (random() % 4)
+	{
+	case 0: logger << "s " << t << " " << sequence; break;
+	case 1: logger.log ("s {} {}", t, sequence); break;
+	case 2: logger.logDeferred ("s {} {}", t, sequence); break;
+	default: logger.with ("op", static_cast<int> (random() % 100)) << "s " << t << " " << sequence; break;
+	}
+	sequence++;
+}
+
+static void worker (int t, unsigned int seed, int operations, Shared &shared, lggr::Channel &channel,
+                    ThreadCounters &counters)
+{
+	std::mt19937 random (seed + t);
+	CountingSubscriber puller;
+
+	for (int op = 0; op < operations; op++)
+	{
+		switch (random() % 16)
+		{
+		case 0:
+		case 1:
+		{
+			// A timed event: finished here, or by other thread
+			auto *timed = new lggr::TimedEvent (lggr::info.startTimedEvent());
+			*timed << "te " << t << " " << counters.timed++;
+			if (random() % 2)
+			{
+				*timed << " appended";
+			}
+			bool handedOff = false;
+			{
+				std::lock_guard<std::mutex> lock (shared.handoffMtx);
+				if (shared.handoff.size() < HANDOFF_MAX)
+				{
+					shared.handoff.push_back (timed);
+					handedOff = true;
+				}
+			}
+			if (!handedOff)
+			{
+				delete timed;
+			}
+			break;
+		}
+		case 2: finishOneHandoff (shared); break;
+		case 3:
+		{
+			// The stack is bounded: its size plus the running timed events
+			puller.events = 0;
+			lggr::pullLogEvents (puller, lggr::LL::TRACE);
+			std::uint64_t pulled = puller.events;
+			std::uint64_t max    = shared.maxPulled.load();
+			while (pulled > max && !shared.maxPulled.compare_exchange_weak (max, pulled)) {}
+			break;
+		}
+		case 4:
+		{
+			// Nothing is captured (the checking sink wants every event), but the buffer is in the path
+			lggr::ScopedLogBuffer buffer;
+			logNormal (t, counters.sequence, lggr::debug, random);
+			logNormal (t, counters.sequence, lggr::info, random);
+			break;
+		}
+		case 5:
+		{
+			lggr::ScopedLogContext context (std::make_shared<lggr::LogContext> ("request", "span"));
+			logNormal (t, counters.sequence, lggr::info, random);
+			break;
+		}
+		case 6:
+		case 7:
+		case 8: logNormal (t, counters.channelSequence, channel.info, random); break;
+		default: logNormal (t, counters.sequence, (random() % 2) ? lggr::info : lggr::debug, random); break;
+		}
+
+		if (random() % 8 == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+static std::shared_ptr<const lggr::LogFormatter> randomFormatter (std::mt19937 &random)
+{
+	switch (random() % 3)
+	{
+	case 0: return std::make_shared<lggr::JsonLinesFormatter>();
+	case 1: return std::make_shared<lggr::LogfmtFormatter>();
+	default: return std::make_shared<lggr::TextFormatter>();
+	}
+}
+
+// Changes the configuration while the others log. Never filters the checked events: the checking sinks are TRACE
+static void reconfigure (unsigned int seed, Shared &shared, lggr::Channel &channel,
+                         const std::vector<std::shared_ptr<CheckingSink>> &sinks)
+{
+	std::mt19937 random (seed);
+	auto nullSink = std::make_shared<NullSink>();
+	bool attached = false;
+	while (!shared.stop.load())
+	{
+		switch (random() % 8)
+		{
+		case 0: lggr::Config::setStackSize (random() % (MAX_STACK + 1)); break;
+		case 1: lggr::Config::setStackLevel (static_cast<lggr::LogLevel> (random() % 4)); break;
+		case 2: lggr::Config::setFileLevel ((random() % 2) ? lggr::LL::OFF : lggr::LL::FATAL); break;
+		case 3: lggr::Config::setLevelOverride ((random() % 2) ? lggr::LL::TRACE : lggr::LL::OFF); break;
+		case 4:
+			attached ? lggr::Config::removeSink (nullSink) : lggr::Config::addSink (nullSink);
+			attached = !attached;
+			break;
+		case 5: channel.setStackSize (random() % (MAX_STACK + 1)); break;
+		case 6: lggr::Config::setConsoleFormatter (randomFormatter (random)); break;
+		default: sinks [random() % sinks.size()]->setFormatter (randomFormatter (random)); break;
+		}
+		std::this_thread::sleep_for (std::chrono::microseconds (200));
+	}
+	if (attached)
+	{
+		lggr::Config::removeSink (nullSink);
+	}
+}
+
+static void stress (const std::string &name, unsigned int shards, lggr::SinkMode mode, int operations,
+                    unsigned int seed)
+{
+	lggr::Config::setMultiThreadSafe (true);
+	if (shards > 0)
+	{
+		lggr::Config::setShards (shards);
+	}
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	lggr::Config::setStackSize (MAX_STACK);
+
+	auto sink = std::make_shared<CheckingSink> (mode);
+	lggr::Config::addSink (sink);
+	CountingSubscriber pushed;
+	lggr::subscribePushEvents (pushed, lggr::LL::TRACE);
+
+	lggr::Channel channel ("stress");
+	channel.setConsoleLevel (lggr::LL::OFF);
+	channel.setFileLevel (lggr::LL::OFF);
+	auto channelSink = std::make_shared<CheckingSink> (mode);
+	channel.addSink (channelSink);
+
+	Shared shared;
+	std::vector<ThreadCounters> counters (THREADS);
+	std::thread reconfigurer (reconfigure, seed, std::ref (shared), std::ref (channel),
+	                          std::vector<std::shared_ptr<CheckingSink>> {sink, channelSink});
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; t++)
+	{
+		threads.emplace_back (worker, t, seed, operations, std::ref (shared), std::ref (channel),
+		                      std::ref (counters [t]));
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	shared.stop = true;
+	reconfigurer.join();
+	while (!shared.handoff.empty())
+	{
+		finishOneHandoff (shared);
+	}
+	check (lggr::shutdown(), name + ": the outputs finish");
+
+	std::uint64_t logged = 0, timed = 0, channelLost = 0, lost = 0;
+	for (int t = 0; t < THREADS; t++)
+	{
+		lost += counters [t].sequence - sink->nextSequence [t];
+		channelLost += counters [t].channelSequence - channelSink->nextSequence [t];
+		logged += counters [t].sequence;
+		timed += counters [t].timed;
+	}
+	check (lost == 0 && channelLost == 0, name + ": no event is lost");
+	check (sink->disordered == 0 && channelSink->disordered == 0, name + ": the events of each thread are in order");
+	check (sink->unknown == 0 && channelSink->unknown == 0, name + ": no event is garbled");
+	check (sink->wrongThread == 0 && channelSink->wrongThread == 0,
+	       name + ": the thread index of each thread is stable");
+	check (sink->timedStarts == timed && sink->timedFinish == timed && sink->badTimed == 0
+	           && sink->getUnfinished() == 0,
+	       name + ": each timed event starts and finishes once, in order");
+	check (pushed.events == logged + 2 * timed, name + ": the push subscriber gets every event");
+	check (shared.maxPulled <= MAX_STACK + THREADS + HANDOFF_MAX,
+	       name + ": the stack is bounded (" + std::to_string (shared.maxPulled) + " pulled at most)");
+}
+
+int main (int argc, char *argv [])
+{
+	int operations    = (argc > 1) ? std::atoi (argv [1]) : 20000;
+	unsigned int seed = (argc > 2) ? static_cast<unsigned int> (std::strtoul (argv [2], nullptr, 10)) : 1;
+	std::cout << "Operations per thread: " << operations << ", seed: " << seed << std::endl;
+
+	runScenario ("mutex", [=] { stress ("mutex", 0, lggr::SinkMode::INLINE, operations, seed); });
+	runScenario ("mutex async", [=] { stress ("mutex async", 0, lggr::SinkMode::ASYNC, operations, seed); });
+	runScenario ("sharded", [=] { stress ("sharded", 4, lggr::SinkMode::INLINE, operations, seed); });
+	runScenario ("sharded async", [=] { stress ("sharded async", 4, lggr::SinkMode::ASYNC, operations, seed); });
+
+	return testsResult();
+}
@@ -0,0 +1,125 @@
+/*********************************************************************************************
+ *  Description : Modern C++ logger library, with evernt retrieval and color support
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+// The thread of the events: its index, its name (set, renamed and removed), and how the formatters write them. Each
+// scenario runs in its own process
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+#include "TestUtils.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Keeps the written events
+class CapturingSink : public lggr::LogSink
+{
+	protected:
+		void write (const lggr::EventContainer &event) override
+		{
+			std::lock_guard<std::mutex> lock (this->mtx);
+			this->events.push_back (event);
+		}
+
+	public:
+		CapturingSink()
+		    : LogSink (lggr::LL::INFO)
+		{
+		}
+
+		std::mutex mtx;
+		std::vector<lggr::EventContainer> events;
+};
+
+static std::shared_ptr<CapturingSink> captureEvents()
+{
+	lggr::Config::setMultiThreadSafe (true);
+	lggr::Config::setConsoleLevel (lggr::LL::OFF);
+	lggr::Config::setFileLevel (lggr::LL::OFF);
+	auto sink = std::make_shared<CapturingSink>();
+	lggr::Config::addSink (sink);
+	return sink;
+}
+
+static std::string formatted (const lggr::LogFormatter &formatter, const lggr::EventContainer &event)
+{
+	std::string out;
+	formatter.format (event, out);
+	return out;
+}
+
+//-------------- Scenarios ----------------
+
+static void textLayout()
+{
+	auto sink = captureEvents();
+	lggr::Config::setThreadName ("main-thread");
+	lggr::info << "hello";
+
+	const lggr::EventContainer &event = sink->events.at (0);
+	std::string index                 = std::to_string (event.threadIndex);
+	std::string plain                 = formatted (lggr::TextFormatter(), event);
+	std::string withThread            = formatted (lggr::TextFormatter (true), event);
+
+	check (event.threadIndex == lggr::getThreadIndex() && event.threadIndex != 0, "text: the event has the thread");
+	check (plain == event.date + " [INFO]\thello", "text: by default, the classic line without the thread");
+	check (withThread == event.date + " [INFO]\thello\tthread=" + index + "\tthread_name=main-thread",
+	       "text: withThread, the thread index and name after the text");
+	check (formatted (lggr::LogfmtFormatter(), event).find (" thread=" + index + " thread_name=main-thread")
+	           != std::string::npos,
+	       "logfmt: always the thread");
+}
+
+static void renamedThread()
+{
+	auto sink = captureEvents();
+	lggr::JsonLinesFormatter json;
+
+	std::uint32_t workerIndex = 0;
+	std::thread worker ([&] {
+		lggr::Config::setThreadName ("worker-1");
+		workerIndex = lggr::getThreadIndex();
+		lggr::info << "first";
+	});
+	worker.join();
+	lggr::info << "from main";
+
+	const std::string workerTag = ",\"thread\":" + std::to_string (workerIndex) + ",\"thread_name\":\"worker-1\"";
+	check (workerIndex != 0 && workerIndex != lggr::getThreadIndex(), "names: each thread has its own index");
+	check (lggr::getThreadName (workerIndex) == "worker-1", "names: the name of the thread, by its index");
+	check (formatted (json, sink->events.at (0)).find (workerTag) != std::string::npos,
+	       "names: json writes the name of the thread of the event");
+	check (formatted (json, sink->events.at (1)).find ("thread_name") == std::string::npos,
+	       "names: not the one of other thread");
+
+	// The name is looked up when the event is written: the current one
+	lggr::Config::setThreadName ("main");
+	lggr::Config::setThreadName ("main-renamed");
+	lggr::info << "renamed";
+	check (lggr::getThreadName (lggr::getThreadIndex()) == "main-renamed", "names: renamed");
+	check (formatted (json, sink->events.at (2)).find ("\"thread_name\":\"main-renamed\"") != std::string::npos,
+	       "names: the events are written with the new name");
+
+	lggr::Config::setThreadName ("");
+	check (lggr::getThreadName (lggr::getThreadIndex()).empty()
+	           && formatted (json, sink->events.at (2)).find ("thread_name") == std::string::npos,
+	       "names: an empty name removes it");
+	check (lggr::getThreadName (workerIndex) == "worker-1", "names: the name outlives its thread");
+}
+
+int main()
+{
+	runScenario ("text layout", textLayout);
+	runScenario ("renamed thread", renamedThread);
+
+	return testsResult();
+}
@@ -0,0 +1,361 @@
+/*********************************************************************************************
+ *  Description : Searches the events of a log file by time and level, with its side index (see setFileIndex)
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerLogIndex.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// The tail of the log (not indexed) is scanned in chunks of this size
+constexpr std::size_t TAIL_CHUNK_SIZE = 1024 * 1024;
+
+struct Query
+{
+		std::int64_t fromSec = INT64_MIN;
+		std::int64_t toSec   = INT64_MAX;
+		lggr::LogLevel level = lggr::LogLevel::TRACE;
+};
+
+struct Range
+{
+		std::size_t begin;
+		std::size_t end;
+};
+
+static void usage (const char *name)
+{
+	std::cerr << "Usage: " << name << " <log file> [-l LEVEL] [-f FROM] [-t TO] [-j THREADS] [-s]" << std::endl;
+	std::cerr << "  FROM, TO: \"YYYY-MM-DD HH:MM[:SS]\", or \"HH:MM[:SS]\" for the day of the log (UTC)" << std::endl;
+	std::cerr << "  -s: prints the statistics of the search to stderr" << std::endl;
+}
+
+static bool parseDigits (std::string_view text, std::size_t pos, std::size_t count, int &value)
+{
+	if (pos + count > text.size())
+	{
+		return false;
+	}
+	value = 0;
+	for (std::size_t i = pos; i < pos + count; i++)
+	{
+		if (text [i] < '0' || text [i] > '9')
+		{
+			return false;
+		}
+		value = value * 10 + (text [i] - '0');
+	}
+	return true;
+}
+
+static std::int64_t toDays (int year, int month, int day)
+{
+	std::chrono::sys_days days {std::chrono::year {year} / month / day};
+	return days.time_since_epoch().count();
+}
+
+// "YYYY-MM-DD HH:MM:SS" at the start of the text
+static bool parseDate (std::string_view text, std::int64_t &seconds)
+{
+	int year, month, day, hour, minute, second;
+	if (text.size() < 19 || !parseDigits (text, 0, 4, year) || text [4] != '-' || !parseDigits (text, 5, 2, month)
+	    || text [7] != '-' || !parseDigits (text, 8, 2, day) || !parseDigits (text, 11, 2, hour) || text [13] != ':'
+	    || !parseDigits (text, 14, 2, minute) || text [16] != ':' || !parseDigits (text, 17, 2, second))
+	{
+		return false;
+	}
+	seconds = toDays (year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+	return true;
+}
+
+// An argument of -f / -t. The end of a range includes the whole minute (or day) if the seconds are missing
+static bool parseTimeArg (std::string_view text, std::int64_t defaultDay, bool isEnd, std::int64_t &seconds)
+{
+	std::int64_t days = defaultDay;
+	int year, month, day;
+	if (parseDigits (text, 0, 4, year) && text.size() >= 10 && text [4] == '-')
+	{
+		if (!parseDigits (text, 5, 2, month) || !parseDigits (text, 8, 2, day))
+		{
+			return false;
+		}
+		days = toDays (year, month, day);
+		text = (text.size() > 11) ? text.substr (11) : std::string_view();
+	}
+
+	int hour = 0, minute = 0, second = 0;
+	std::int64_t precision = 86400;
+	if (!text.empty())
+	{
+		if (!parseDigits (text, 0, 2, hour) || text.size() < 5 || text [2] != ':' || !parseDigits (text, 3, 2, minute))
+		{
+			return false;
+		}
+		precision = 60;
+		if (text.size() >= 8 && text [5] == ':' && parseDigits (text, 6, 2, second))
+		{
+			precision = 1;
+		}
+	}
+
+	seconds = days * 86400 + hour * 3600 + minute * 60 + second + (isEnd ? precision - 1 : 0);
+	return true;
+}
+
+static bool parseLevel (std::string_view name, lggr::LogLevel &level)
+{
+	for (int i = 0; i <= 5; i++)
+	{
+		if (lggr::getLevelName (static_cast<lggr::LogLevel> (i)) == name)
+		{
+			level = static_cast<lggr::LogLevel> (i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// The level of a text line: "date [LEVEL]\t..."
+static bool parseLineLevel (std::string_view line, lggr::LogLevel &level)
+{
+	std::size_t open = line.find (" [", 19);
+	if (open == std::string_view::npos || open > 40)
+	{
+		return false;
+	}
+	std::size_t close = line.find (']', open);
+	return close != std::string_view::npos && parseLevel (line.substr (open + 2, close - open - 2), level);
+}
+
+// The lines wich don't start with a date are part of the previous event (a message with line breaks)
+static std::size_t scanRange (std::string_view data, const Query &query, std::string &out)
+{
+	std::size_t matches = 0;
+	bool keep           = false;
+	while (!data.empty())
+	{
+		std::size_t eol       = data.find ('\n');
+		std::size_t lineSize  = (eol == std::string_view::npos) ? data.size() : eol + 1;
+		std::string_view line = data.substr (0, lineSize);
+		data.remove_prefix (lineSize);
+
+		std::int64_t seconds;
+		lggr::LogLevel level;
+		if (parseDate (line, seconds) && parseLineLevel (line, level))
+		{
+			keep = seconds >= query.fromSec && seconds <= query.toSec && level >= query.level;
+			matches += keep ? 1 : 0;
+		}
+		if (keep)
+		{
+			out.append (line);
+		}
+	}
+	return matches;
+}
+
+// Splits [begin, end) in chunks wich start at the beginning of a line
+static void splitTail (std::string_view log, std::size_t begin, std::size_t end, std::vector<Range> &ranges)
+{
+	while (begin < end)
+	{
+		std::size_t cut = begin + TAIL_CHUNK_SIZE;
+		if (cut >= end)
+		{
+			cut = end;
+		}
+		else
+		{
+			std::size_t eol = log.find ('\n', cut);
+			cut             = (eol == std::string_view::npos || eol + 1 > end) ? end : eol + 1;
+		}
+		ranges.push_back ({begin, cut});
+		begin = cut;
+	}
+}
+
+int main (int argc, char *argv [])
+{
+	if (argc < 2)
+	{
+		usage (argv [0]);
+		return 1;
+	}
+
+	std::string logFile = argv [1];
+	std::string fromArg, toArg;
+	Query query;
+	unsigned int threads = std::max (1u, std::thread::hardware_concurrency());
+	bool stats           = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string_view arg = argv [i];
+		bool hasValue        = i + 1 < argc;
+		if (arg == "-l" && hasValue)
+		{
+			if (!parseLevel (argv [++i], query.level))
+			{
+				std::cerr << "Unknown level: " << argv [i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-f" && hasValue)
+		{
+			fromArg = argv [++i];
+		}
+		else if (arg == "-t" && hasValue)
+		{
+			toArg = argv [++i];
+		}
+		else if (arg == "-j" && hasValue)
+		{
+			threads = std::max (1, std::atoi (argv [++i]));
+		}
+		else if (arg == "-s")
+		{
+			stats = true;
+		}
+		else
+		{
+			usage (argv [0]);
+			return 1;
+		}
+	}
+
+	auto started = std::chrono::steady_clock::now();
+
+	int fd = ::open (logFile.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd < 0 || fstat (fd, &st) != 0)
+	{
+		std::cerr << "Unable to open " << logFile << std::endl;
+		return 1;
+	}
+	std::size_t logSize = static_cast<std::size_t> (st.st_size);
+	void *mem           = (logSize > 0) ? mmap (nullptr, logSize, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+	::close (fd);
+	if (mem == MAP_FAILED)
+	{
+		std::cerr << "Unable to map " << logFile << std::endl;
+		return 1;
+	}
+	std::string_view log (static_cast<const char *> (mem), logSize);
+
+	lggr::LogIndexReader index;
+	bool indexed = index.open (logFile + ".idx");
+
+	// The day of the log: for the arguments without date
+	std::int64_t defaultDay = 0;
+	std::int64_t firstSec;
+	if (indexed && index.size() > 0)
+	{
+		defaultDay = index.begin()->firstTimestampNs / 1'000'000'000 / 86400;
+	}
+	else if (parseDate (log, firstSec))
+	{
+		defaultDay = firstSec / 86400;
+	}
+	if ((!fromArg.empty() && !parseTimeArg (fromArg, defaultDay, false, query.fromSec))
+	    || (!toArg.empty() && !parseTimeArg (toArg, defaultDay, true, query.toSec)))
+	{
+		std::cerr << "Invalid time: use \"YYYY-MM-DD HH:MM[:SS]\" or \"HH:MM[:SS]\"" << std::endl;
+		return 1;
+	}
+
+	// The candidate blocks, and everything after the indexed part
+	std::vector<Range> ranges;
+	std::size_t indexedEnd = 0;
+	std::size_t blockCount = 0;
+	if (indexed)
+	{
+		std::int64_t fromNs = (query.fromSec == INT64_MIN) ? INT64_MIN : query.fromSec * 1'000'000'000;
+		std::int64_t toNs   = (query.toSec == INT64_MAX) ? INT64_MAX : (query.toSec + 1) * 1'000'000'000 - 1;
+		for (const lggr::LogIndexEntry *entry : index.find (fromNs, toNs, lggr::levelMaskFrom (query.level)))
+		{
+			std::size_t begin = std::min<std::size_t> (entry->offset, logSize);
+			std::size_t end   = std::min<std::size_t> (entry->endOffset, logSize);
+			if (begin < end)
+			{
+				ranges.push_back ({begin, end});
+			}
+		}
+		blockCount = index.size();
+		indexedEnd = std::min<std::size_t> (index.getIndexedEnd(), logSize);
+	}
+	std::size_t candidateBlocks = ranges.size();
+	splitTail (log, indexedEnd, logSize, ranges);
+
+	// Parallel scan: each range to its own output, printed in the file order
+	std::vector<std::string> outputs (ranges.size());
+	std::atomic<std::size_t> nextRange {0};
+	std::atomic<std::size_t> matches {0};
+	std::atomic<std::size_t> scanned {0};
+	auto worker = [&]() {
+		std::size_t current;
+		while ((current = nextRange.fetch_add (1)) < ranges.size())
+		{
+			const Range &range = ranges [current];
+			matches += scanRange (log.substr (range.begin, range.end - range.begin), query, outputs [current]);
+			scanned += range.end - range.begin;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	threads = std::min<unsigned int> (threads, static_cast<unsigned int> (std::max<std::size_t> (1, ranges.size())));
+	for (unsigned int i = 1; i < threads; i++)
+	{
+		pool.emplace_back (worker);
+	}
+	worker();
+	for (auto &thread : pool)
+	{
+		thread.join();
+	}
+
+	for (auto &output : outputs)
+	{
+		std::fwrite (output.data(), 1, output.size(), stdout);
+	}
+	std::fflush (stdout);
+
+	if (stats)
+	{
+		auto now     = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds> (now - started);
+		std::cerr << matches.load() << " events, " << scanned.load() << " of " << logSize << " bytes scanned";
+		if (indexed)
+		{
+			std::cerr << " (" << candidateBlocks << " of " << blockCount << " blocks)";
+		}
+		else
+		{
+			std::cerr << " (no index)";
+		}
+		std::cerr << ", " << threads << " threads, " << (elapsed.count() / 1000.0) << " ms" << std::endl;
+	}
+
+	if (mem != nullptr)
+	{
+		munmap (mem, logSize);
+	}
+	return 0;
+}
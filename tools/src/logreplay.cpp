@@ -0,0 +1,659 @@
+/*********************************************************************************************
+ *  Description : Converts archived logs (text files, or flight recorder files) to other formats, on all the cores
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "StreamLogger.h"
+#include "StreamLoggerSinks.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+// Input chunks of about this size: big enough to amortize the scheduling, small enough to balance the cores
+constexpr std::size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Formatted chunks waiting to be written, per thread: bounds the memory when the output is slow
+constexpr std::size_t PENDING_CHUNKS_PER_THREAD = 4;
+
+static void usage (const char *name)
+{
+	std::cerr << "Usage: " << name << " <input> [-o OUTPUT] [-f json|logfmt|text] [-l LEVEL] [-j THREADS] [-s]"
+	          << std::endl;
+	std::cerr << "  input: a log in the text format, or a flight recorder file" << std::endl;
+	std::cerr << "  -s: prints the statistics of the conversion to stderr" << std::endl;
+}
+
+//-------------- Text parsing ----------------
+
+static bool parseDigits (std::string_view text, std::size_t pos, std::size_t count, int &value)
+{
+	if (pos + count > text.size())
+	{
+		return false;
+	}
+	value = 0;
+	for (std::size_t i = pos; i < pos + count; i++)
+	{
+		if (text [i] < '0' || text [i] > '9')
+		{
+			return false;
+		}
+		value = value * 10 + (text [i] - '0');
+	}
+	return true;
+}
+
+static bool parseLevel (std::string_view name, lggr::LogLevel &level)
+{
+	for (int i = 0; i <= 5; i++)
+	{
+		if (lggr::getLevelName (static_cast<lggr::LogLevel> (i)) == name)
+		{
+			level = static_cast<lggr::LogLevel> (i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// "YYYY-MM-DD HH:MM:SS[.fraction][ UTC]": the date as the logger wrote it
+static bool parseDate (std::string_view date, lggr::TimePoint &timePoint)
+{
+	int year, month, day, hour, minute, second;
+	if (date.size() < 19 || !parseDigits (date, 0, 4, year) || date [4] != '-' || !parseDigits (date, 5, 2, month)
+	    || date [7] != '-' || !parseDigits (date, 8, 2, day) || !parseDigits (date, 11, 2, hour) || date [13] != ':'
+	    || !parseDigits (date, 14, 2, minute) || date [16] != ':' || !parseDigits (date, 17, 2, second))
+	{
+		return false;
+	}
+
+	std::int64_t nanos = 0;
+	if (date.size() > 20 && date [19] == '.')
+	{
+		std::int64_t scale = 100'000'000;
+		for (std::size_t i = 20; i < date.size() && date [i] >= '0' && date [i] <= '9'; i++, scale /= 10)
+		{
+			nanos += (date [i] - '0') * scale;
+		}
+	}
+
+	std::chrono::sys_days days {std::chrono::year {year} / month / day};
+	auto since = days.time_since_epoch() + std::chrono::hours (hour) + std::chrono::minutes (minute)
+	             + std::chrono::seconds (second) + std::chrono::nanoseconds (nanos);
+	timePoint = lggr::TimePoint (std::chrono::duration_cast<lggr::TimePoint::duration> (since));
+	return true;
+}
+
+struct EventStart
+{
+		std::string_view date;
+		lggr::LogLevel logLevel;
+		lggr::TimePoint timePoint;
+		std::string_view text;
+};
+
+// The first line of an event: "date [LEVEL]\ttext"
+static bool parseEventStart (std::string_view line, EventStart &start)
+{
+	std::size_t open = line.find (" [", 19);
+	if (open == std::string_view::npos || open > 40)
+	{
+		return false;
+	}
+	std::size_t close = line.find ("]\t", open);
+	if (close == std::string_view::npos || !parseLevel (line.substr (open + 2, close - open - 2), start.logLevel)
+	    || !parseDate (line.substr (0, open), start.timePoint))
+	{
+		return false;
+	}
+	start.date = line.substr (0, open);
+	start.text = line.substr (close + 2);
+	return true;
+}
+
+// "1h 2' 3\" 45ms" (see StackLogger::fillUsedTimeTxt)
+static std::chrono::milliseconds parseUsedTime (std::string_view text)
+{
+	std::chrono::milliseconds total {0};
+	while (!text.empty())
+	{
+		std::int64_t value = 0;
+		auto res           = std::from_chars (text.data(), text.data() + text.size(), value);
+		if (res.ec != std::errc {})
+		{
+			break;
+		}
+		text.remove_prefix (res.ptr - text.data());
+		if (text.starts_with ("ms"))
+		{
+			total += std::chrono::milliseconds (value);
+		}
+		else if (text.starts_with ("h"))
+		{
+			total += std::chrono::hours (value);
+		}
+		else if (text.starts_with ("'"))
+		{
+			total += std::chrono::minutes (value);
+		}
+		else if (text.starts_with ("\""))
+		{
+			total += std::chrono::seconds (value);
+		}
+		std::size_t next = text.find (' ');
+		text.remove_prefix ((next == std::string_view::npos) ? text.size() : next + 1);
+	}
+	return total;
+}
+
+static bool isFieldKey (std::string_view key)
+{
+	if (key.empty() || key.size() > 255)
+	{
+		return false;
+	}
+	return std::all_of (key.begin(), key.end(), [] (char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.'
+		       || c == '-';
+	});
+}
+
+// The value with its type back: the structured formats must write the numbers as numbers
+static void addField (lggr::LogFields &fields, std::string_view key, std::string_view value)
+{
+	const char *end = value.data() + value.size();
+	std::int64_t intValue;
+	double doubleValue;
+	if (value == "true" || value == "false")
+	{
+		fields.add (key, value == "true");
+	}
+	else if (!value.empty() && std::from_chars (value.data(), end, intValue).ptr == end)
+	{
+		fields.add (key, intValue);
+	}
+	else if (!value.empty() && value.find_first_of (".eEn") != std::string_view::npos
+	         && std::from_chars (value.data(), end, doubleValue).ptr == end)
+	{
+		fields.add (key, doubleValue);
+	}
+	else
+	{
+		fields.add (key, value);
+	}
+}
+
+// The sample rate and the thread: written before the context and the fields
+static bool parseUnsigned (std::string_view value, std::uint32_t &number)
+{
+	const char *end = value.data() + value.size();
+	return !value.empty() && std::from_chars (value.data(), end, number).ptr == end;
+}
+
+// The text of the TextFormatter, in a single line (the parts in brackets are optional, the thread only if it was
+// created withThread):
+//     text[\tDone in: time][\tsample_rate=n][\tthread=n[\tthread_name=name]]
+//     [\trequest_id=id[\tspan_id=id]][\tkey=value...]
+static void parseEventText (std::string_view text, lggr::EventContainer &event)
+{
+	// The fields are the last tab separated parts
+	std::vector<std::pair<std::string_view, std::string_view>> fields;
+	std::size_t tab;
+	while ((tab = text.rfind ('\t')) != std::string_view::npos)
+	{
+		std::string_view part = text.substr (tab + 1);
+		std::size_t eq        = part.find ('=');
+		if (eq == std::string_view::npos || !isFieldKey (part.substr (0, eq)))
+		{
+			break;
+		}
+		fields.emplace_back (part.substr (0, eq), part.substr (eq + 1));
+		text = text.substr (0, tab);
+	}
+	// The context goes first: "request_id=..[\tspan_id=..]". Its fields can't be told apart from the ones of the
+	// event, but both end in the same place of the output
+	std::shared_ptr<lggr::LogContext> context;
+	std::string_view threadName;
+	for (auto it = fields.rbegin(); it != fields.rend(); ++it)
+	{
+		if (it->first == "sample_rate" && it == fields.rbegin() && parseUnsigned (it->second, event.sampleRate))
+		{
+			continue;
+		}
+		bool beforeContext = !context && event.fields.empty();
+		if (it->first == "thread" && beforeContext && event.threadIndex == 0
+		    && parseUnsigned (it->second, event.threadIndex))
+		{
+			continue;
+		}
+		if (it->first == "thread_name" && beforeContext && event.threadIndex != 0 && threadName.empty())
+		{
+			threadName = it->second;
+			continue;
+		}
+		if (it->first == "request_id" && !context && event.fields.empty())
+		{
+			context = std::make_shared<lggr::LogContext> (it->second);
+		}
+		else if (it->first == "span_id" && context && context->spanId.empty() && event.fields.empty())
+		{
+			context->spanId = it->second;
+		}
+		else
+		{
+			addField (event.fields, it->first, it->second);
+		}
+	}
+	event.context = std::move (context);
+
+	// The names of the threads of other process are not known here: kept as a field
+	if (!threadName.empty())
+	{
+		addField (event.fields, "thread_name", threadName);
+	}
+
+	constexpr std::string_view DONE_IN = "\tDone in: ";
+	std::size_t done                   = text.rfind (DONE_IN);
+	if (done != std::string_view::npos && text.find ('\t', done + 1) == std::string_view::npos)
+	{
+		event.eventType    = lggr::EVENT_TYPE_TIMED_FINISHED;
+		event.usedTimeTxt  = text.substr (done + DONE_IN.size());
+		event.endTimePoint = event.timePoint + parseUsedTime (event.usedTimeTxt);
+		text               = text.substr (0, done);
+	}
+	event.event = text;
+}
+
+//-------------- Conversion ----------------
+
+struct Conversion
+{
+		std::shared_ptr<const lggr::LogFormatter> formatter;
+		lggr::LogLevel level = lggr::LogLevel::TRACE;
+};
+
+static void emitEvent (const Conversion &conversion, const lggr::EventContainer &event, std::string &out,
+                       std::size_t &events)
+{
+	if (event.logLevel >= conversion.level)
+	{
+		conversion.formatter->format (event, out);
+		out += '\n';
+		events++;
+	}
+}
+
+// A chunk starts at the beginning of an event. The lines wich don't start an event are part of the previous one
+static std::size_t convertText (const Conversion &conversion, std::string_view data, std::string &out)
+{
+	std::size_t events = 0;
+	EventStart current, start;
+	bool hasCurrent = false;
+	std::string text;    // With the continuation lines
+
+	auto finish = [&]() {
+		if (hasCurrent)
+		{
+			lggr::EventContainer event (current.logLevel);
+			event.timePoint = current.timePoint;
+			event.date.assign (current.date);
+			parseEventText (text, event);
+			emitEvent (conversion, event, out, events);
+		}
+	};
+
+	while (!data.empty())
+	{
+		std::size_t eol       = data.find ('\n');
+		std::string_view line = data.substr (0, eol);
+		data.remove_prefix ((eol == std::string_view::npos) ? data.size() : eol + 1);
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix (1);
+		}
+
+		if (parseEventStart (line, start))
+		{
+			finish();
+			current    = start;
+			hasCurrent = true;
+			text.assign (start.text);
+		}
+		else if (hasCurrent)
+		{
+			text += '\n';
+			text += line;
+		}
+	}
+	finish();
+	return events;
+}
+
+// Splits the text at the beginning of the events
+static std::vector<std::string_view> splitText (std::string_view data)
+{
+	std::vector<std::string_view> chunks;
+	std::size_t begin = 0;
+	while (begin < data.size())
+	{
+		std::size_t cut = begin + CHUNK_SIZE;
+		while (cut < data.size())
+		{
+			std::size_t eol = data.find ('\n', cut);
+			if (eol == std::string_view::npos)
+			{
+				cut = data.size();
+				break;
+			}
+			cut = eol + 1;
+			EventStart start;
+			if (parseEventStart (data.substr (cut, 64), start))
+			{
+				break;
+			}
+		}
+		cut = std::min (cut, data.size());
+		chunks.push_back (data.substr (begin, cut - begin));
+		begin = cut;
+	}
+	return chunks;
+}
+
+//-------------- Work stealing pool ----------------
+
+/**
+ * Each worker has its own queue of chunks, in the file order, and takes the first one. When it's empty, it steals the
+ * first one of other worker: the chunks are done (almost) in order, so the merge doesn't keep many of them waiting
+ */
+class WorkStealingQueues
+{
+	private:
+		struct WorkerQueue
+		{
+				std::mutex mtx;
+				std::deque<std::size_t> chunks;
+		};
+		std::vector<WorkerQueue> queues;
+
+		bool popFront (WorkerQueue &queue, std::size_t &chunk)
+		{
+			std::lock_guard<std::mutex> lock (queue.mtx);
+			if (queue.chunks.empty())
+			{
+				return false;
+			}
+			chunk = queue.chunks.front();
+			queue.chunks.pop_front();
+			return true;
+		}
+
+	public:
+		WorkStealingQueues (std::size_t workers, std::size_t chunkCount)
+		    : queues (workers)
+		{
+			for (std::size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				queues [chunk % workers].chunks.push_back (chunk);
+			}
+		}
+
+		bool next (std::size_t worker, std::size_t &chunk)
+		{
+			for (std::size_t i = 0; i < queues.size(); i++)
+			{
+				if (popFront (queues [(worker + i) % queues.size()], chunk))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+/**
+ * The formatted chunks, written in order as soon as the previous ones are
+ */
+class OrderedMerge
+{
+	private:
+		std::FILE *output;
+		std::vector<std::string> results;
+		std::vector<bool> ready;
+		std::size_t written = 0;
+		bool writing        = false;
+		std::size_t window;
+		std::mutex mtx;
+		std::condition_variable cv;
+
+	public:
+		OrderedMerge (std::FILE *output, std::size_t chunkCount, std::size_t window)
+		    : output (output)
+		    , results (chunkCount)
+		    , ready (chunkCount, false)
+		    , window (window)
+		{
+		}
+
+		// Backpressure: a worker doesn't start a chunk too far from the written ones
+		void waitTurn (std::size_t chunk)
+		{
+			std::unique_lock<std::mutex> lock (mtx);
+			cv.wait (lock, [&] { return chunk < written + window; });
+		}
+
+		void complete (std::size_t chunk, std::string &&result)
+		{
+			std::unique_lock<std::mutex> lock (mtx);
+			results [chunk] = std::move (result);
+			ready [chunk]   = true;
+
+			// Only one writer: it also writes the ones completed meanwhile
+			if (writing)
+			{
+				return;
+			}
+			writing = true;
+			while (written < ready.size() && ready [written])
+			{
+				std::string pending = std::move (results [written]);
+				lock.unlock();
+				std::fwrite (pending.data(), 1, pending.size(), output);
+				lock.lock();
+				written++;
+				cv.notify_all();
+			}
+			writing = false;
+		}
+};
+
+//-------------- Recorder files ----------------
+
+class EventCollector : public lggr::LogEventsSubscriber
+{
+	public:
+		const Conversion &conversion;
+		std::string out;
+		std::size_t events = 0;
+
+		EventCollector (const Conversion &conversion)
+		    : conversion (conversion)
+		{
+		}
+
+		void onLogEvent (const std::string &, const std::string, const lggr::LogLevel) override {}
+
+		void onLogRecord (const lggr::EventContainer &event) override
+		{
+			emitEvent (conversion, event, out, events);
+		}
+};
+
+int main (int argc, char *argv [])
+{
+	if (argc < 2)
+	{
+		usage (argv [0]);
+		return 1;
+	}
+
+	std::string inputFile = argv [1];
+	std::string outputFile;
+	Conversion conversion;
+	conversion.formatter = std::make_shared<lggr::JsonLinesFormatter>();
+	unsigned int threads = std::max (1u, std::thread::hardware_concurrency());
+	bool stats           = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string_view arg = argv [i];
+		bool hasValue        = i + 1 < argc;
+		if (arg == "-o" && hasValue)
+		{
+			outputFile = argv [++i];
+		}
+		else if (arg == "-f" && hasValue)
+		{
+			std::string_view format = argv [++i];
+			if (format == "json")
+			{
+				conversion.formatter = std::make_shared<lggr::JsonLinesFormatter>();
+			}
+			else if (format == "logfmt")
+			{
+				conversion.formatter = std::make_shared<lggr::LogfmtFormatter>();
+			}
+			else if (format == "text")
+			{
+				conversion.formatter = std::make_shared<lggr::TextFormatter>();
+			}
+			else
+			{
+				std::cerr << "Unknown format: " << format << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-l" && hasValue)
+		{
+			if (!parseLevel (argv [++i], conversion.level))
+			{
+				std::cerr << "Unknown level: " << argv [i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-j" && hasValue)
+		{
+			threads = std::max (1, std::atoi (argv [++i]));
+		}
+		else if (arg == "-s")
+		{
+			stats = true;
+		}
+		else
+		{
+			usage (argv [0]);
+			return 1;
+		}
+	}
+
+	std::FILE *output = outputFile.empty() ? stdout : std::fopen (outputFile.c_str(), "wb");
+	if (output == nullptr)
+	{
+		std::cerr << "Unable to create " << outputFile << std::endl;
+		return 1;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+
+	// The recorder files are small (a fixed number of records): no need of the pool
+	EventCollector collector (conversion);
+	if (lggr::pullRecorderFileEvents (inputFile, collector, lggr::LogLevel::TRACE))
+	{
+		std::fwrite (collector.out.data(), 1, collector.out.size(), output);
+		if (stats)
+		{
+			std::cerr << collector.events << " events (flight recorder)" << std::endl;
+		}
+		return (output != stdout && std::fclose (output) != 0) ? 1 : 0;
+	}
+
+	int fd = ::open (inputFile.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd < 0 || fstat (fd, &st) != 0)
+	{
+		std::cerr << "Unable to open " << inputFile << std::endl;
+		return 1;
+	}
+	std::size_t inputSize = static_cast<std::size_t> (st.st_size);
+	void *mem             = (inputSize > 0) ? mmap (nullptr, inputSize, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+	::close (fd);
+	if (mem == MAP_FAILED)
+	{
+		std::cerr << "Unable to map " << inputFile << std::endl;
+		return 1;
+	}
+	madvise (mem, inputSize, MADV_SEQUENTIAL);
+
+	std::vector<std::string_view> chunks = splitText (std::string_view (static_cast<const char *> (mem), inputSize));
+	threads = std::min<unsigned int> (threads, static_cast<unsigned int> (std::max<std::size_t> (1, chunks.size())));
+
+	WorkStealingQueues queues (threads, chunks.size());
+	OrderedMerge merge (output, chunks.size(), PENDING_CHUNKS_PER_THREAD * threads);
+	std::atomic<std::size_t> events {0};
+
+	auto worker = [&] (std::size_t id) {
+		std::size_t chunk;
+		while (queues.next (id, chunk))
+		{
+			merge.waitTurn (chunk);
+			std::string out;
+			out.reserve (chunks [chunk].size() * 2);
+			events += convertText (conversion, chunks [chunk], out);
+			merge.complete (chunk, std::move (out));
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < threads; i++)
+	{
+		pool.emplace_back (worker, i);
+	}
+	worker (0);
+	for (auto &thread : pool)
+	{
+		thread.join();
+	}
+
+	if (stats)
+	{
+		auto now     = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds> (now - started);
+		std::cerr << events.load() << " events, " << inputSize << " bytes in " << chunks.size() << " chunks, "
+		          << threads << " threads, " << elapsed.count() << " ms" << std::endl;
+	}
+
+	if (mem != nullptr)
+	{
+		munmap (mem, inputSize);
+	}
+	return (output != stdout && std::fclose (output) != 0) ? 1 : 0;
+}
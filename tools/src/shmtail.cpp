@@ -0,0 +1,101 @@
+/*********************************************************************************************
+ *  Description : Prints the events published by a ShmRingSink (the sidecar side of the ring)
+ *  License     : The unlicense (https://unlicense.org)
+ *	Copyright	(C) 2024  Ignacio Pomar Ballestero
+ ********************************************************************************************/
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "StreamLogger.h"
+#include "StreamLoggerShmRing.h"
+
+namespace lggr = IgnacioPomar::Util::StreamLogger;
+
+static volatile std::sig_atomic_t keepRunning = 1;
+
+static void onSignal (int)
+{
+	keepRunning = 0;
+}
+
+static void printEvent (const lggr::ShmEvent &event)
+{
+	std::time_t secs = static_cast<std::time_t> (event.timestampNs / 1'000'000'000);
+	long nanos       = static_cast<long> (event.timestampNs % 1'000'000'000);
+	struct tm buf;
+	gmtime_r (&secs, &buf);
+	char date [64];
+	std::size_t len = strftime (date, sizeof (date), "%F %T", &buf);
+	std::snprintf (date + len, sizeof (date) - len, ".%09ld", nanos);
+
+	std::cout << date << " [" << lggr::getLevelName (event.logLevel) << "]\t" << event.text;
+	if (event.truncated)
+	{
+		std::cout << "[...]";
+	}
+	if (event.durationNs != 0)
+	{
+		std::cout << "\tDone in: " << (event.durationNs / 1000) << "us";
+	}
+	std::cout << '\n';
+}
+
+int main (int argc, char *argv [])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv [0] << " <shm name, p.e. /streamlogger>" << std::endl;
+		return 1;
+	}
+
+	std::signal (SIGINT, onSignal);
+	std::signal (SIGTERM, onSignal);
+
+	lggr::ShmRingReader reader (argv [1]);
+	lggr::ShmEvent event;
+	std::string buffer;
+	std::uint64_t reportedDrops = 0;
+
+	while (keepRunning)
+	{
+		if (!reader.open())
+		{
+			std::this_thread::sleep_for (std::chrono::milliseconds (100));
+			continue;
+		}
+
+		bool any = false;
+		while (reader.read (event, buffer))
+		{
+			printEvent (event);
+			any = true;
+		}
+
+		std::uint64_t drops = reader.getDropped();
+		if (drops != reportedDrops)
+		{
+			std::cerr << "*** " << (drops - reportedDrops) << " events dropped by the producer" << std::endl;
+			reportedDrops = drops;
+		}
+
+		if (!any)
+		{
+			std::cout.flush();
+			if (reader.isStale())
+			{
+				// The producer has been restarted
+				reader.close();
+				reportedDrops = 0;
+			}
+			std::this_thread::sleep_for (std::chrono::microseconds (200));
+		}
+	}
+
+	return 0;
+}